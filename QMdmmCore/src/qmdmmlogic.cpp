@@ -2,6 +2,7 @@
 
 #include "qmdmmlogic.h"
 #include "qmdmmlogic_p.h"
+#include "qmdmmplayer.h"
 #include "qmdmmroom.h"
 
 #include <QHash>
@@ -41,8 +42,9 @@ namespace v0 {
  * <tr>
  * <td>@c Logic::BeforeRoundStart
  * <td>The game / round has not yet started yet. Typically due to waiting for preparation of agents.
- * <td>@c Logic::addPlayer() @c Logic::removePlayer() @c Logic::roundStart()
- * <td>When @c Logic::addPlayer() or @c Logic::removePlayer() is called, all the upgrades are cleared.
+ * <td>@c Logic::addPlayer() @c Logic::removePlayer() @c Logic::roundStart() @c Logic::restore()
+ * <td>When @c Logic::addPlayer() or @c Logic::removePlayer() is called, all the upgrades are cleared.<br />
+ *     @c Logic::restore() rebuilds a logic with no players from a snapshot taken in this state.
  * </tr>
  * <tr>
  * <td>@c Logic::SscForAction
@@ -315,6 +317,76 @@ bool Logic::upgradeReply(const QString &playerName, const QList<Data::UpgradeIte
     return false;
 }
 
+/**
+ * @brief Take a snapshot of the room for a player
+ * @param playerName the internal name of the player which the snapshot is taken for, or empty for the owner of the logic
+ * @return true if the player is in this logic or @p playerName is empty, otherwise false
+ *
+ * Can be called from any state. The snapshot is emitted by @c Logic::snapshotResult() .
+ */
+bool Logic::snapshot(const QString &playerName)
+{
+    if (!playerName.isEmpty() && !d->players.contains(playerName))
+        return false;
+
+    Protocol::RoomSnapshotNotify snapshot;
+    snapshot.state = d->state;
+    snapshot.players.reserve(d->players.size());
+    foreach (const QString &name, d->players) {
+        const Player *player = d->room->player(name);
+        Protocol::PlayerSnapshot playerSnapshot;
+        playerSnapshot.playerName = name;
+        playerSnapshot.hasKnife = player->hasKnife();
+        playerSnapshot.hasHorse = player->hasHorse();
+        playerSnapshot.hp = player->hp();
+        playerSnapshot.place = player->place();
+        playerSnapshot.initialPlace = player->initialPlace();
+        playerSnapshot.knifeDamage = player->knifeDamage();
+        playerSnapshot.horseDamage = player->horseDamage();
+        playerSnapshot.maxHp = player->maxHp();
+        playerSnapshot.upgradePoint = player->upgradePoint();
+        snapshot.players << playerSnapshot;
+    }
+
+    emit snapshotResult(playerName, snapshot, QPrivateSignal());
+    return true;
+}
+
+/**
+ * @brief Restore the room from a snapshot taken between rounds
+ * @param snapshot the snapshot emitted by @c Logic::snapshotResult()
+ * @return true if state matches and operation succeeded, otherwise false
+ *
+ * Can be only called from @c Logic::BeforeRoundStart state with no players, and @p snapshot must be taken from
+ * @c Logic::BeforeRoundStart state too. The players are added in seat order, then their places and upgrades are restored.
+ * Nothing is emitted.
+ */
+bool Logic::restore(const Protocol::RoomSnapshotNotify &snapshot)
+{
+    if (d->state != BeforeRoundStart || snapshot.state != BeforeRoundStart || !d->players.isEmpty())
+        return false;
+
+    foreach (const Protocol::PlayerSnapshot &playerSnapshot, snapshot.players) {
+        if (!addPlayer(playerSnapshot.playerName))
+            return false;
+    }
+
+    foreach (const Protocol::PlayerSnapshot &playerSnapshot, snapshot.players) {
+        Player *player = d->room->player(playerSnapshot.playerName);
+        player->setMaxHp(playerSnapshot.maxHp);
+        player->setHp(playerSnapshot.hp);
+        player->setKnifeDamage(playerSnapshot.knifeDamage);
+        player->setHorseDamage(playerSnapshot.horseDamage);
+        player->setHasKnife(playerSnapshot.hasKnife);
+        player->setHasHorse(playerSnapshot.hasHorse);
+        player->setInitialPlace(playerSnapshot.initialPlace);
+        player->setPlace(playerSnapshot.place);
+        player->setUpgradePoint(playerSnapshot.upgradePoint);
+    }
+
+    return true;
+}
+
 /**
  * @fn Logic::requestSscForAction(const QStringList &playerNames, QPrivateSignal)
  * @brief emits when Stone-Scissors-Cloth is requested for actions
@@ -411,6 +483,16 @@ bool Logic::upgradeReply(const QString &playerName, const QList<Data::UpgradeIte
  * Can be only emitted in @c Logic::Upgrade state.
  */
 
+/**
+ * @fn Logic::snapshotResult(const QString &playerName, const QMdmmCore::Protocol::RoomSnapshotNotify &snapshot, QPrivateSignal)
+ * @brief emits when a snapshot of the room is taken
+ * @param playerName the internal name of the player which the snapshot is taken for
+ * @param snapshot the state of the logic and of every player, in seat order. The screen names and agent states are left for the caller
+ *
+ * Emitted by @c Logic::snapshot() . Since it is emitted after every earlier signal, a receiver connected through a queued connection gets the snapshot
+ * after every earlier result, so it can be applied in between the results.
+ */
+
 #ifndef DOXYGEN
 } // namespace v0
 #endif
@@ -4,6 +4,7 @@
 #define QMDMMLOGIC_H
 
 #include "qmdmmcoreglobal.h"
+#include "qmdmmprotocol.h"
 
 #include <QObject>
 
@@ -60,6 +61,9 @@ public slots: // NOLINT(readability-redundant-access-specifiers)
     bool actionReply(const QString &playerName, Data::Action action, const QString &toPlayer, int toPlace);
     bool upgradeReply(const QString &playerName, const QList<Data::UpgradeItem> &items);
 
+    bool snapshot(const QString &playerName);
+    bool restore(const QMdmmCore::Protocol::RoomSnapshotNotify &snapshot);
+
 signals: // NOLINT(readability-redundant-access-specifiers)
     void requestSscForAction(const QStringList &playerNames, QPrivateSignal);
     void sscResult(const QHash<QString, Data::StoneScissorsCloth> &replies, QPrivateSignal);
@@ -73,6 +77,8 @@ signals: // NOLINT(readability-redundant-access-specifiers)
     void upgradeResult(const QHash<QString, QList<Data::UpgradeItem>> &upgrades, QPrivateSignal);
     void gameOver(const QStringList &playerNames, QPrivateSignal);
 
+    void snapshotResult(const QString &playerName, const QMdmmCore::Protocol::RoomSnapshotNotify &snapshot, QPrivateSignal);
+
 #ifndef DOXYGEN
 private:
     friend struct p::LogicP;
@@ -1,6 +1,8 @@
 // SPDX-License-Identifier: AGPL-3.0-or-later
 
 #include "qmdmmprotocol.h"
+#include <QCborMap>
+#include <QCborValue>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonValue>
@@ -218,6 +220,24 @@ namespace v0 {
  * @brief A notify packet
  */
 
+/**
+ * @enum Protocol::Codec
+ * @brief The encoding of a packet on the wire
+ *
+ * The codec is a per-connection choice. Server lists the codecs it supports in @c Protocol::NotifyVersion, and client picks one in @c Protocol::NotifySignIn.
+ * Packets before the sign-in are always JSON, and a receiver accepts both codecs at any time (see @c Protocol::detectCodec() ).
+ */
+
+/**
+ * @var Protocol::Codec Protocol::CodecJson
+ * @brief JSON, the default and the fallback codec
+ */
+
+/**
+ * @var Protocol::Codec Protocol::CodecCbor
+ * @brief CBOR (RFC 8949), a binary codec with the same structure as JSON
+ */
+
 /**
  * @brief get the protocol version of current implementation
  * @return the version of protocol
@@ -229,35 +249,258 @@ int Protocol::version() noexcept
     return 0;
 }
 
+/**
+ * @brief detect the codec of a serialized packet
+ * @param serialized the serialized packet
+ * @return the codec which the packet is serialized with
+ *
+ * A packet is always a map. A CBOR map begins with a byte of major type 5 (0xa0 - 0xbf), which is never a valid start of a JSON text.
+ */
+Protocol::Codec Protocol::detectCodec(const QByteArray &serialized) noexcept
+{
+    if (!serialized.isEmpty() && (static_cast<uint8_t>(serialized.front()) & 0xe0U) == 0xa0U)
+        return CodecCbor;
+
+    return CodecJson;
+}
+
+/**
+ * @fn Protocol::dispatchIndex(RequestId id)
+ * @brief get the index of a request ID in a dispatch table
+ * @param id the request ID
+ * @return the index, or -1 if the ID is invalid
+ */
+
+/**
+ * @fn Protocol::dispatchIndex(NotifyId id)
+ * @brief get the index of a notify ID in a dispatch table
+ * @param id the notify ID
+ * @return the index, or -1 if the ID is invalid
+ *
+ * The notify IDs are grouped by their masks. Each group takes a fixed number of slots, so the index is a dense one.
+ */
+
+/**
+ * @class Protocol::DispatchTable
+ * @brief A table which maps a request / notify ID to its handler
+ * @tparam Id either @c Protocol::RequestId or @c Protocol::NotifyId
+ * @tparam Handler the handler type, usually a pointer to member function
+ *
+ * The handlers are stored in an array indexed by @c Protocol::dispatchIndex(), so looking up a handler costs an array access instead of a hash lookup.
+ */
+
+/**
+ * @fn Protocol::DispatchTable::DispatchTable(std::initializer_list<std::pair<Id, Handler>> handlers)
+ * @brief constructor
+ * @param handlers the pairs of the ID and its handler
+ */
+
+/**
+ * @fn Protocol::DispatchTable::value(Id id) const noexcept
+ * @brief get the handler of an ID
+ * @param id the request / notify ID
+ * @return the handler, or a value-initialized handler (i.e. @c nullptr ) if there is no handler for the ID
+ */
+
+/**
+ * @fn Protocol::decodePayload(const QJsonValue &value, T *payload)
+ * @brief decode a payload from the value of a packet
+ * @param value the value of a packet
+ * @param payload the decoded payload
+ * @return whether the value matches the description of the payload
+ *
+ * A payload struct is decoded field by field with a single pass over the JSON object. Unknown keys are ignored, and all fields which are not
+ * @c std::optional are required. Any type mismatch or out-of-range enum value is a failure.
+ */
+
+/**
+ * @fn Protocol::encodePayload(const T &payload)
+ * @brief encode a payload to the value of a packet
+ * @param payload the payload
+ * @return the value of a packet
+ *
+ * An absent optional field is not encoded.
+ */
+
+/**
+ * @fn Protocol::requestPacket(const RequestPayloadType<Id> &payload)
+ * @brief build a request packet with its typed payload
+ * @tparam Id the request ID
+ * @param payload the payload
+ * @return the packet
+ */
+
+/**
+ * @fn Protocol::replyPacket(const ReplyPayloadType<Id> &payload)
+ * @brief build a reply packet with its typed payload
+ * @tparam Id the request ID which is replied to
+ * @param payload the payload
+ * @return the packet
+ */
+
+/**
+ * @fn Protocol::notifyPacket(const NotifyPayloadType<Id> &payload)
+ * @brief build a notify packet with its typed payload
+ * @tparam Id the notify ID
+ * @param payload the payload
+ * @return the packet
+ */
+
 #ifndef DOXYGEN
+} // namespace v0
+
+// Packet and PacketData are in v1, see qmdmmprotocol.h
+inline namespace v1 {
+#endif
+
+#ifndef DOXYGEN
+
+PacketCache::PacketCache(const PacketCache &other)
+{
+    if (const QByteArray *otherBytes = other.bytes.load(std::memory_order_acquire); otherBytes != nullptr)
+        bytes.store(new QByteArray(*otherBytes), std::memory_order_relaxed);
+}
+
+PacketCache::~PacketCache()
+{
+    delete bytes.load(std::memory_order_relaxed);
+}
+
+QByteArray PacketCache::value() const
+{
+    if (const QByteArray *published = bytes.load(std::memory_order_acquire); published != nullptr)
+        return *published;
+
+    return {};
+}
+
+QByteArray PacketCache::publish(const QByteArray &serialized) const
+{
+    auto *made = new QByteArray(serialized);
+    QByteArray *published = nullptr;
+    if (bytes.compare_exchange_strong(published, made, std::memory_order_acq_rel, std::memory_order_acquire))
+        return *made;
+
+    // made by another thread first
+    delete made;
+    return *published;
+}
+
+void PacketCache::clear()
+{
+    delete bytes.exchange(nullptr, std::memory_order_relaxed);
+}
 
 PacketData::PacketData()
+    : type(Protocol::TypeInvalid)
+    , requestId(Protocol::RequestInvalid)
+    , notifyId(Protocol::NotifyInvalid)
 {
-    insert(QStringLiteral("type"), static_cast<int>(Protocol::TypeInvalid));
-    insert(QStringLiteral("requestId"), static_cast<int>(Protocol::RequestInvalid));
-    insert(QStringLiteral("notifyId"), static_cast<int>(Protocol::NotifyInvalid));
-    insert(QStringLiteral("value"), QJsonValue());
 }
 
 PacketData::PacketData(Protocol::PacketType type, Protocol::RequestId requestId, Protocol::NotifyId notifyId, const QJsonValue &v)
+    : type(type)
+    , requestId(requestId)
+    , notifyId(notifyId)
+    , value(v)
 {
-    insert(QStringLiteral("type"), static_cast<int>(type));
-    insert(QStringLiteral("requestId"), static_cast<int>(requestId));
-    insert(QStringLiteral("notifyId"), static_cast<int>(notifyId));
-    insert(QStringLiteral("value"), v);
 }
 
-PacketData::PacketData(const QJsonObject &ob) noexcept(noexcept(QJsonObject(ob)))
-    : QJsonObject(ob)
+PacketData::PacketData(const QJsonObject &ob)
+    : PacketData()
 {
+    *this = ob;
 }
 
-PacketData &PacketData::operator=(const QJsonObject &ob) noexcept(noexcept(QJsonObject::operator=(ob)))
+PacketData &PacketData::operator=(const QJsonObject &ob)
 {
-    QJsonObject::operator=(ob);
+    type = static_cast<Protocol::PacketType>(ob.value(QStringLiteral("type")).toInt(Protocol::TypeInvalid));
+    requestId = static_cast<Protocol::RequestId>(ob.value(QStringLiteral("requestId")).toInt(Protocol::RequestInvalid));
+    notifyId = static_cast<Protocol::NotifyId>(ob.value(QStringLiteral("notifyId")).toInt(Protocol::NotifyInvalid));
+    value = ob.value(QStringLiteral("value"));
+    serializedJson.clear();
+    serializedCbor.clear();
+    compressedJson.clear();
+    compressedCbor.clear();
     return *this;
 }
 
+QJsonObject PacketData::toJsonObject() const
+{
+    QJsonObject ob;
+    ob.insert(QStringLiteral("type"), static_cast<int>(type));
+    ob.insert(QStringLiteral("requestId"), static_cast<int>(requestId));
+    ob.insert(QStringLiteral("notifyId"), static_cast<int>(notifyId));
+    ob.insert(QStringLiteral("value"), value);
+    return ob;
+}
+
+namespace {
+// A JSON object and a CBOR map are read the same way. These overloads hide the difference between their values
+bool isNumber(const QJsonValue &v)
+{
+    return v.isDouble();
+}
+
+bool isNumber(const QCborValue &v)
+{
+    return v.isInteger() || v.isDouble();
+}
+
+int toInt(const QJsonValue &v)
+{
+    return v.toInt();
+}
+
+int toInt(const QCborValue &v)
+{
+    return v.toJsonValue().toInt();
+}
+
+QJsonValue toJsonValue(const QJsonValue &v)
+{
+    return v;
+}
+
+QJsonValue toJsonValue(const QCborValue &v)
+{
+    return v.toJsonValue();
+}
+
+// Verify the packet in a JSON object or a CBOR map, and read its fields to PacketData in one pass
+template<typename Map>
+bool readPacket(const Map &map, PacketData *d, QString *errorString)
+{
+    int numbers[3] = {0, 0, 0};
+    const QString numberKeys[3] = {QStringLiteral("type"), QStringLiteral("requestId"), QStringLiteral("notifyId")};
+
+    for (int i = 0; i < 3; ++i) {
+        typename Map::const_iterator it = map.constFind(numberKeys[i]);
+        if (it == map.constEnd()) {
+            *errorString = QStringLiteral("'%1' is non-existent").arg(numberKeys[i]);
+            return false;
+        }
+        if (!isNumber(it.value())) {
+            *errorString = QStringLiteral("'%1' is not number").arg(numberKeys[i]);
+            return false;
+        }
+        numbers[i] = toInt(it.value());
+    }
+
+    typename Map::const_iterator it = map.constFind(QStringLiteral("value"));
+    if (it == map.constEnd()) {
+        *errorString = QStringLiteral("'value' is non-existent");
+        return false;
+    }
+
+    d->type = static_cast<Protocol::PacketType>(numbers[0]);
+    d->requestId = static_cast<Protocol::RequestId>(numbers[1]);
+    d->notifyId = static_cast<Protocol::NotifyId>(numbers[2]);
+    d->value = toJsonValue(it.value());
+    return true;
+}
+} // namespace
+
 #endif
 
 /**
@@ -265,6 +508,7 @@ PacketData &PacketData::operator=(const QJsonObject &ob) noexcept(noexcept(QJson
  * @brief A packet for QMdmm protocol
  *
  * A packet of QMdmm Protocol is a JSON object, encoded in a single line.
+ * It can also be encoded as a CBOR map with the same keys, if both sides agreed on it during sign in (see @c Protocol::Codec ).
  */
 
 /**
@@ -302,7 +546,7 @@ Packet::Packet(Protocol::NotifyId notifyId, const QJsonValue &value)
  */
 Protocol::PacketType Packet::type() const
 {
-    return static_cast<Protocol::PacketType>(d->value(QStringLiteral("type")).toInt(Protocol::TypeInvalid));
+    return d->type;
 }
 
 /**
@@ -311,9 +555,8 @@ Protocol::PacketType Packet::type() const
  */
 Protocol::RequestId Packet::requestId() const
 {
-    Protocol::PacketType t = type();
-    if (t == Protocol::TypeRequest || t == Protocol::TypeReply)
-        return static_cast<Protocol::RequestId>(d->value(QStringLiteral("requestId")).toInt(Protocol::RequestInvalid));
+    if (d->type == Protocol::TypeRequest || d->type == Protocol::TypeReply)
+        return d->requestId;
 
     return Protocol::RequestInvalid;
 }
@@ -324,9 +567,8 @@ Protocol::RequestId Packet::requestId() const
  */
 Protocol::NotifyId Packet::notifyId() const
 {
-    Protocol::PacketType t = type();
-    if (t == Protocol::TypeNotify)
-        return static_cast<Protocol::NotifyId>(d->value(QStringLiteral("notifyId")).toInt(Protocol::NotifyInvalid));
+    if (d->type == Protocol::TypeNotify)
+        return d->notifyId;
 
     return Protocol::NotifyInvalid;
 }
@@ -337,7 +579,7 @@ Protocol::NotifyId Packet::notifyId() const
  */
 QJsonValue Packet::value() const
 {
-    return d->value(QStringLiteral("value"));
+    return d->value;
 }
 
 /**
@@ -345,12 +587,59 @@ QJsonValue Packet::value() const
  * @return serialized byte array for sending
  *
  * To deserialize the returned QByteArray, use @c Packet::fromJson() function.
+ *
+ * The result is cached, so copies of a packet share one serialized byte array. Copies may be serialized from several
+ * threads at once, and reading the cached result takes no lock.
  */
 QByteArray Packet::serialize() const
 {
     // TODO: abnormal case
-    QJsonDocument doc(*d);
-    return doc.toJson(QJsonDocument::Compact);
+    if (QByteArray cached = d->serializedJson.value(); !cached.isNull())
+        return cached;
+
+    QJsonDocument doc(d->toJsonObject());
+    return d->serializedJson.publish(doc.toJson(QJsonDocument::Compact));
+}
+
+/**
+ * @brief serialize the packet with specified codec
+ * @param codec the codec
+ * @return serialized byte array for sending
+ *
+ * To deserialize the returned QByteArray, use @c Packet::deserialize() function.
+ */
+QByteArray Packet::serialize(Protocol::Codec codec) const
+{
+    if (codec == Protocol::CodecCbor) {
+        if (QByteArray cached = d->serializedCbor.value(); !cached.isNull())
+            return cached;
+
+        QCborMap map;
+        map.insert(QStringLiteral("type"), static_cast<int>(d->type));
+        map.insert(QStringLiteral("requestId"), static_cast<int>(d->requestId));
+        map.insert(QStringLiteral("notifyId"), static_cast<int>(d->notifyId));
+        map.insert(QStringLiteral("value"), QCborValue::fromJsonValue(d->value));
+        return d->serializedCbor.publish(map.toCborValue().toCbor());
+    }
+
+    return serialize();
+}
+
+/**
+ * @brief compress the packet serialized with specified codec
+ * @param codec the codec
+ * @return the serialized packet compressed by @c qCompress()
+ *
+ * The result is cached like the serialized packet, so a packet sent compressed to many peers is compressed only once.
+ * It may be larger than the serialized packet if the packet doesn't compress.
+ */
+QByteArray Packet::compress(Protocol::Codec codec) const
+{
+    const PacketCache &compressed = (codec == Protocol::CodecCbor) ? d->compressedCbor : d->compressedJson;
+    if (QByteArray cached = compressed.value(); !cached.isNull())
+        return cached;
+
+    return compressed.publish(qCompress(serialize(codec)));
 }
 
 /**
@@ -408,52 +697,70 @@ Packet Packet::fromJson(const QByteArray &serialized, QString *errorString)
         return ret;
     }
 
-    *(ret.d) = doc.object();
-
-    if (!ret.d->contains(QStringLiteral("type"))) {
-        *errorString = QStringLiteral("'type' is non-existent");
-        ret.d->error = *errorString;
-        return ret;
-    }
-    if (!ret.d->value(QStringLiteral("type")).isDouble()) {
-        *errorString = QStringLiteral("'type' is not number");
+    if (!readPacket(doc.object(), ret.d.data(), errorString))
         ret.d->error = *errorString;
-        return ret;
-    }
 
-    if (!ret.d->contains(QStringLiteral("requestId"))) {
-        *errorString = QStringLiteral("'requestId' is non-existent");
-        ret.d->error = *errorString;
-        return ret;
-    }
-    if (!ret.d->value(QStringLiteral("requestId")).isDouble()) {
-        *errorString = QStringLiteral("'requestId' is not number");
-        ret.d->error = *errorString;
-        return ret;
+    return ret;
+}
+
+/**
+ * @brief deserialize the CBOR byte array
+ * @param serialized the serialized byte array
+ * @param errorString (out) the optional error string
+ * @return the deserialized packet
+ *
+ * This does the opposite of @c Packet::serialize() function with @c Protocol::CodecCbor .
+ */
+Packet Packet::fromCbor(const QByteArray &serialized, QString *errorString)
+{
+    if (errorString == nullptr) {
+        static QString _errorString;
+        errorString = &_errorString;
     }
 
-    if (!ret.d->contains(QStringLiteral("notifyId"))) {
-        *errorString = QStringLiteral("'notifyId' is non-existent");
+    errorString->clear();
+
+    Packet ret;
+
+    QCborParserError err;
+    QCborValue value = QCborValue::fromCbor(serialized, &err);
+
+    if (err.error != QCborError::NoError) {
+        *errorString = QStringLiteral("Cbor error: ").append(err.errorString());
         ret.d->error = *errorString;
         return ret;
     }
-    if (!ret.d->value(QStringLiteral("notifyId")).isDouble()) {
-        *errorString = QStringLiteral("'notifyId' is not number");
+
+    if (!value.isMap()) {
+        *errorString = QStringLiteral("Document is not object");
         ret.d->error = *errorString;
         return ret;
     }
 
-    if (!ret.d->contains(QStringLiteral("value"))) {
-        *errorString = QStringLiteral("'value' is non-existent");
+    if (!readPacket(value.toMap(), ret.d.data(), errorString))
         ret.d->error = *errorString;
-        return ret;
-    }
 
     return ret;
 }
 
+/**
+ * @brief deserialize the byte array in either codec
+ * @param serialized the serialized byte array
+ * @param errorString (out) the optional error string
+ * @return the deserialized packet
+ *
+ * The codec is detected using @c Protocol::detectCodec() .
+ */
+Packet Packet::deserialize(const QByteArray &serialized, QString *errorString)
+{
+    if (Protocol::detectCodec(serialized) == Protocol::CodecCbor)
+        return fromCbor(serialized, errorString);
+
+    return fromJson(serialized, errorString);
+}
+
 #ifndef DOXYGEN
-} // namespace v0
+} // namespace v1
 #endif
 
 } // namespace QMdmmCore
@@ -6,10 +6,24 @@
 #include "qmdmmcoreglobal.h"
 
 #include <QByteArray>
+#include <QHash>
+#include <QJsonArray>
 #include <QJsonObject>
+#include <QJsonValue>
+#include <QList>
 #include <QSharedData>
+#include <QString>
+#include <QStringList>
 
+#include <array>
+#include <atomic>
 #include <cstdint>
+#include <initializer_list>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
 
 QMDMM_EXPORT_NAME(QMdmmProtocol)
 QMDMM_EXPORT_NAME(QMdmmPacket)
@@ -39,7 +53,7 @@ enum NotifyId : uint16_t
 
     NotifyFromServerMask = 0x1000,
     NotifyPongServer, // int ping-id
-    NotifyVersion, // string versionNumber, int protocolVersion
+    NotifyVersion, // string versionNumber, int protocolVersion, optional array { int(Codec) } codecs, optional array { int(Socket::Framing) } framings, optional bool batching, optional int compressionThreshold, optional int maximumFrameSize
 
     NotifyFromAgentMask = 0x2000,
     NotifyLogicConfiguration, // broadcast, object (see QMdmmCore::LogicConfiguration in qmdmmlogic.h)
@@ -56,10 +70,11 @@ enum NotifyId : uint16_t
     NotifyGameOver, // broadcast, string winnerPlayerName
     NotifySpoken, // broadcast, string playerName, string content
     NotifyOperated, // TODO: for ob
+    NotifyRoomSnapshot, // object { int(Logic::State) state, array { object (see PlayerSnapshot below) } players }
 
     NotifyToServerMask = 0x4000,
     NotifyPingServer, // int ping-id
-    NotifySignIn, // string playerName, string screenName, int(AgentState) agentState
+    NotifySignIn, // string playerName, string screenName, int(AgentState) agentState, optional int(Codec) codec, optional int(Socket::Framing) framing, optional bool batching, optional bool compression, optional int maximumFrameSize
     NotifyObserve, // string observerName, string playerName
 
     NotifyToAgentMask = 0x8000,
@@ -76,26 +91,783 @@ enum PacketType : uint8_t
     TypeNotify,
 };
 
+enum Codec : uint8_t
+{
+    CodecJson = 0, // a JSON object, encoded in a single line
+    CodecCbor, // a CBOR map with the same keys, see RFC 8949
+};
+
 QMDMMCORE_EXPORT extern int version() noexcept;
+QMDMMCORE_EXPORT extern Codec detectCodec(const QByteArray &serialized) noexcept;
+
+// Dispatch tables
+// RequestIds are small consecutive numbers, and NotifyIds are consecutive inside each direction mask.
+// So a handler is found by indexing an array instead of hashing the ID.
+
+inline constexpr int RequestIdCount = RequestUpgrade + 1;
+inline constexpr int NotifyIdGroupSize = 0x20;
+inline constexpr int NotifyIdGroupCount = 4;
+
+[[nodiscard]] constexpr int dispatchIndex(RequestId id) noexcept
+{
+    return (id < RequestIdCount) ? static_cast<int>(id) : -1;
+}
+
+[[nodiscard]] constexpr int dispatchIndex(NotifyId id) noexcept
+{
+    int group = -1;
+    switch (id & 0xff00) {
+    case NotifyFromServerMask:
+        group = 0;
+        break;
+    case NotifyFromAgentMask:
+        group = 1;
+        break;
+    case NotifyToServerMask:
+        group = 2;
+        break;
+    case NotifyToAgentMask:
+        group = 3;
+        break;
+    default:
+        return -1;
+    }
+
+    int offset = id & 0xff;
+    if (offset >= NotifyIdGroupSize)
+        return -1;
+
+    return group * NotifyIdGroupSize + offset;
+}
+
+template<typename Id>
+inline constexpr int DispatchTableSize = 0;
+template<>
+inline constexpr int DispatchTableSize<RequestId> = RequestIdCount;
+template<>
+inline constexpr int DispatchTableSize<NotifyId> = NotifyIdGroupCount * NotifyIdGroupSize;
+
+template<typename Id, typename Handler>
+class DispatchTable final
+{
+public:
+    DispatchTable(std::initializer_list<std::pair<Id, Handler>> handlers)
+    {
+        for (const std::pair<Id, Handler> &handler : handlers) {
+            int index = dispatchIndex(handler.first);
+            Q_ASSERT(index != -1);
+            table[index] = handler.second;
+        }
+    }
+
+    [[nodiscard]] Handler value(Id id) const noexcept
+    {
+        int index = dispatchIndex(id);
+        if (index == -1)
+            return Handler {};
+        return table[index];
+    }
+
+private:
+    std::array<Handler, DispatchTableSize<Id>> table {};
+};
+
+// Payload description
+// Every payload is described once here. The encoder and decoder of each payload are generated from its description.
+
+// How a single value is converted from / to JSON. decode() returns false if the value doesn't fit.
+template<typename T>
+struct FieldTraits;
+
+// Number of the valid values of an enum, whose values are consecutive from 0
+template<typename E>
+inline constexpr int EnumValueCount = 0;
+template<>
+inline constexpr int EnumValueCount<Data::StoneScissorsCloth> = Data::Cloth + 1;
+template<>
+inline constexpr int EnumValueCount<Data::Action> = Data::LetMove + 1;
+template<>
+inline constexpr int EnumValueCount<Data::UpgradeItem> = Data::UpgradeMaxHp + 1;
+template<>
+inline constexpr int EnumValueCount<Codec> = CodecCbor + 1;
+
+template<>
+struct FieldTraits<bool>
+{
+    static bool decode(const QJsonValue &value, bool *out)
+    {
+        if (!value.isBool())
+            return false;
+        *out = value.toBool();
+        return true;
+    }
+    static QJsonValue encode(bool value)
+    {
+        return value;
+    }
+};
+
+template<>
+struct FieldTraits<int>
+{
+    static bool decode(const QJsonValue &value, int *out)
+    {
+        if (!value.isDouble())
+            return false;
+        *out = value.toInt();
+        return true;
+    }
+    static QJsonValue encode(int value)
+    {
+        return value;
+    }
+};
+
+template<>
+struct FieldTraits<qint64>
+{
+    static bool decode(const QJsonValue &value, qint64 *out)
+    {
+        if (!value.isDouble())
+            return false;
+        *out = value.toInteger();
+        return true;
+    }
+    static QJsonValue encode(qint64 value)
+    {
+        return value;
+    }
+};
+
+template<>
+struct FieldTraits<QString>
+{
+    static bool decode(const QJsonValue &value, QString *out)
+    {
+        if (!value.isString())
+            return false;
+        *out = value.toString();
+        return true;
+    }
+    static QJsonValue encode(const QString &value)
+    {
+        return value;
+    }
+};
+
+template<typename E>
+    requires std::is_enum_v<E>
+struct FieldTraits<E>
+{
+    static_assert(EnumValueCount<E> > 0, "Add EnumValueCount for the enum");
+
+    static bool decode(const QJsonValue &value, E *out)
+    {
+        if (!value.isDouble())
+            return false;
+        int i = value.toInt(-1);
+        if (i < 0 || i >= EnumValueCount<E>)
+            return false;
+        *out = static_cast<E>(i);
+        return true;
+    }
+    static QJsonValue encode(E value)
+    {
+        return static_cast<int>(value);
+    }
+};
+
+template<typename E>
+struct FieldTraits<QFlags<E>>
+{
+    static bool decode(const QJsonValue &value, QFlags<E> *out)
+    {
+        if (!value.isDouble())
+            return false;
+        *out = QFlags<E>(static_cast<typename QFlags<E>::Int>(value.toInt()));
+        return true;
+    }
+    static QJsonValue encode(const QFlags<E> &value)
+    {
+        return static_cast<int>(typename QFlags<E>::Int(value));
+    }
+};
+
+template<typename T>
+struct FieldTraits<QList<T>>
+{
+    static bool decode(const QJsonValue &value, QList<T> *out)
+    {
+        if (!value.isArray())
+            return false;
+        QJsonArray arr = value.toArray();
+        out->clear();
+        out->reserve(arr.size());
+        for (QJsonArray::const_iterator it = arr.constBegin(); it != arr.constEnd(); ++it) {
+            T item {};
+            if (!FieldTraits<T>::decode(*it, &item))
+                return false;
+            out->append(std::move(item));
+        }
+        return true;
+    }
+    static QJsonValue encode(const QList<T> &value)
+    {
+        QJsonArray arr;
+        for (const T &item : value)
+            arr.append(FieldTraits<T>::encode(item));
+        return arr;
+    }
+};
+
+template<typename T>
+struct FieldTraits<QHash<QString, T>>
+{
+    static bool decode(const QJsonValue &value, QHash<QString, T> *out)
+    {
+        if (!value.isObject())
+            return false;
+        QJsonObject ob = value.toObject();
+        out->clear();
+        out->reserve(ob.size());
+        for (QJsonObject::const_iterator it = ob.constBegin(); it != ob.constEnd(); ++it) {
+            T item {};
+            if (!FieldTraits<T>::decode(it.value(), &item))
+                return false;
+            out->insert(it.key(), std::move(item));
+        }
+        return true;
+    }
+    static QJsonValue encode(const QHash<QString, T> &value)
+    {
+        QJsonObject ob;
+        for (typename QHash<QString, T>::const_iterator it = value.constBegin(); it != value.constEnd(); ++it)
+            ob.insert(it.key(), FieldTraits<T>::encode(it.value()));
+        return ob;
+    }
+};
+
+// A field which may be absent. An absent optional field is not encoded.
+template<typename T>
+struct FieldTraits<std::optional<T>>
+{
+    static bool decode(const QJsonValue &value, std::optional<T> *out)
+    {
+        T item {};
+        if (!FieldTraits<T>::decode(value, &item))
+            return false;
+        *out = std::move(item);
+        return true;
+    }
+};
+
+// An empty payload
+template<>
+struct FieldTraits<std::monostate>
+{
+    static bool decode(const QJsonValue & /*value*/, std::monostate * /*out*/)
+    {
+        return true;
+    }
+    static QJsonValue encode(std::monostate /*value*/)
+    {
+        return {};
+    }
+};
+
+// A payload which is not specified yet, passed as-is
+template<>
+struct FieldTraits<QJsonValue>
+{
+    static bool decode(const QJsonValue &value, QJsonValue *out)
+    {
+        *out = value;
+        return true;
+    }
+    static QJsonValue encode(const QJsonValue &value)
+    {
+        return value;
+    }
+};
+
+template<typename T>
+inline constexpr bool IsOptionalField = false;
+template<typename T>
+inline constexpr bool IsOptionalField<std::optional<T>> = true;
+
+// A field of a payload which is encoded as a JSON object. The key is the name of the struct member.
+template<typename Struct, typename T>
+struct Field
+{
+    using Type = T;
+
+    const char *name;
+    T Struct::*member;
+};
+
+#define QMDMM_PAYLOAD_FIELD(Struct, member) Field<Struct, decltype(Struct::member)> {#member, &Struct::member}
+
+// Specialize PayloadDescription for a payload struct, with a constexpr tuple "fields" of Field.
+// An optional static function "validate" checks the decoded payload for rules across fields.
+template<typename T>
+struct PayloadDescription
+{
+};
+
+template<typename T>
+concept DescribedPayload = requires { PayloadDescription<T>::fields; };
+
+template<typename T>
+[[nodiscard]] bool decodePayload(const QJsonValue &value, T *payload);
+template<typename T>
+[[nodiscard]] QJsonValue encodePayload(const T &payload);
+
+// A described payload nested in another one, such as an entry of a list
+template<DescribedPayload T>
+struct FieldTraits<T>
+{
+    static bool decode(const QJsonValue &value, T *out)
+    {
+        return decodePayload(value, out);
+    }
+    static QJsonValue encode(const T &value)
+    {
+        return encodePayload(value);
+    }
+};
+
+// payload structs
+
+struct StoneScissorsClothRequest
+{
+    QStringList playerNames;
+    int strivedOrder = 0;
+};
+
+struct ActionOrderRequest
+{
+    QList<int> remainedOrders;
+    int maximumOrder = 0;
+    int selectionNum = 0;
+};
+
+struct ActionReply
+{
+    Data::Action action = Data::DoNothing;
+    std::optional<QString> toPlayer;
+    std::optional<int> toPlace;
+};
+
+struct VersionNotify
+{
+    QString versionNumber;
+    int protocolVersion = 0;
+    // Unknown entries are skipped by receiver, so these are not lists of enums
+    std::optional<QList<int>> codecs;
+    std::optional<QList<int>> framings;
+    std::optional<bool> batching;
+    std::optional<int> compressionThreshold;
+    // the largest frame the sender accepts, which a batch sent to it must not exceed
+    std::optional<int> maximumFrameSize;
+};
+
+struct AgentStateChangedNotify
+{
+    QString playerName;
+    Data::AgentState agentState;
+};
+
+struct PlayerAddedNotify
+{
+    QString playerName;
+    QString screenName;
+    Data::AgentState agentState;
+};
+
+struct PlayerRemovedNotify
+{
+    QString playerName;
+};
+
+struct ActionNotify
+{
+    QString playerName;
+    Data::Action action = Data::DoNothing;
+    std::optional<QString> toPlayer;
+    std::optional<int> toPlace;
+};
+
+struct SpokenNotify
+{
+    QString playerName;
+    QString content;
+};
+
+struct SignInNotify
+{
+    QString playerName;
+    QString screenName;
+    Data::AgentState agentState;
+    // A Codec and a Socket::Framing, which are only trusted after the receiver checked them
+    std::optional<int> codec;
+    std::optional<int> framing;
+    std::optional<bool> batching;
+    std::optional<bool> compression;
+    // the largest frame the sender accepts, which a batch sent to it must not exceed
+    std::optional<int> maximumFrameSize;
+};
+
+// The state of a player in a room snapshot. The identity comes from its agent, and the rest from its Player
+struct PlayerSnapshot
+{
+    QString playerName;
+    QString screenName;
+    Data::AgentState agentState;
+    bool hasKnife = false;
+    bool hasHorse = false;
+    int hp = 0;
+    int place = 0;
+    int initialPlace = 0;
+    int knifeDamage = 0;
+    int horseDamage = 0;
+    int maxHp = 0;
+    int upgradePoint = 0;
+};
+
+struct RoomSnapshotNotify
+{
+    int state = 0; // Logic::State
+    QList<PlayerSnapshot> players;
+};
+
+// An action to a player comes with the player, and an action to a place comes with the place
+template<typename T>
+[[nodiscard]] bool validateActionTarget(const T &payload)
+{
+    switch (payload.action) {
+    case Data::Slash:
+    case Data::Kick:
+        return payload.toPlayer.has_value();
+    case Data::Move:
+        return payload.toPlace.has_value();
+    case Data::LetMove:
+        return payload.toPlayer.has_value() && payload.toPlace.has_value();
+    default:
+        break;
+    }
+    return true;
+}
+
+template<>
+struct PayloadDescription<StoneScissorsClothRequest>
+{
+    static constexpr auto fields = std::make_tuple(QMDMM_PAYLOAD_FIELD(StoneScissorsClothRequest, playerNames), QMDMM_PAYLOAD_FIELD(StoneScissorsClothRequest, strivedOrder));
+};
+
+template<>
+struct PayloadDescription<ActionOrderRequest>
+{
+    static constexpr auto fields = std::make_tuple(QMDMM_PAYLOAD_FIELD(ActionOrderRequest, remainedOrders), QMDMM_PAYLOAD_FIELD(ActionOrderRequest, maximumOrder),
+                                                   QMDMM_PAYLOAD_FIELD(ActionOrderRequest, selectionNum));
+};
+
+template<>
+struct PayloadDescription<ActionReply>
+{
+    static constexpr auto fields = std::make_tuple(QMDMM_PAYLOAD_FIELD(ActionReply, action), QMDMM_PAYLOAD_FIELD(ActionReply, toPlayer), QMDMM_PAYLOAD_FIELD(ActionReply, toPlace));
+    static bool validate(const ActionReply &payload)
+    {
+        return validateActionTarget(payload);
+    }
+};
+
+template<>
+struct PayloadDescription<VersionNotify>
+{
+    static constexpr auto fields = std::make_tuple(QMDMM_PAYLOAD_FIELD(VersionNotify, versionNumber), QMDMM_PAYLOAD_FIELD(VersionNotify, protocolVersion),
+                                                   QMDMM_PAYLOAD_FIELD(VersionNotify, codecs), QMDMM_PAYLOAD_FIELD(VersionNotify, framings),
+                                                   QMDMM_PAYLOAD_FIELD(VersionNotify, batching), QMDMM_PAYLOAD_FIELD(VersionNotify, compressionThreshold),
+                                                   QMDMM_PAYLOAD_FIELD(VersionNotify, maximumFrameSize));
+};
+
+template<>
+struct PayloadDescription<AgentStateChangedNotify>
+{
+    static constexpr auto fields = std::make_tuple(QMDMM_PAYLOAD_FIELD(AgentStateChangedNotify, playerName), QMDMM_PAYLOAD_FIELD(AgentStateChangedNotify, agentState));
+};
+
+template<>
+struct PayloadDescription<PlayerAddedNotify>
+{
+    static constexpr auto fields = std::make_tuple(QMDMM_PAYLOAD_FIELD(PlayerAddedNotify, playerName), QMDMM_PAYLOAD_FIELD(PlayerAddedNotify, screenName),
+                                                   QMDMM_PAYLOAD_FIELD(PlayerAddedNotify, agentState));
+};
+
+template<>
+struct PayloadDescription<PlayerRemovedNotify>
+{
+    static constexpr auto fields = std::make_tuple(QMDMM_PAYLOAD_FIELD(PlayerRemovedNotify, playerName));
+};
+
+template<>
+struct PayloadDescription<ActionNotify>
+{
+    static constexpr auto fields = std::make_tuple(QMDMM_PAYLOAD_FIELD(ActionNotify, playerName), QMDMM_PAYLOAD_FIELD(ActionNotify, action),
+                                                   QMDMM_PAYLOAD_FIELD(ActionNotify, toPlayer), QMDMM_PAYLOAD_FIELD(ActionNotify, toPlace));
+    static bool validate(const ActionNotify &payload)
+    {
+        return validateActionTarget(payload);
+    }
+};
+
+template<>
+struct PayloadDescription<SpokenNotify>
+{
+    static constexpr auto fields = std::make_tuple(QMDMM_PAYLOAD_FIELD(SpokenNotify, playerName), QMDMM_PAYLOAD_FIELD(SpokenNotify, content));
+};
+
+template<>
+struct PayloadDescription<PlayerSnapshot>
+{
+    static constexpr auto fields = std::make_tuple(QMDMM_PAYLOAD_FIELD(PlayerSnapshot, playerName), QMDMM_PAYLOAD_FIELD(PlayerSnapshot, screenName),
+                                                   QMDMM_PAYLOAD_FIELD(PlayerSnapshot, agentState), QMDMM_PAYLOAD_FIELD(PlayerSnapshot, hasKnife),
+                                                   QMDMM_PAYLOAD_FIELD(PlayerSnapshot, hasHorse), QMDMM_PAYLOAD_FIELD(PlayerSnapshot, hp),
+                                                   QMDMM_PAYLOAD_FIELD(PlayerSnapshot, place), QMDMM_PAYLOAD_FIELD(PlayerSnapshot, initialPlace),
+                                                   QMDMM_PAYLOAD_FIELD(PlayerSnapshot, knifeDamage), QMDMM_PAYLOAD_FIELD(PlayerSnapshot, horseDamage),
+                                                   QMDMM_PAYLOAD_FIELD(PlayerSnapshot, maxHp), QMDMM_PAYLOAD_FIELD(PlayerSnapshot, upgradePoint));
+};
+
+template<>
+struct PayloadDescription<RoomSnapshotNotify>
+{
+    static constexpr auto fields = std::make_tuple(QMDMM_PAYLOAD_FIELD(RoomSnapshotNotify, state), QMDMM_PAYLOAD_FIELD(RoomSnapshotNotify, players));
+};
+
+template<>
+struct PayloadDescription<SignInNotify>
+{
+    static constexpr auto fields = std::make_tuple(QMDMM_PAYLOAD_FIELD(SignInNotify, playerName), QMDMM_PAYLOAD_FIELD(SignInNotify, screenName),
+                                                   QMDMM_PAYLOAD_FIELD(SignInNotify, agentState), QMDMM_PAYLOAD_FIELD(SignInNotify, codec),
+                                                   QMDMM_PAYLOAD_FIELD(SignInNotify, framing), QMDMM_PAYLOAD_FIELD(SignInNotify, batching),
+                                                   QMDMM_PAYLOAD_FIELD(SignInNotify, compression), QMDMM_PAYLOAD_FIELD(SignInNotify, maximumFrameSize));
+};
+
+#undef QMDMM_PAYLOAD_FIELD
+
+// The payload types of each request / reply / notify.
+// NotifyLogicConfiguration is described by QMdmmCore::LogicConfiguration itself, and it is not listed here.
+
+template<RequestId Id>
+struct RequestPayload;
+
+template<>
+struct RequestPayload<RequestStoneScissorsCloth>
+{
+    using Request = StoneScissorsClothRequest;
+    using Reply = Data::StoneScissorsCloth;
+};
+
+template<>
+struct RequestPayload<RequestActionOrder>
+{
+    using Request = ActionOrderRequest;
+    using Reply = QList<int>;
+};
+
+template<>
+struct RequestPayload<RequestAction>
+{
+    using Request = int; // current order
+    using Reply = ActionReply;
+};
+
+template<>
+struct RequestPayload<RequestUpgrade>
+{
+    using Request = int; // remaining times
+    using Reply = QList<Data::UpgradeItem>;
+};
+
+template<NotifyId Id>
+struct NotifyPayload;
+
+#define QMDMM_NOTIFY_PAYLOAD(Id, ...) \
+    template<>                        \
+    struct NotifyPayload<Id>          \
+    {                                 \
+        using Type = __VA_ARGS__;     \
+    }
+
+QMDMM_NOTIFY_PAYLOAD(NotifyPongServer, qint64);
+QMDMM_NOTIFY_PAYLOAD(NotifyVersion, VersionNotify);
+QMDMM_NOTIFY_PAYLOAD(NotifyAgentStateChanged, AgentStateChangedNotify);
+QMDMM_NOTIFY_PAYLOAD(NotifyPlayerAdded, PlayerAddedNotify);
+QMDMM_NOTIFY_PAYLOAD(NotifyPlayerRemoved, PlayerRemovedNotify);
+QMDMM_NOTIFY_PAYLOAD(NotifyGameStart, std::monostate);
+QMDMM_NOTIFY_PAYLOAD(NotifyRoundStart, std::monostate);
+QMDMM_NOTIFY_PAYLOAD(NotifyStoneScissorsCloth, QHash<QString, Data::StoneScissorsCloth>);
+QMDMM_NOTIFY_PAYLOAD(NotifyActionOrder, QStringList);
+QMDMM_NOTIFY_PAYLOAD(NotifyAction, ActionNotify);
+QMDMM_NOTIFY_PAYLOAD(NotifyRoundOver, std::monostate);
+QMDMM_NOTIFY_PAYLOAD(NotifyUpgrade, QHash<QString, QList<Data::UpgradeItem>>);
+QMDMM_NOTIFY_PAYLOAD(NotifyGameOver, QStringList);
+QMDMM_NOTIFY_PAYLOAD(NotifySpoken, SpokenNotify);
+QMDMM_NOTIFY_PAYLOAD(NotifyOperated, QJsonValue);
+QMDMM_NOTIFY_PAYLOAD(NotifyRoomSnapshot, RoomSnapshotNotify);
+QMDMM_NOTIFY_PAYLOAD(NotifyPingServer, qint64);
+QMDMM_NOTIFY_PAYLOAD(NotifySignIn, SignInNotify);
+QMDMM_NOTIFY_PAYLOAD(NotifyObserve, QJsonValue);
+QMDMM_NOTIFY_PAYLOAD(NotifySpeak, QString); // Base64 encoded UTF-8 content
+QMDMM_NOTIFY_PAYLOAD(NotifyOperate, QJsonValue);
+
+#undef QMDMM_NOTIFY_PAYLOAD
+
+template<RequestId Id>
+using RequestPayloadType = typename RequestPayload<Id>::Request;
+template<RequestId Id>
+using ReplyPayloadType = typename RequestPayload<Id>::Reply;
+template<NotifyId Id>
+using NotifyPayloadType = typename NotifyPayload<Id>::Type;
+
+// generated encoder / decoder
+
+#ifndef DOXYGEN
+namespace PayloadPrivate {
+template<typename T, std::size_t... I>
+bool decodeFields(const QJsonObject &ob, T *payload, std::index_sequence<I...> /*indexes*/)
+{
+    constexpr const auto &fields = PayloadDescription<T>::fields;
+    static_assert(sizeof...(I) <= 32);
+    constexpr uint32_t required = (0U | ... | (IsOptionalField<typename std::tuple_element_t<I, std::remove_cvref_t<decltype(fields)>>::Type> ? 0U : (1U << I)));
+
+    // A single pass over the object. Each key is matched against the field names, and unknown keys are ignored
+    uint32_t found = 0;
+    for (QJsonObject::const_iterator it = ob.constBegin(); it != ob.constEnd(); ++it) {
+        QAnyStringView key = it.keyView();
+        bool ok = true;
+        auto decodeIfMatches = [&](const auto &field, uint32_t bit) -> bool {
+            if (key != QLatin1StringView(field.name))
+                return false;
+            found |= bit;
+            using FieldType = typename std::remove_cvref_t<decltype(field)>::Type;
+            ok = FieldTraits<FieldType>::decode(it.value(), &(payload->*(field.member)));
+            return true;
+        };
+        (decodeIfMatches(std::get<I>(fields), 1U << I) || ...);
+        if (!ok)
+            return false;
+    }
+
+    return (found & required) == required;
+}
+
+template<typename T, typename F>
+void encodeField(QJsonObject *ob, const F &field, const T &payload)
+{
+    using FieldType = typename F::Type;
+    const FieldType &value = payload.*(field.member);
+    if constexpr (IsOptionalField<FieldType>) {
+        if (value.has_value())
+            ob->insert(QLatin1StringView(field.name), FieldTraits<typename FieldType::value_type>::encode(*value));
+    } else {
+        ob->insert(QLatin1StringView(field.name), FieldTraits<FieldType>::encode(value));
+    }
+}
+} // namespace PayloadPrivate
+#endif
+
+template<typename T>
+[[nodiscard]] bool decodePayload(const QJsonValue &value, T *payload)
+{
+    if constexpr (DescribedPayload<T>) {
+        if (!value.isObject())
+            return false;
+        constexpr std::size_t fieldCount = std::tuple_size_v<std::remove_cv_t<decltype(PayloadDescription<T>::fields)>>;
+        if (!PayloadPrivate::decodeFields(value.toObject(), payload, std::make_index_sequence<fieldCount> {}))
+            return false;
+        if constexpr (requires { PayloadDescription<T>::validate(*payload); })
+            return PayloadDescription<T>::validate(*payload);
+        return true;
+    } else {
+        return FieldTraits<T>::decode(value, payload);
+    }
+}
+
+template<typename T>
+[[nodiscard]] QJsonValue encodePayload(const T &payload)
+{
+    if constexpr (DescribedPayload<T>) {
+        QJsonObject ob;
+        std::apply([&ob, &payload](const auto &...field) { (PayloadPrivate::encodeField(&ob, field, payload), ...); }, PayloadDescription<T>::fields);
+        return ob;
+    } else {
+        return FieldTraits<T>::encode(payload);
+    }
+}
 
 } // namespace Protocol
 
 #ifndef DOXYGEN
+} // namespace v0
+
+// PacketData of v0 inherited QJsonObject. That of v1 holds the header fields and the cached serialized forms instead,
+// which is a different layout, so Packet and PacketData are defined in v1 rather than taken from v0. A binary built
+// against v0 fails to link with this library instead of misreading a PacketData
+inline namespace v1 {
+namespace Protocol = v0::Protocol; // NOLINT(misc-unused-alias-decls)
+
+// A serialized form of a packet, made once and then read by every copy of the packet, from any thread. It is published
+// through an atomic pointer, so reading it takes no lock. Two threads may make it at once, then the first one is kept
+class QMDMMCORE_EXPORT PacketCache final
+{
+public:
+    PacketCache() = default;
+    PacketCache(const PacketCache &other);
+    PacketCache &operator=(const PacketCache &) = delete;
+    ~PacketCache();
+
+    // a null array if it is not made yet
+    [[nodiscard]] QByteArray value() const;
+    // returns the form which is kept
+    QByteArray publish(const QByteArray &serialized) const;
+    // only while the packet is not shared
+    void clear();
+
+private:
+    mutable std::atomic<QByteArray *> bytes {nullptr};
+};
+
 // Cannot pimpl following class since it inherits QSharedData
-// So put it to header file and inherit QJsonObject, in order not to affect binary compatibility when more data come in
-// ATTENTION: neither of the inherited 2 classes have virtual dtor
+// The header fields are plain integers so that reading them is cheap. The JSON object is only built when serializing
+// ATTENTION: QSharedData doesn't have virtual dtor
 
 // documentation is not needed since it is purely internal to QMdmmCore::Packet
-struct QMDMMCORE_EXPORT PacketData final : public QSharedData, public QJsonObject
+struct QMDMMCORE_EXPORT PacketData final : public QSharedData
 {
     PacketData();
     PacketData(Protocol::PacketType type, Protocol::RequestId requestId, Protocol::NotifyId notifyId, const QJsonValue &value);
 
-    PacketData(const QJsonObject &ob) noexcept(noexcept(QJsonObject(ob)));
-    PacketData &operator=(const QJsonObject &ob) noexcept(noexcept(QJsonObject::operator=(ob)));
+    PacketData(const QJsonObject &ob); // NOLINT(google-explicit-constructor)
+    PacketData &operator=(const QJsonObject &ob);
+
+    [[nodiscard]] QJsonObject toJsonObject() const;
+
+    // NOLINTBEGIN(misc-non-private-member-variables-in-classes)
+    Protocol::PacketType type;
+    Protocol::RequestId requestId;
+    Protocol::NotifyId notifyId;
+    QJsonValue value;
 
-    // NOLINTNEXTLINE(misc-non-private-member-variables-in-classes)
     QString error;
+
+    // A packet is immutable once created, so its serialized forms are cached.
+    // A broadcast packet shared by all recipients is serialized only once this way.
+    PacketCache serializedJson;
+    PacketCache serializedCbor;
+    // Same for the compressed forms, so a broadcast packet is compressed only once as well
+    PacketCache compressedJson;
+    PacketCache compressedCbor;
+    // NOLINTEND(misc-non-private-member-variables-in-classes)
 };
 #endif
 
@@ -112,6 +884,8 @@ public:
     [[nodiscard]] QJsonValue value() const;
 
     [[nodiscard]] QByteArray serialize() const;
+    [[nodiscard]] QByteArray serialize(Protocol::Codec codec) const;
+    [[nodiscard]] QByteArray compress(Protocol::Codec codec) const;
     [[nodiscard]] operator QByteArray() const
     {
         return serialize();
@@ -119,6 +893,8 @@ public:
     bool hasError(QString *errorString = nullptr) const;
 
     static QMDMMCORE_EXPORT Packet fromJson(const QByteArray &serialized, QString *errorString = nullptr);
+    static QMDMMCORE_EXPORT Packet fromCbor(const QByteArray &serialized, QString *errorString = nullptr);
+    static QMDMMCORE_EXPORT Packet deserialize(const QByteArray &serialized, QString *errorString = nullptr);
 
 #ifndef DOXYGEN
 private:
@@ -127,16 +903,40 @@ private:
 };
 
 #ifndef DOXYGEN
-} // namespace v0
-inline namespace v1 {
-using v0::Packet;
-using v0::PacketData;
-namespace Protocol = v0::Protocol; // NOLINT(misc-unused-alias-decls)
 } // namespace v1
+namespace v0 {
+#endif
+
+namespace Protocol {
+// typed packets, whose payloads are encoded with the description above
+
+template<RequestId Id>
+[[nodiscard]] Packet requestPacket(const RequestPayloadType<Id> &payload)
+{
+    return Packet(TypeRequest, Id, encodePayload(payload));
+}
+
+template<RequestId Id>
+[[nodiscard]] Packet replyPacket(const ReplyPayloadType<Id> &payload)
+{
+    return Packet(TypeReply, Id, encodePayload(payload));
+}
+
+template<NotifyId Id>
+[[nodiscard]] Packet notifyPacket(const NotifyPayloadType<Id> &payload)
+{
+    return Packet(Id, encodePayload(payload));
+}
+} // namespace Protocol
+
+#ifndef DOXYGEN
+} // namespace v0
 #endif
 
 } // namespace QMdmmCore
 
 Q_DECLARE_METATYPE(QMdmmCore::Packet)
+// Queued from the Logic to its LogicRunner with Logic::snapshotResult
+Q_DECLARE_METATYPE(QMdmmCore::Protocol::RoomSnapshotNotify)
 
 #endif // QMDMMPROTOCOL_H
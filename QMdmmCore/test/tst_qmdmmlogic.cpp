@@ -438,6 +438,75 @@ private slots:
         QVERIFY(up.count() > 0);
         QCOMPARE(p->maxHp(), beforeMaxHp + 1);
     }
+
+    void QMdmmLogicsnapshot()
+    {
+        l->roundStart();
+        Player *p = l->d->room->player(QStringLiteral("test2"));
+        p->setHp(3);
+        p->setHasKnife(true);
+
+        QString snapshotPlayerName;
+        Protocol::RoomSnapshotNotify snapshot;
+        connect(l.get(), &Logic::snapshotResult, this, [&snapshotPlayerName, &snapshot](const QString &playerName, const Protocol::RoomSnapshotNotify &s) {
+            snapshotPlayerName = playerName;
+            snapshot = s;
+        });
+
+        // case 1: not a player of this logic
+        QVERIFY(!l->snapshot(QStringLiteral("test4")));
+        QVERIFY(snapshotPlayerName.isEmpty());
+
+        // case 2
+        QVERIFY(l->snapshot(QStringLiteral("test1")));
+        QCOMPARE(snapshotPlayerName, QStringLiteral("test1"));
+        QCOMPARE(snapshot.state, static_cast<int>(Logic::SscForAction));
+        QCOMPARE(snapshot.players.length(), 3);
+        QCOMPARE(snapshot.players.at(1).playerName, QStringLiteral("test2"));
+        QCOMPARE(snapshot.players.at(1).hp, 3);
+        QVERIFY(snapshot.players.at(1).hasKnife);
+        QCOMPARE(snapshot.players.at(1).place, p->place());
+        QCOMPARE(snapshot.players.at(1).maxHp, p->maxHp());
+    }
+
+    void QMdmmLogicrestore()
+    {
+        Player *p = l->d->room->player(QStringLiteral("test2"));
+        p->setMaxHp(p->maxHp() + 1);
+        p->setKnifeDamage(p->knifeDamage() + 1);
+        p->setUpgradePoint(2);
+
+        Protocol::RoomSnapshotNotify snapshot;
+        connect(l.get(), &Logic::snapshotResult, this, [&snapshot](const QString &, const Protocol::RoomSnapshotNotify &s) {
+            snapshot = s;
+        });
+
+        // an empty name is a snapshot for the owner
+        QVERIFY(l->snapshot(QString()));
+        QCOMPARE(snapshot.players.length(), 3);
+
+        // case 1
+        {
+            Logic restored(LogicConfiguration::defaults());
+            QVERIFY(restored.restore(snapshot));
+            QCOMPARE(restored.d->players, l->d->players);
+            const Player *r = restored.d->room->player(QStringLiteral("test2"));
+            QCOMPARE(r->maxHp(), p->maxHp());
+            QCOMPARE(r->knifeDamage(), p->knifeDamage());
+            QCOMPARE(r->upgradePoint(), 2);
+            QVERIFY(restored.roundStart());
+        }
+
+        // case 2: the logic has players already
+        QVERIFY(!l->restore(snapshot));
+
+        // case 3: taken in the middle of a round
+        {
+            Logic restored(LogicConfiguration::defaults());
+            snapshot.state = Logic::SscForAction;
+            QVERIFY(!restored.restore(snapshot));
+        }
+    }
 };
 
 namespace {
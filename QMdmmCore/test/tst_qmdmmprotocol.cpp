@@ -2,6 +2,10 @@
 
 #include <QMdmmCore/QMdmmProtocol>
 
+#include <QCborArray>
+#include <QCborMap>
+#include <QCborValue>
+#include <QJsonArray>
 #include <QJsonObject>
 #include <QTest>
 
@@ -136,6 +140,24 @@ private slots:
         }
     }
 
+    void QMdmmPacketserializeShared()
+    {
+        // A broadcast packet is copied to every recipient, and is serialized only once
+        Packet p(Protocol::NotifyGameOver, QJsonArray {QStringLiteral("Fsu0413")});
+        Packet copy = p;
+
+        QByteArray arr = p.serialize();
+        QCOMPARE(copy.serialize().constData(), arr.constData());
+
+        QByteArray arrCbor = p.serialize(Protocol::CodecCbor);
+        QCOMPARE(copy.serialize(Protocol::CodecCbor).constData(), arrCbor.constData());
+
+        // So is its compressed form
+        QByteArray compressed = p.compress(Protocol::CodecCbor);
+        QCOMPARE(copy.compress(Protocol::CodecCbor).constData(), compressed.constData());
+        QCOMPARE(qUncompress(compressed), arrCbor);
+    }
+
     void QMdmmPacketfromJsonhasError_data()
     {
         QTest::addColumn<QByteArray>("input");
@@ -210,6 +232,232 @@ private slots:
         }
     }
 
+    void QMdmmProtocoldetectCodec()
+    {
+        QCOMPARE(Protocol::detectCodec(QByteArray()), Protocol::CodecJson);
+        QCOMPARE(Protocol::detectCodec(QByteArray("{}")), Protocol::CodecJson);
+        QCOMPARE(Protocol::detectCodec(QByteArray("some_invalid")), Protocol::CodecJson);
+        QCOMPARE(Protocol::detectCodec(QCborValue(QCborMap()).toCbor()), Protocol::CodecCbor);
+    }
+
+    void QMdmmPacketserializeCbor()
+    {
+        QJsonObject ob;
+        ob.insert(QStringLiteral("playerNames"), QJsonArray {QStringLiteral("Fsu0413"), QStringLiteral("Fsu0414")});
+        ob.insert(QStringLiteral("strivedOrder"), 1);
+        Packet p(Protocol::TypeRequest, Protocol::RequestStoneScissorsCloth, ob);
+
+        QByteArray arr = p.serialize(Protocol::CodecCbor);
+        QCOMPARE(Protocol::detectCodec(arr), Protocol::CodecCbor);
+
+        // JSON is the default codec
+        QCOMPARE(p.serialize(Protocol::CodecJson), p.serialize());
+
+        QString errorString;
+        Packet p2 = Packet::deserialize(arr, &errorString);
+        QVERIFY(errorString.isEmpty());
+        QVERIFY(!p2.hasError());
+        QCOMPARE(p2.type(), Protocol::TypeRequest);
+        QCOMPARE(p2.requestId(), Protocol::RequestStoneScissorsCloth);
+        QCOMPARE(p2.value(), QJsonValue(ob));
+        QCOMPARE(p2.serialize(), p.serialize());
+    }
+
+    void QMdmmPacketfromCborhasError_data()
+    {
+        QTest::addColumn<QByteArray>("input");
+        QTest::addColumn<QString>("errorString");
+
+        QCborMap typeOnly;
+        typeOnly.insert(QStringLiteral("type"), 1);
+
+        QTest::newRow("not-object") << QCborValue(QCborArray {1, 2, 3}).toCbor() << QStringLiteral("Document is not object");
+        QTest::newRow("type-notexist") << QCborValue(QCborMap()).toCbor() << QStringLiteral("'type' is non-existent");
+        QTest::newRow("requestid-notexist") << QCborValue(typeOnly).toCbor() << QStringLiteral("'requestId' is non-existent");
+    }
+    void QMdmmPacketfromCborhasError()
+    {
+        QFETCH(QByteArray, input);
+        QFETCH(QString, errorString);
+
+        QString actualErrorString;
+        Packet p = Packet::fromCbor(input, &actualErrorString);
+
+        QCOMPARE(errorString, actualErrorString);
+        QVERIFY(p.hasError());
+    }
+    void QMdmmPacketfromCborhasError2()
+    {
+        QString actualErrorString;
+        // truncated CBOR map
+        (void)Packet::fromCbor(QByteArray("\xa1", 1), &actualErrorString);
+
+        bool r = actualErrorString.startsWith(QStringLiteral("Cbor error: "));
+        QVERIFY(r);
+    }
+
+    void QMdmmProtocoldispatchIndex()
+    {
+        QCOMPARE(Protocol::dispatchIndex(Protocol::RequestInvalid), 0);
+        QCOMPARE(Protocol::dispatchIndex(Protocol::RequestUpgrade), Protocol::RequestUpgrade);
+        QCOMPARE(Protocol::dispatchIndex(static_cast<Protocol::RequestId>(Protocol::RequestIdCount)), -1);
+
+        QCOMPARE(Protocol::dispatchIndex(Protocol::NotifyPongServer), 1);
+        QCOMPARE(Protocol::dispatchIndex(Protocol::NotifyLogicConfiguration), Protocol::NotifyIdGroupSize + 1);
+        QCOMPARE(Protocol::dispatchIndex(Protocol::NotifySpeak), Protocol::NotifyIdGroupSize * 3 + 1);
+        QCOMPARE(Protocol::dispatchIndex(static_cast<Protocol::NotifyId>(0x800)), -1);
+        QCOMPARE(Protocol::dispatchIndex(static_cast<Protocol::NotifyId>(Protocol::NotifyFromServerMask | Protocol::NotifyIdGroupSize)), -1);
+    }
+
+    void QMdmmProtocolDispatchTable()
+    {
+        Protocol::DispatchTable<Protocol::NotifyId, int> table {
+            std::make_pair(Protocol::NotifyPongServer, 1),
+            std::make_pair(Protocol::NotifySpoken, 2),
+            std::make_pair(Protocol::NotifyOperate, 3),
+        };
+
+        QCOMPARE(table.value(Protocol::NotifyPongServer), 1);
+        QCOMPARE(table.value(Protocol::NotifySpoken), 2);
+        QCOMPARE(table.value(Protocol::NotifyOperate), 3);
+        QCOMPARE(table.value(Protocol::NotifyVersion), 0);
+        QCOMPARE(table.value(Protocol::NotifyInvalid), 0);
+        QCOMPARE(table.value(static_cast<Protocol::NotifyId>(0x800)), 0);
+    }
+
+    void QMdmmProtocolencodePayload()
+    {
+        Protocol::ActionNotify notify;
+        notify.playerName = QStringLiteral("player1");
+        notify.action = Data::Slash;
+        notify.toPlayer = QStringLiteral("player2");
+
+        // The wire format is the same as the hand written encoder used to produce. The absent toPlace is not encoded
+        QJsonObject expected;
+        expected.insert(QStringLiteral("playerName"), QStringLiteral("player1"));
+        expected.insert(QStringLiteral("action"), static_cast<int>(Data::Slash));
+        expected.insert(QStringLiteral("toPlayer"), QStringLiteral("player2"));
+
+        Packet packet = Protocol::notifyPacket<Protocol::NotifyAction>(notify);
+        QCOMPARE(packet.type(), Protocol::TypeNotify);
+        QCOMPARE(packet.notifyId(), Protocol::NotifyAction);
+        QCOMPARE(packet.value(), QJsonValue(expected));
+
+        QCOMPARE(Protocol::notifyPacket<Protocol::NotifyGameStart>({}).value(), QJsonValue());
+        QCOMPARE(Protocol::replyPacket<Protocol::RequestUpgrade>({Data::UpgradeKnife, Data::UpgradeMaxHp}).value(),
+                 QJsonValue(QJsonArray {static_cast<int>(Data::UpgradeKnife), static_cast<int>(Data::UpgradeMaxHp)}));
+    }
+
+    void QMdmmProtocoldecodePayload()
+    {
+        Protocol::SignInNotify signIn;
+        signIn.playerName = QStringLiteral("player1");
+        signIn.screenName = QStringLiteral("Player 1");
+        signIn.agentState = Data::StateMaskOnline;
+        signIn.codec = Protocol::CodecCbor;
+
+        QJsonObject ob = Protocol::encodePayload(signIn).toObject();
+        QVERIFY(!ob.contains(QStringLiteral("framing")));
+        // unknown keys are ignored
+        ob.insert(QStringLiteral("unknown"), true);
+
+        Protocol::SignInNotify decoded;
+        QVERIFY(Protocol::decodePayload(ob, &decoded));
+        QCOMPARE(decoded.playerName, signIn.playerName);
+        QCOMPARE(decoded.screenName, signIn.screenName);
+        QCOMPARE(decoded.agentState, signIn.agentState);
+        QVERIFY(decoded.codec.has_value());
+        QCOMPARE(*decoded.codec, static_cast<int>(Protocol::CodecCbor));
+        QVERIFY(!decoded.framing.has_value());
+
+        QHash<QString, Data::StoneScissorsCloth> replies {{QStringLiteral("player1"), Data::Stone}, {QStringLiteral("player2"), Data::Cloth}};
+        Protocol::NotifyPayloadType<Protocol::NotifyStoneScissorsCloth> decodedReplies;
+        QVERIFY(Protocol::decodePayload(Protocol::encodePayload(replies), &decodedReplies));
+        QCOMPARE(decodedReplies, replies);
+    }
+
+    // nested payloads are encoded as objects inside an array
+    void QMdmmProtocoldecodePayloadNested()
+    {
+        Protocol::RoomSnapshotNotify snapshot;
+        snapshot.state = 4;
+        for (int i = 0; i < 2; ++i) {
+            Protocol::PlayerSnapshot player;
+            player.playerName = QStringLiteral("player%1").arg(i + 1);
+            player.screenName = QStringLiteral("Player %1").arg(i + 1);
+            player.agentState = Data::StateOnline;
+            player.hasHorse = (i == 1);
+            player.hp = 10 - i;
+            player.place = i + 1;
+            player.initialPlace = i + 1;
+            player.knifeDamage = 1;
+            player.horseDamage = 2;
+            player.maxHp = 10;
+            snapshot.players << player;
+        }
+
+        QJsonValue value = Protocol::encodePayload(snapshot);
+        QVERIFY(value.toObject().value(QStringLiteral("players")).isArray());
+        QCOMPARE(value.toObject().value(QStringLiteral("players")).toArray().size(), 2);
+
+        Protocol::RoomSnapshotNotify decoded;
+        QVERIFY(Protocol::decodePayload(value, &decoded));
+        QCOMPARE(decoded.state, 4);
+        QCOMPARE(decoded.players.length(), 2);
+        QCOMPARE(decoded.players.at(1).playerName, QStringLiteral("player2"));
+        QCOMPARE(decoded.players.at(1).agentState, Data::AgentState(Data::StateOnline));
+        QVERIFY(decoded.players.at(1).hasHorse);
+        QCOMPARE(decoded.players.at(1).hp, 9);
+
+        // an entry missing a field fails the whole payload
+        QJsonObject broken = value.toObject();
+        QJsonArray players = broken.value(QStringLiteral("players")).toArray();
+        QJsonObject player = players.at(0).toObject();
+        player.remove(QStringLiteral("hp"));
+        players.replace(0, player);
+        broken.insert(QStringLiteral("players"), players);
+        QVERIFY(!Protocol::decodePayload(QJsonValue(broken), &decoded));
+    }
+
+    void QMdmmProtocoldecodePayloadhasError_data()
+    {
+        QTest::addColumn<QJsonValue>("value");
+
+        QJsonObject valid;
+        valid.insert(QStringLiteral("action"), static_cast<int>(Data::LetMove));
+        valid.insert(QStringLiteral("toPlayer"), QStringLiteral("player2"));
+        valid.insert(QStringLiteral("toPlace"), 1);
+
+        QJsonObject ob = valid;
+        ob.remove(QStringLiteral("action"));
+        QTest::newRow("missingRequired") << QJsonValue(ob);
+
+        ob = valid;
+        ob.insert(QStringLiteral("action"), QStringLiteral("LetMove"));
+        QTest::newRow("typeMismatch") << QJsonValue(ob);
+
+        ob = valid;
+        ob.insert(QStringLiteral("action"), static_cast<int>(Data::LetMove) + 1);
+        QTest::newRow("enumOutOfRange") << QJsonValue(ob);
+
+        ob = valid;
+        ob.remove(QStringLiteral("toPlace"));
+        QTest::newRow("missingTarget") << QJsonValue(ob);
+
+        ob = valid;
+        ob.insert(QStringLiteral("toPlayer"), 2);
+        QTest::newRow("optionalTypeMismatch") << QJsonValue(ob);
+
+        QTest::newRow("notObject") << QJsonValue(QJsonArray {valid});
+    }
+    void QMdmmProtocoldecodePayloadhasError()
+    {
+        QFETCH(QJsonValue, value);
+
+        Protocol::ActionReply reply;
+        QVERIFY(!Protocol::decodePayload(value, &reply));
+    }
+
     void QMdmmPacketQ_DECLARE_METATYPE()
     {
         // coverage for Q_DECLARE_METATYPE
@@ -0,0 +1,470 @@
+#include "test.h"
+
+#include <QMdmmCore/QMdmmLogicConfiguration>
+#include <QMdmmCore/QMdmmProtocol>
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QTest>
+
+#include <functional>
+
+// NOLINTBEGIN
+
+using namespace QMdmmCore;
+
+// Builds a packet from its typed payload, the way the server and the client do
+using PacketBuilder = std::function<Packet()>;
+Q_DECLARE_METATYPE(PacketBuilder)
+
+namespace {
+// Room sizes the payloads are generated for. Payloads which don't depend on the room size are generated only once
+const QList<int> roomSizes {2, 4, 8, 16, 32, 64};
+
+QString playerName(int i)
+{
+    return QStringLiteral("Fsu%1").arg(413 + i);
+}
+
+QStringList playerNames(int players)
+{
+    QStringList names;
+    names.reserve(players);
+    for (int i = 0; i < players; ++i)
+        names << playerName(i);
+    return names;
+}
+
+struct BenchmarkPacket
+{
+    QByteArray name;
+    PacketBuilder builder;
+};
+
+// Payloads of every RequestId / NotifyId which depend on the room size
+QList<BenchmarkPacket> roomPackets(int players)
+{
+    QList<BenchmarkPacket> packets;
+
+    Protocol::StoneScissorsClothRequest ssc;
+    ssc.playerNames = playerNames(players);
+    ssc.strivedOrder = 1;
+    packets << BenchmarkPacket {"RequestStoneScissorsCloth", [ssc]() { return Protocol::requestPacket<Protocol::RequestStoneScissorsCloth>(ssc); }};
+
+    Protocol::ActionOrderRequest actionOrder;
+    for (int i = 1; i <= players; ++i)
+        actionOrder.remainedOrders << i;
+    actionOrder.maximumOrder = players;
+    actionOrder.selectionNum = 1;
+    packets << BenchmarkPacket {"RequestActionOrder", [actionOrder]() { return Protocol::requestPacket<Protocol::RequestActionOrder>(actionOrder); }};
+    packets << BenchmarkPacket {"ReplyActionOrder", [actionOrder]() { return Protocol::replyPacket<Protocol::RequestActionOrder>(actionOrder.remainedOrders); }};
+
+    QHash<QString, Data::StoneScissorsCloth> sscResult;
+    for (int i = 0; i < players; ++i)
+        sscResult.insert(playerName(i), static_cast<Data::StoneScissorsCloth>(i % 3));
+    packets << BenchmarkPacket {"NotifyStoneScissorsCloth", [sscResult]() { return Protocol::notifyPacket<Protocol::NotifyStoneScissorsCloth>(sscResult); }};
+
+    QStringList order = playerNames(players);
+    packets << BenchmarkPacket {"NotifyActionOrder", [order]() { return Protocol::notifyPacket<Protocol::NotifyActionOrder>(order); }};
+
+    QHash<QString, QList<Data::UpgradeItem>> upgrade;
+    for (int i = 0; i < players; ++i)
+        upgrade.insert(playerName(i), QList<Data::UpgradeItem> {Data::UpgradeKnife, static_cast<Data::UpgradeItem>(i % 3)});
+    packets << BenchmarkPacket {"NotifyUpgrade", [upgrade]() { return Protocol::notifyPacket<Protocol::NotifyUpgrade>(upgrade); }};
+
+    LogicConfiguration conf = LogicConfiguration::defaults();
+    conf.setPlayerNumPerRoom(players);
+    packets << BenchmarkPacket {"NotifyLogicConfiguration", [conf]() { return Packet(Protocol::NotifyLogicConfiguration, conf); }};
+
+    Protocol::RoomSnapshotNotify snapshot;
+    snapshot.state = 4;
+    for (int i = 0; i < players; ++i) {
+        Protocol::PlayerSnapshot player;
+        player.playerName = playerName(i);
+        player.screenName = playerName(i);
+        player.agentState = Data::StateOnline;
+        player.hasKnife = (i % 2 == 0);
+        player.hp = 10;
+        player.place = i + 1;
+        player.initialPlace = i + 1;
+        player.knifeDamage = 1;
+        player.horseDamage = 2;
+        player.maxHp = 10;
+        snapshot.players << player;
+    }
+    packets << BenchmarkPacket {"NotifyRoomSnapshot", [snapshot]() { return Protocol::notifyPacket<Protocol::NotifyRoomSnapshot>(snapshot); }};
+
+    return packets;
+}
+
+// Payloads of every other RequestId / NotifyId
+QList<BenchmarkPacket> fixedPackets()
+{
+    QList<BenchmarkPacket> packets;
+
+    packets << BenchmarkPacket {"ReplyStoneScissorsCloth", []() { return Protocol::replyPacket<Protocol::RequestStoneScissorsCloth>(Data::Cloth); }};
+    packets << BenchmarkPacket {"RequestAction", []() { return Protocol::requestPacket<Protocol::RequestAction>(1); }};
+
+    Protocol::ActionReply action;
+    action.action = Data::LetMove;
+    action.toPlayer = playerName(1);
+    action.toPlace = 2;
+    packets << BenchmarkPacket {"ReplyAction", [action]() { return Protocol::replyPacket<Protocol::RequestAction>(action); }};
+    packets << BenchmarkPacket {"RequestUpgrade", []() { return Protocol::requestPacket<Protocol::RequestUpgrade>(2); }};
+    packets << BenchmarkPacket {"ReplyUpgrade", []() {
+                                    return Protocol::replyPacket<Protocol::RequestUpgrade>(QList<Data::UpgradeItem> {Data::UpgradeKnife, Data::UpgradeMaxHp});
+                                }};
+
+    packets << BenchmarkPacket {"NotifyPongServer", []() { return Protocol::notifyPacket<Protocol::NotifyPongServer>(1700000000000LL); }};
+
+    Protocol::VersionNotify version;
+    version.versionNumber = QStringLiteral("1.0.0");
+    version.protocolVersion = Protocol::version();
+    version.codecs = QList<int> {Protocol::CodecCbor, Protocol::CodecJson};
+    version.framings = QList<int> {1, 0};
+    version.batching = true;
+    version.compressionThreshold = 1024;
+    packets << BenchmarkPacket {"NotifyVersion", [version]() { return Protocol::notifyPacket<Protocol::NotifyVersion>(version); }};
+
+    Protocol::AgentStateChangedNotify agentStateChanged;
+    agentStateChanged.playerName = playerName(0);
+    agentStateChanged.agentState = Data::StateOnlineTrust;
+    packets << BenchmarkPacket {"NotifyAgentStateChanged", [agentStateChanged]() { return Protocol::notifyPacket<Protocol::NotifyAgentStateChanged>(agentStateChanged); }};
+
+    Protocol::PlayerAddedNotify playerAdded;
+    playerAdded.playerName = playerName(0);
+    playerAdded.screenName = QStringLiteral("Fsu0413");
+    playerAdded.agentState = Data::StateOnline;
+    packets << BenchmarkPacket {"NotifyPlayerAdded", [playerAdded]() { return Protocol::notifyPacket<Protocol::NotifyPlayerAdded>(playerAdded); }};
+
+    Protocol::PlayerRemovedNotify playerRemoved;
+    playerRemoved.playerName = playerName(0);
+    packets << BenchmarkPacket {"NotifyPlayerRemoved", [playerRemoved]() { return Protocol::notifyPacket<Protocol::NotifyPlayerRemoved>(playerRemoved); }};
+
+    packets << BenchmarkPacket {"NotifyGameStart", []() { return Protocol::notifyPacket<Protocol::NotifyGameStart>({}); }};
+    packets << BenchmarkPacket {"NotifyRoundStart", []() { return Protocol::notifyPacket<Protocol::NotifyRoundStart>({}); }};
+
+    Protocol::ActionNotify actionNotify;
+    actionNotify.playerName = playerName(0);
+    actionNotify.action = Data::Slash;
+    actionNotify.toPlayer = playerName(1);
+    packets << BenchmarkPacket {"NotifyAction", [actionNotify]() { return Protocol::notifyPacket<Protocol::NotifyAction>(actionNotify); }};
+
+    packets << BenchmarkPacket {"NotifyRoundOver", []() { return Protocol::notifyPacket<Protocol::NotifyRoundOver>({}); }};
+    packets << BenchmarkPacket {"NotifyGameOver", []() { return Protocol::notifyPacket<Protocol::NotifyGameOver>(QStringList {playerName(0)}); }};
+
+    Protocol::SpokenNotify spoken;
+    spoken.playerName = playerName(0);
+    spoken.content = QStringLiteral("SGVsbG8gd29ybGQ=");
+    packets << BenchmarkPacket {"NotifySpoken", [spoken]() { return Protocol::notifyPacket<Protocol::NotifySpoken>(spoken); }};
+
+    packets << BenchmarkPacket {"NotifyPingServer", []() { return Protocol::notifyPacket<Protocol::NotifyPingServer>(1700000000000LL); }};
+
+    Protocol::SignInNotify signIn;
+    signIn.playerName = playerName(0);
+    signIn.screenName = QStringLiteral("Fsu0413");
+    signIn.agentState = Data::StateOnline;
+    signIn.codec = Protocol::CodecCbor;
+    signIn.framing = 1;
+    signIn.batching = true;
+    signIn.compression = true;
+    packets << BenchmarkPacket {"NotifySignIn", [signIn]() { return Protocol::notifyPacket<Protocol::NotifySignIn>(signIn); }};
+
+    QJsonObject observe;
+    observe.insert(QStringLiteral("observerName"), QStringLiteral("Fsu0412"));
+    observe.insert(QStringLiteral("playerName"), playerName(0));
+    packets << BenchmarkPacket {"NotifyObserve", [observe]() { return Protocol::notifyPacket<Protocol::NotifyObserve>(observe); }};
+
+    packets << BenchmarkPacket {"NotifySpeak", []() { return Protocol::notifyPacket<Protocol::NotifySpeak>(QStringLiteral("SGVsbG8gd29ybGQ=")); }};
+
+    // NotifyOperated and NotifyOperate have no payload defined yet
+    packets << BenchmarkPacket {"NotifyOperated", []() { return Protocol::notifyPacket<Protocol::NotifyOperated>(QJsonObject {}); }};
+    packets << BenchmarkPacket {"NotifyOperate", []() { return Protocol::notifyPacket<Protocol::NotifyOperate>(QJsonObject {}); }};
+
+    return packets;
+}
+
+void addPacketRows(bool withCodec)
+{
+    auto addRows = [withCodec](const QByteArray &tag, const PacketBuilder &builder) {
+        if (withCodec) {
+            QTest::addRow("%s-json", tag.constData()) << builder << static_cast<int>(Protocol::CodecJson);
+            QTest::addRow("%s-cbor", tag.constData()) << builder << static_cast<int>(Protocol::CodecCbor);
+        } else {
+            QTest::addRow("%s", tag.constData()) << builder << static_cast<int>(Protocol::CodecJson);
+        }
+    };
+
+    foreach (int players, roomSizes) {
+        for (const BenchmarkPacket &packet : roomPackets(players))
+            addRows(packet.name + '-' + QByteArray::number(players), packet.builder);
+    }
+    for (const BenchmarkPacket &packet : fixedPackets())
+        addRows(packet.name, packet.builder);
+}
+
+// A packet with its own PacketData, so nothing serialized before is cached in it
+Packet unsharedCopy(const Packet &packet)
+{
+    if (packet.type() == Protocol::TypeNotify)
+        return Packet(packet.notifyId(), packet.value());
+    return Packet(packet.type(), packet.requestId(), packet.value());
+}
+} // namespace
+
+// Numbers to judge protocol changes against.
+// Run this executable alone (e.g. with -iterations or -tickcounter) for stable results, ctest only checks that it works.
+class tst_QMdmmProtocolBenchmark : public QObject
+{
+    Q_OBJECT
+
+public:
+    Q_INVOKABLE tst_QMdmmProtocolBenchmark() = default;
+
+private slots:
+    void construct_data()
+    {
+        QTest::addColumn<PacketBuilder>("builder");
+        QTest::addColumn<int>("codec");
+
+        addPacketRows(false);
+    }
+
+    // typed payload to Packet, including the payload encoding
+    void construct()
+    {
+        QFETCH(PacketBuilder, builder);
+
+        Packet packet;
+        QBENCHMARK {
+            packet = builder();
+        }
+
+        QVERIFY(!packet.hasError());
+    }
+
+    void serialize_data()
+    {
+        QTest::addColumn<PacketBuilder>("builder");
+        QTest::addColumn<int>("codec");
+
+        addPacketRows(true);
+    }
+
+    void serialize()
+    {
+        QFETCH(PacketBuilder, builder);
+        QFETCH(int, codec);
+
+        Packet packet = builder();
+        QByteArray arr;
+        QBENCHMARK {
+            // Packet caches its serialized bytes, which must not be measured
+            arr = unsharedCopy(packet).serialize(static_cast<Protocol::Codec>(codec));
+        }
+
+        qInfo("%s: %lld bytes", QTest::currentDataTag(), static_cast<long long>(arr.size()));
+        QVERIFY(!arr.isEmpty());
+    }
+
+    // serialize and deserialize again, which is what a packet costs on the wire, for both codecs
+    void codecRoundTrip_data()
+    {
+        QTest::addColumn<PacketBuilder>("builder");
+        QTest::addColumn<int>("codec");
+
+        addPacketRows(true);
+    }
+
+    void codecRoundTrip()
+    {
+        QFETCH(PacketBuilder, builder);
+        QFETCH(int, codec);
+
+        Packet packet = builder();
+        QByteArray arr;
+        QBENCHMARK {
+            arr = unsharedCopy(packet).serialize(static_cast<Protocol::Codec>(codec));
+            Packet p = Packet::deserialize(arr);
+            Q_UNUSED(p);
+        }
+
+        QVERIFY(!Packet::deserialize(arr).hasError());
+    }
+
+    // The header fields of a packet are read several times per packet on the dispatch path.
+    // Row "QJsonObject" reads them by key as the packet used to store them, for comparison.
+    void dispatch_data()
+    {
+        QTest::addColumn<bool>("keyLookup");
+
+        QTest::newRow("QJsonObject") << true;
+        QTest::newRow("Packet") << false;
+    }
+
+    void dispatch()
+    {
+        QFETCH(bool, keyLookup);
+
+        Packet packet(Protocol::TypeReply, Protocol::RequestAction, QJsonObject {qMakePair(QStringLiteral("action"), 0)});
+        QJsonObject ob;
+        ob.insert(QStringLiteral("type"), static_cast<int>(packet.type()));
+        ob.insert(QStringLiteral("requestId"), static_cast<int>(packet.requestId()));
+        ob.insert(QStringLiteral("notifyId"), static_cast<int>(packet.notifyId()));
+        ob.insert(QStringLiteral("value"), packet.value());
+
+        int sum = 0;
+        if (keyLookup) {
+            QBENCHMARK {
+                // mirrors ServerConnection::packetReceived: type, requestId (twice) and value
+                int type = ob.value(QStringLiteral("type")).toInt();
+                if (type == Protocol::TypeNotify)
+                    sum += ob.value(QStringLiteral("notifyId")).toInt();
+                else if (type == Protocol::TypeReply)
+                    sum += ob.value(QStringLiteral("requestId")).toInt() + ob.value(QStringLiteral("requestId")).toInt();
+                sum += ob.value(QStringLiteral("value")).isObject() ? 1 : 0;
+            }
+        } else {
+            QBENCHMARK {
+                Protocol::PacketType type = packet.type();
+                if (type == Protocol::TypeNotify)
+                    sum += packet.notifyId();
+                else if (type == Protocol::TypeReply)
+                    sum += packet.requestId() + packet.requestId();
+                sum += packet.value().isObject() ? 1 : 0;
+            }
+        }
+
+        QVERIFY(sum > 0);
+    }
+
+    void fromJson_data()
+    {
+        QTest::addColumn<PacketBuilder>("builder");
+        QTest::addColumn<int>("codec");
+
+        addPacketRows(false);
+    }
+
+    void fromJson()
+    {
+        QFETCH(PacketBuilder, builder);
+
+        QByteArray arr = builder().serialize(Protocol::CodecJson);
+        Packet packet;
+        QBENCHMARK {
+            packet = Packet::fromJson(arr);
+        }
+
+        QVERIFY(!packet.hasError());
+    }
+
+    void fromJsonError_data()
+    {
+        QTest::addColumn<QByteArray>("serialized");
+
+        const QByteArray ssc = roomPackets(64).constFirst().builder().serialize(Protocol::CodecJson);
+
+        QTest::newRow("empty") << QByteArray();
+        QTest::newRow("truncated") << ssc.left(ssc.size() / 2);
+        QTest::newRow("notObject") << QByteArray("[1,2,3]");
+        QTest::newRow("typeNonExistent") << QByteArray(R"({"requestId":0,"notifyId":4097,"value":null})");
+        QTest::newRow("typeNotNumber") << QByteArray(R"({"type":"3","requestId":0,"notifyId":4097,"value":null})");
+        QTest::newRow("valueNonExistent") << QByteArray(R"({"type":3,"requestId":0,"notifyId":4097})");
+        QTest::newRow("trailingGarbage") << QByteArray(ssc).append("}}");
+    }
+
+    void fromJsonError()
+    {
+        QFETCH(QByteArray, serialized);
+
+        QString errorString;
+        Packet packet;
+        QBENCHMARK {
+            packet = Packet::fromJson(serialized, &errorString);
+        }
+
+        QVERIFY(packet.hasError());
+    }
+
+    // Decoding a typical RequestAction reply.
+    // Row "lookup" decodes it the way ServerConnection::decodeActionReply used to, with a contains() and a value() for each field, for comparison.
+    void decodePayload_data()
+    {
+        QTest::addColumn<bool>("keyLookup");
+
+        QTest::newRow("lookup") << true;
+        QTest::newRow("description") << false;
+    }
+
+    void decodePayload()
+    {
+        QFETCH(bool, keyLookup);
+
+        QJsonObject ob;
+        ob.insert(QStringLiteral("action"), static_cast<int>(Data::LetMove));
+        ob.insert(QStringLiteral("toPlayer"), QStringLiteral("player2"));
+        ob.insert(QStringLiteral("toPlace"), 1);
+        QJsonValue value = ob;
+
+        int sum = 0;
+        if (keyLookup) {
+            QBENCHMARK {
+                QJsonObject arr = value.toObject();
+                if (arr.contains(QStringLiteral("action")) && arr.value(QStringLiteral("action")).isDouble()) {
+                    int action = arr.value(QStringLiteral("action")).toInt();
+                    if (arr.contains(QStringLiteral("toPlayer")) && arr.value(QStringLiteral("toPlayer")).isString()
+                        && arr.contains(QStringLiteral("toPlace")) && arr.value(QStringLiteral("toPlace")).isDouble())
+                        sum += action + static_cast<int>(arr.value(QStringLiteral("toPlayer")).toString().size()) + arr.value(QStringLiteral("toPlace")).toInt();
+                }
+            }
+        } else {
+            QBENCHMARK {
+                Protocol::ActionReply reply;
+                if (Protocol::decodePayload(value, &reply))
+                    sum += reply.action + static_cast<int>(reply.toPlayer->size()) + *reply.toPlace;
+            }
+        }
+
+        QVERIFY(sum > 0);
+    }
+
+    void decodePayloadError_data()
+    {
+        QTest::addColumn<QJsonValue>("value");
+
+        foreach (int players, roomSizes) {
+            // the last entry has a wrong type, so the whole array is walked before the error is found
+            QJsonArray names = QJsonArray::fromStringList(playerNames(players));
+            names.append(1);
+            QJsonObject ssc;
+            ssc.insert(QStringLiteral("playerNames"), names);
+            ssc.insert(QStringLiteral("strivedOrder"), 1);
+            QTest::addRow("wrongType-%d", players) << QJsonValue(ssc);
+
+            QJsonObject missing;
+            missing.insert(QStringLiteral("playerNames"), QJsonArray::fromStringList(playerNames(players)));
+            QTest::addRow("missingField-%d", players) << QJsonValue(missing);
+        }
+
+        QTest::newRow("notObject") << QJsonValue(1);
+    }
+
+    void decodePayloadError()
+    {
+        QFETCH(QJsonValue, value);
+
+        bool ok = true;
+        QBENCHMARK {
+            Protocol::RequestPayloadType<Protocol::RequestStoneScissorsCloth> payload;
+            ok = Protocol::decodePayload(value, &payload);
+        }
+
+        QVERIFY(!ok);
+    }
+};
+
+namespace {
+RegisterTestObject<tst_QMdmmProtocolBenchmark> _;
+}
+#include "tst_qmdmmprotocolbenchmark.moc"
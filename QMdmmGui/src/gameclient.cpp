@@ -12,7 +12,7 @@ using namespace QMdmmCore;
 using namespace QMdmmNetworking;
 
 namespace {
-constexpr char LOCAL_HOST[] = "qmdmm://localhost:6366";
+constexpr char LOCAL_HOST[] = "inproc://QMdmm";
 } // namespace
 
 QMdmmGameClient::QMdmmGameClient(QObject *parent)
@@ -254,7 +254,13 @@ void QMdmmGameClient::startLocalGame(const QString &playerName)
     // In-process server so a single user can actually play a full match.
     LogicConfiguration conf = LogicConfiguration::defaults();
     conf.setPlayerNumPerRoom(m_playerCount);
-    m_server = new Server(ServerConfiguration::defaults(), conf, this);
+    // Nothing leaves the process: packets are handed to the server as they are, and no port is taken
+    ServerConfiguration serverConf = ServerConfiguration::defaults();
+    serverConf.setTcpEnabled(false);
+    serverConf.setLocalEnabled(false);
+    serverConf.setWebsocketEnabled(false);
+    serverConf.setInProcessEnabled(true);
+    m_server = new Server(serverConf, conf, this);
     if (!m_server->listen()) {
         setStatusMessage(tr("Failed to start local server"));
         delete m_server;
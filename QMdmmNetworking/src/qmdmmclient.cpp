@@ -6,7 +6,6 @@
 #include <QMdmmRoom>
 
 #include <QDateTime>
-#include <QJsonArray>
 
 #include <random>
 
@@ -31,6 +30,11 @@ namespace v0 {
  * @brief The screen name of the client, default "QMdmm-Fans"
  */
 
+/**
+ * @property ClientConfiguration::tlsCaCertificate
+ * @brief The path of PEM encoded CA certificates trusted in addition to the system ones when connecting with TLS, default empty
+ */
+
 /**
  * @fn ClientConfiguration::screenName() const
  * @brief getter of @c ClientConfiguration::screenName
@@ -43,6 +47,18 @@ namespace v0 {
  * @param screenName @c ClientConfiguration::screenName
  */
 
+/**
+ * @fn ClientConfiguration::tlsCaCertificate() const
+ * @brief getter of @c ClientConfiguration::tlsCaCertificate
+ * @return @c ClientConfiguration::tlsCaCertificate
+ */
+
+/**
+ * @fn ClientConfiguration::setTlsCaCertificate(const QString &tlsCaCertificate)
+ * @brief setter of @c ClientConfiguration::tlsCaCertificate
+ * @param tlsCaCertificate @c ClientConfiguration::tlsCaCertificate
+ */
+
 /**
  * @brief Get default values of configuration
  * @return default configuration
@@ -52,6 +68,7 @@ const ClientConfiguration &ClientConfiguration::defaults()
     // clang-format off
     static const ClientConfiguration defaultInstance {
         std::make_pair(QStringLiteral("screenName"), QStringLiteral("QMdmm-Fans")),
+        std::make_pair(QStringLiteral("tlsCaCertificate"), QString()),
     };
     // clang-format on
 
@@ -84,6 +101,7 @@ const ClientConfiguration &ClientConfiguration::defaults()
     }
 
 IMPLEMENTATION_CONFIGURATION2(QString, screenName, ScreenName, CONVERTTOTYPEQSTRING, )
+IMPLEMENTATION_CONFIGURATION2(QString, tlsCaCertificate, TlsCaCertificate, CONVERTTOTYPEQSTRING, )
 
 #undef IMPLEMENTATION_CONFIGURATION2
 #undef IMPLEMENTATION_CONFIGURATION
@@ -146,7 +164,9 @@ bool Client::connectToHost(const QString &host, QMdmmCore::Data::AgentState init
     // Remember the host so the client can reconnect by itself after a drop. An
     // explicit connectToHost always starts a fresh session: clear any in-flight
     // reconnect state so a manual reconnect and the automatic retry never fight.
+    // The TLS session of a previous host is not resumed either.
     d->host = host;
+    d->resetSslConfiguration();
     d->initialState = initialState;
     d->reconnectAttempts = 0;
     d->reconnectInProgress = false;
@@ -200,7 +220,7 @@ void Client::notifySpeak(const QString &content)
     // Although JSON is native UTF-8 we decided to use Base64 anyway.
     // This can make our request / response all in one line.
     if (d->socket != nullptr)
-        emit d->socket->sendPacket(QMdmmCore::Packet(QMdmmCore::Protocol::NotifySpeak, QString::fromLatin1(content.toUtf8().toBase64())));
+        emit d->socket->sendPacket(QMdmmCore::Protocol::notifyPacket<QMdmmCore::Protocol::NotifySpeak>(QString::fromLatin1(content.toUtf8().toBase64())));
 }
 
 /**
@@ -238,7 +258,7 @@ void Client::replyStoneScissorsCloth(QMdmmCore::Data::StoneScissorsCloth stoneSc
 {
     if (d->socket != nullptr && d->currentRequest == QMdmmCore::Protocol::RequestStoneScissorsCloth) {
         d->currentRequest = QMdmmCore::Protocol::RequestInvalid;
-        emit d->socket->sendPacket(QMdmmCore::Packet(QMdmmCore::Protocol::TypeReply, QMdmmCore::Protocol::RequestStoneScissorsCloth, static_cast<int>(stoneScissorsCloth)));
+        emit d->socket->sendPacket(QMdmmCore::Protocol::replyPacket<QMdmmCore::Protocol::RequestStoneScissorsCloth>(stoneScissorsCloth));
     }
 }
 
@@ -250,11 +270,7 @@ void Client::replyActionOrder(const QList<int> &actionOrder)
 {
     if (d->socket != nullptr && d->currentRequest == QMdmmCore::Protocol::RequestActionOrder) {
         d->currentRequest = QMdmmCore::Protocol::RequestInvalid;
-        QJsonArray arr;
-        foreach (int a, actionOrder)
-            arr.append(a);
-
-        emit d->socket->sendPacket(QMdmmCore::Packet(QMdmmCore::Protocol::TypeReply, QMdmmCore::Protocol::RequestActionOrder, arr));
+        emit d->socket->sendPacket(QMdmmCore::Protocol::replyPacket<QMdmmCore::Protocol::RequestActionOrder>(actionOrder));
     }
 }
 
@@ -268,12 +284,12 @@ void Client::replyAction(QMdmmCore::Data::Action action, const QString &toPlayer
 {
     if (d->socket != nullptr && d->currentRequest == QMdmmCore::Protocol::RequestAction) {
         d->currentRequest = QMdmmCore::Protocol::RequestInvalid;
-        QJsonObject ob;
-        ob.insert(QStringLiteral("action"), static_cast<int>(action));
-        ob.insert(QStringLiteral("toPlayer"), toPlayer);
-        ob.insert(QStringLiteral("toPlace"), toPlace);
+        QMdmmCore::Protocol::ActionReply reply;
+        reply.action = action;
+        reply.toPlayer = toPlayer;
+        reply.toPlace = toPlace;
 
-        emit d->socket->sendPacket(QMdmmCore::Packet(QMdmmCore::Protocol::TypeReply, QMdmmCore::Protocol::RequestAction, ob));
+        emit d->socket->sendPacket(QMdmmCore::Protocol::replyPacket<QMdmmCore::Protocol::RequestAction>(reply));
     }
 }
 
@@ -285,11 +301,7 @@ void Client::replyUpgrade(const QList<QMdmmCore::Data::UpgradeItem> &upgrades)
 {
     if (d->socket != nullptr && d->currentRequest == QMdmmCore::Protocol::RequestUpgrade) {
         d->currentRequest = QMdmmCore::Protocol::RequestInvalid;
-        QJsonArray arr;
-        foreach (QMdmmCore::Data::UpgradeItem it, upgrades)
-            arr.append(static_cast<int>(it));
-
-        emit d->socket->sendPacket(QMdmmCore::Packet(QMdmmCore::Protocol::TypeReply, QMdmmCore::Protocol::RequestUpgrade, arr));
+        emit d->socket->sendPacket(QMdmmCore::Protocol::replyPacket<QMdmmCore::Protocol::RequestUpgrade>(upgrades));
     }
 }
 
@@ -411,6 +423,14 @@ void Client::replyUpgrade(const QList<QMdmmCore::Data::UpgradeItem> &upgrades)
  * @brief emitted when a player operates
  */
 
+/**
+ * @fn Client::notifyRoomSnapshot(QMdmmCore::Logic::State state, QPrivateSignal)
+ * @brief emitted when the room is rebuilt from a room snapshot after a reconnect
+ * @param state the state of the logic when the snapshot was taken
+ *
+ * The players which were not known before are reported by @c notifyPlayerAdded first.
+ */
+
 #ifndef DOXYGEN
 } // namespace v0
 #endif
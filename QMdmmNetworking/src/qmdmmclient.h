@@ -5,6 +5,7 @@
 
 #include "qmdmmnetworkingglobal.h"
 
+#include <QMdmmLogic>
 #include <QMdmmRoom>
 
 #include <QObject>
@@ -30,6 +31,7 @@ struct QMDMMNETWORKING_EXPORT ClientConfiguration final : public QVariantMap
 {
     Q_GADGET
     Q_PROPERTY(QString screenName READ screenName WRITE setScreenName DESIGNABLE false FINAL)
+    Q_PROPERTY(QString tlsCaCertificate READ tlsCaCertificate WRITE setTlsCaCertificate DESIGNABLE false FINAL)
 
 public:
     static QMDMMNETWORKING_EXPORT const ClientConfiguration &defaults();
@@ -44,6 +46,8 @@ public:
 
     [[nodiscard]] QString screenName() const;
     void setScreenName(const QString &screenName);
+    [[nodiscard]] QString tlsCaCertificate() const;
+    void setTlsCaCertificate(const QString &tlsCaCertificate);
 };
 
 class QMDMMNETWORKING_EXPORT Client final : public QObject
@@ -106,6 +110,7 @@ signals:
     void notifyGameOver(const QStringList &winners, QPrivateSignal);
     void notifySpoken(const QString &playerName, const QString &content, QPrivateSignal);
     void notifyOperated(QPrivateSignal);
+    void notifyRoomSnapshot(QMdmmCore::Logic::State state, QPrivateSignal);
 
 #ifndef DOXYGEN
 private:
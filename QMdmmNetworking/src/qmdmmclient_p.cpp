@@ -3,10 +3,10 @@
 #include "qmdmmclient_p.h"
 #include "qmdmmclient.h"
 
+#include <QMdmmLogic>
 #include <QMdmmLogicConfiguration>
 #include <QMdmmPlayer>
 
-#include <QJsonArray>
 #include <QJsonDocument>
 #include <QScopeGuard>
 
@@ -24,14 +24,14 @@ constexpr int ReconnectMaxIntervalMs = 8000;
 constexpr int MaxReconnectAttempts = 5;
 } // namespace
 
-QHash<QMdmmCore::Protocol::RequestId, void (ClientP::*)(const QJsonValue &)> ClientP::requestCallback {
+QMdmmCore::Protocol::DispatchTable<QMdmmCore::Protocol::RequestId, void (ClientP::*)(const QJsonValue &)> ClientP::requestCallback {
     std::make_pair(QMdmmCore::Protocol::RequestStoneScissorsCloth, &ClientP::requestStoneScissorsCloth),
     std::make_pair(QMdmmCore::Protocol::RequestActionOrder, &ClientP::requestActionOrder),
     std::make_pair(QMdmmCore::Protocol::RequestAction, &ClientP::requestAction),
     std::make_pair(QMdmmCore::Protocol::RequestUpgrade, &ClientP::requestUpgrade),
 };
 
-QHash<QMdmmCore::Protocol::NotifyId, void (ClientP::*)(const QJsonValue &)> ClientP::notifyCallback {
+QMdmmCore::Protocol::DispatchTable<QMdmmCore::Protocol::NotifyId, void (ClientP::*)(const QJsonValue &)> ClientP::notifyCallback {
     // from Server
     std::make_pair(QMdmmCore::Protocol::NotifyPongServer, &ClientP::notifyPongServer),
     std::make_pair(QMdmmCore::Protocol::NotifyVersion, &ClientP::notifyVersion),
@@ -51,6 +51,7 @@ QHash<QMdmmCore::Protocol::NotifyId, void (ClientP::*)(const QJsonValue &)> Clie
     std::make_pair(QMdmmCore::Protocol::NotifyGameOver, &ClientP::notifyGameOver),
     std::make_pair(QMdmmCore::Protocol::NotifySpoken, &ClientP::notifySpoken),
     std::make_pair(QMdmmCore::Protocol::NotifyOperated, &ClientP::notifyOperated),
+    std::make_pair(QMdmmCore::Protocol::NotifyRoomSnapshot, &ClientP::notifyRoomSnapshot),
 };
 
 ClientP::ClientP(ClientConfiguration clientConfiguration, Client *q)
@@ -72,6 +73,20 @@ ClientP::ClientP(ClientConfiguration clientConfiguration, Client *q)
 
     reconnectTimer->setSingleShot(true);
     connect(reconnectTimer, &QTimer::timeout, this, &ClientP::reconnectTimeout);
+
+    resetSslConfiguration();
+}
+
+void ClientP::resetSslConfiguration()
+{
+    sslConfiguration = QSslConfiguration::defaultConfiguration();
+    // Qt drops the session ticket unless session persistence is enabled
+    sslConfiguration.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+
+    if (QString caCertificate = clientConfiguration.tlsCaCertificate(); !caCertificate.isEmpty()) {
+        if (!sslConfiguration.addCaCertificates(caCertificate))
+            qWarning("CA certificate %s can't be loaded", qPrintable(caCertificate));
+    }
 }
 
 void ClientP::initSelfAgent()
@@ -100,31 +115,11 @@ void ClientP::requestStoneScissorsCloth(const QJsonValue &value)
 {
     ONERRPRINTJSON(value);
 
-    if (!value.isObject())
+    QMdmmCore::Protocol::RequestPayloadType<QMdmmCore::Protocol::RequestStoneScissorsCloth> request;
+    if (!QMdmmCore::Protocol::decodePayload(value, &request))
         return;
-    QJsonObject ob = value.toObject();
 
-    if (!ob.contains(QStringLiteral("playerNames")))
-        return;
-    QJsonValue vplayerNames = ob.value(QStringLiteral("playerNames"));
-    if (!vplayerNames.isArray())
-        return;
-    QJsonArray vaplayerNames = vplayerNames.toArray();
-    QStringList playerNames;
-    for (const QJsonValueRef &vplayerName : vaplayerNames) {
-        if (!vplayerName.isString())
-            return;
-        playerNames << vplayerName.toString();
-    }
-
-    if (!ob.contains(QStringLiteral("strivedOrder")))
-        return;
-    QJsonValue vstrivedOrder = ob.value(QStringLiteral("strivedOrder"));
-    if (!vstrivedOrder.isDouble())
-        return;
-    int strivedOrder = vstrivedOrder.toInt();
-
-    emit q->requestStoneScissorsCloth(playerNames, strivedOrder, Client::QPrivateSignal());
+    emit q->requestStoneScissorsCloth(request.playerNames, request.strivedOrder, Client::QPrivateSignal());
     onRet_.dismiss();
 }
 
@@ -133,38 +128,11 @@ void ClientP::requestActionOrder(const QJsonValue &value)
 {
     ONERRPRINTJSON(value);
 
-    if (!value.isObject())
-        return;
-    QJsonObject ob = value.toObject();
-
-    if (!ob.contains(QStringLiteral("remainedOrders")))
-        return;
-    QJsonValue vremainedOrders = ob.value(QStringLiteral("remainedOrders"));
-    if (!vremainedOrders.isArray())
-        return;
-    QJsonArray varemainedOrders = vremainedOrders.toArray();
-    QList<int> remainedOrders;
-    for (const QJsonValueRef &vremainedOrder : varemainedOrders) {
-        if (!vremainedOrder.isDouble())
-            return;
-        remainedOrders << vremainedOrder.toInt();
-    }
-
-    if (!ob.contains(QStringLiteral("maximumOrder")))
-        return;
-    QJsonValue vmaximumOrder = ob.value(QStringLiteral("maximumOrder"));
-    if (!vmaximumOrder.isDouble())
+    QMdmmCore::Protocol::RequestPayloadType<QMdmmCore::Protocol::RequestActionOrder> request;
+    if (!QMdmmCore::Protocol::decodePayload(value, &request))
         return;
-    int maximumOrder = vmaximumOrder.toInt();
 
-    if (!ob.contains(QStringLiteral("selectionNum")))
-        return;
-    QJsonValue vselectionNum = ob.value(QStringLiteral("selectionNum"));
-    if (!vselectionNum.isDouble())
-        return;
-    int selectionNum = vselectionNum.toInt();
-
-    emit q->requestActionOrder(remainedOrders, maximumOrder, selectionNum, Client::QPrivateSignal());
+    emit q->requestActionOrder(request.remainedOrders, request.maximumOrder, request.selectionNum, Client::QPrivateSignal());
     onRet_.dismiss();
 }
 
@@ -173,9 +141,9 @@ void ClientP::requestAction(const QJsonValue &value)
 {
     ONERRPRINTJSON(value);
 
-    if (!value.isDouble())
+    QMdmmCore::Protocol::RequestPayloadType<QMdmmCore::Protocol::RequestAction> currentOrder = 0;
+    if (!QMdmmCore::Protocol::decodePayload(value, &currentOrder))
         return;
-    int currentOrder = value.toInt();
 
     emit q->requestAction(currentOrder, Client::QPrivateSignal());
     onRet_.dismiss();
@@ -186,9 +154,9 @@ void ClientP::requestUpgrade(const QJsonValue &value)
 {
     ONERRPRINTJSON(value);
 
-    if (!value.isDouble())
+    QMdmmCore::Protocol::RequestPayloadType<QMdmmCore::Protocol::RequestUpgrade> remainedTimes = 0;
+    if (!QMdmmCore::Protocol::decodePayload(value, &remainedTimes))
         return;
-    int remainedTimes = value.toInt();
 
     emit q->requestUpgrade(remainedTimes, Client::QPrivateSignal());
     onRet_.dismiss();
@@ -199,9 +167,8 @@ void ClientP::notifyPongServer(const QJsonValue &value)
 {
     ONERRPRINTJSON(value);
 
-    bool ok = false;
-    int64_t pongTime = value.toVariant().toLongLong(&ok);
-    if (!ok) {
+    QMdmmCore::Protocol::NotifyPayloadType<QMdmmCore::Protocol::NotifyPongServer> pongTime = 0;
+    if (!QMdmmCore::Protocol::decodePayload(value, &pongTime)) {
         socket->setHasError(true);
         return;
     }
@@ -219,43 +186,66 @@ void ClientP::notifyVersion(const QJsonValue &value)
 {
     ONERRPRINTJSON(value);
 
-    if (!value.isObject())
+    QMdmmCore::Protocol::VersionNotify version;
+    if (!QMdmmCore::Protocol::decodePayload(value, &version))
         return;
-    QJsonObject ob = value.toObject();
 
-    if (!ob.contains(QStringLiteral("versionNumber")))
-        return;
-    QJsonValue vversionNumber = ob.value(QStringLiteral("versionNumber"));
-    if (!vversionNumber.isString())
+    if (version.protocolVersion != QMdmmCore::Protocol::version())
         return;
-    QString versionNumber = vversionNumber.toString();
 
-    if (!ob.contains(QStringLiteral("protocolVersion")))
-        return;
-    QJsonValue vprotocolVersion = ob.value(QStringLiteral("protocolVersion"));
-    if (!vprotocolVersion.isDouble())
-        return;
-    int protocolVersion = vprotocolVersion.toInt();
-
-    if (protocolVersion != QMdmmCore::Protocol::version())
-        return;
-
-    if (QVersionNumber::fromString(versionNumber) != QMdmmCore::Global::version()) {
+    if (QVersionNumber::fromString(version.versionNumber) != QMdmmCore::Global::version()) {
         // how to deal with this?
         // Theoratically it should be compatible with each other.
         // noop for now....
     }
 
+    // Pick the first codec which this client supports from the list, in the order of server's preference.
+    // An old server doesn't list the codecs, in which case JSON is used.
+    QMdmmCore::Protocol::Codec codec = QMdmmCore::Protocol::CodecJson;
+    foreach (int c, version.codecs.value_or(QList<int>())) {
+        if (c == QMdmmCore::Protocol::CodecJson || c == QMdmmCore::Protocol::CodecCbor) {
+            codec = static_cast<QMdmmCore::Protocol::Codec>(c);
+            break;
+        }
+    }
+
+    // Same for the framing. An old server doesn't list the framings, in which case packets are delimited.
+    Socket::Framing framing = Socket::FramingDelimited;
+    foreach (int f, version.framings.value_or(QList<int>())) {
+        if (f == Socket::FramingDelimited || f == Socket::FramingLengthPrefixed) {
+            framing = static_cast<Socket::Framing>(f);
+            break;
+        }
+    }
+
     // sign in process
-    QJsonObject signInOb;
-    signInOb.insert(QStringLiteral("playerName"), q->objectName());
-    signInOb.insert(QStringLiteral("screenName"), clientConfiguration.screenName());
-    signInOb.insert(QStringLiteral("agentState"), static_cast<int>(initialState));
-    // Report how many round events this client received before a drop, so the server can replay
-    // only the events it missed (precise catch-up). On a fresh sign-in this is 0 and the server's
-    // empty round-event log means nothing extra is replayed.
-    signInOb.insert(QStringLiteral("lastRoundEventSeq"), lastRoundEventSeq);
-    emit socket->sendPacket(QMdmmCore::Packet(QMdmmCore::Protocol::NotifySignIn, signInOb));
+    QMdmmCore::Protocol::SignInNotify signIn;
+    signIn.playerName = q->objectName();
+    signIn.screenName = clientConfiguration.screenName();
+    signIn.agentState = initialState;
+    signIn.codec = codec;
+    signIn.framing = framing;
+    // This client always unpacks batch frames
+    signIn.batching = true;
+    // This client always uncompresses compressed frames
+    signIn.compression = true;
+    // Batches sent by the server are split at this size
+    signIn.maximumFrameSize = socket->maximumFrameSize();
+    emit socket->sendPacket(QMdmmCore::Protocol::notifyPacket<QMdmmCore::Protocol::NotifySignIn>(signIn));
+    // Sign in itself is sent in delimited JSON. Server switches to the codec and framing when it receives the sign in
+    socket->setCodec(codec);
+    socket->setFraming(framing);
+    // An old server may not unpack batch frames
+    socket->setBatching(version.batching.value_or(false));
+    // An old server doesn't tell its maximum frame size, in which case the conservative default of Socket is kept
+    if (version.maximumFrameSize.has_value())
+        socket->setPeerMaximumFrameSize(*version.maximumFrameSize);
+    // Compress what the server would compress, which is 0 (never) for an old server
+    socket->setCompressionThreshold(version.compressionThreshold.value_or(0));
+
+    // The server sends its session ticket right after the handshake, before any packet. Keep it for a reconnect
+    if (QSslConfiguration session = socket->sslConfiguration(); !session.isNull() && !session.sessionTicket().isEmpty())
+        sslConfiguration = session;
 
     // The connection is back and we re-signed in. Stop the retry loop and tell
     // the upper layer the client is back online.
@@ -286,30 +276,15 @@ void ClientP::notifyAgentStateChanged(const QJsonValue &value)
 {
     ONERRPRINTJSON(value);
 
-    if (!value.isObject())
+    QMdmmCore::Protocol::AgentStateChangedNotify notify;
+    if (!QMdmmCore::Protocol::decodePayload(value, &notify))
         return;
 
-    QJsonObject ob = value.toObject();
-    if (!ob.contains(QStringLiteral("playerName")))
+    if (!agents.contains(notify.playerName))
         return;
-    if (!ob.contains(QStringLiteral("agentState")))
-        return;
-
-    QJsonValue vplayerName = ob.value(QStringLiteral("playerName"));
-    if (!vplayerName.isString())
-        return;
-    QString playerName = vplayerName.toString();
+    Agent *agent = agents.value(notify.playerName);
 
-    if (!agents.contains(playerName))
-        return;
-    Agent *agent = agents.value(playerName);
-
-    QJsonValue vagentState = ob.value(QStringLiteral("agentState"));
-    if (!vagentState.isDouble())
-        return;
-    QMdmmCore::Data::AgentState agentState = QMdmmCore::Data::AgentState(static_cast<QMdmmCore::Data::AgentState::Int>(vagentState.toInt()));
-
-    agent->setState(agentState);
+    agent->setState(notify.agentState);
     onRet_.dismiss();
 }
 
@@ -318,34 +293,15 @@ void ClientP::notifyPlayerAdded(const QJsonValue &value)
 {
     ONERRPRINTJSON(value);
 
-    if (!value.isObject())
-        return;
-
-    QJsonObject ob = value.toObject();
-    if (!ob.contains(QStringLiteral("playerName")))
-        return;
-    if (!ob.contains(QStringLiteral("screenName")))
-        return;
-    if (!ob.contains(QStringLiteral("agentState")))
-        return;
-
-    QJsonValue vplayerName = ob.value(QStringLiteral("playerName"));
-    if (!vplayerName.isString())
-        return;
-    QString playerName = vplayerName.toString();
-
-    QJsonValue vscreenName = ob.value(QStringLiteral("screenName"));
-    if (!vscreenName.isString())
+    QMdmmCore::Protocol::PlayerAddedNotify notify;
+    if (!QMdmmCore::Protocol::decodePayload(value, &notify))
         return;
-    QString screenName = vscreenName.toString();
-
-    QJsonValue vagentState = ob.value(QStringLiteral("agentState"));
-    if (!vagentState.isDouble())
-        return;
-    QMdmmCore::Data::AgentState agentState = QMdmmCore::Data::AgentState(static_cast<QMdmmCore::Data::AgentState::Int>(vagentState.toInt()));
+    const QString &playerName = notify.playerName;
+    const QString &screenName = notify.screenName;
+    QMdmmCore::Data::AgentState agentState = notify.agentState;
 
     // The client pre-creates its own Agent on construction (keyed by the client's objectName).
-    // When the server reports ourselves back (sign-in confirm / state snapshot), update that
+    // When the server reports ourselves back (sign-in confirm), update that
     // Agent in place and add ourselves to the room mirror, instead of treating it as a duplicate.
     if (Agent *agent = agents.value(playerName, nullptr); agent != nullptr) {
         if (playerName == q->objectName()) {
@@ -354,8 +310,8 @@ void ClientP::notifyPlayerAdded(const QJsonValue &value)
             agent->setState(agentState);
             emit q->notifyPlayerAdded(playerName, screenName, agentState, Client::QPrivateSignal());
         }
-        // A duplicate notifyPlayerAdded for another already-tracked player (a reconnect state
-        // snapshot) is benign and must not be treated as a protocol error.
+        // A duplicate notifyPlayerAdded for another already-tracked player is benign and must not
+        // be treated as a protocol error.
         onRet_.dismiss();
         return;
     }
@@ -376,16 +332,10 @@ void ClientP::notifyPlayerRemoved(const QJsonValue &value)
 {
     ONERRPRINTJSON(value);
 
-    if (!value.isObject())
-        return;
-    QJsonObject ob = value.toObject();
-
-    if (!ob.contains(QStringLiteral("playerName")))
+    QMdmmCore::Protocol::PlayerRemovedNotify notify;
+    if (!QMdmmCore::Protocol::decodePayload(value, &notify))
         return;
-    QJsonValue vplayerName = ob.value(QStringLiteral("playerName"));
-    if (!vplayerName.isString())
-        return;
-    QString playerName = vplayerName.toString();
+    const QString &playerName = notify.playerName;
     if (!agents.contains(playerName))
         return;
 
@@ -414,8 +364,6 @@ void ClientP::notifyRoundStart(const QJsonValue &value [[maybe_unused]])
     // Without this, players would stay at the default Country place and every
     // place-dependent action (BuyKnife/Move/Slash/...) would fail locally.
     room->prepareForRoundStart();
-    // A new round begins: reset the round-event counter.
-    lastRoundEventSeq = 0;
     emit q->notifyRoundStart(Client::QPrivateSignal());
 }
 
@@ -424,31 +372,14 @@ void ClientP::notifyStoneScissorsCloth(const QJsonValue &value)
 {
     ONERRPRINTJSON(value);
 
-    if (!value.isObject())
+    QMdmmCore::Protocol::NotifyPayloadType<QMdmmCore::Protocol::NotifyStoneScissorsCloth> replies;
+    if (!QMdmmCore::Protocol::decodePayload(value, &replies))
         return;
-    QJsonObject ob = value.toObject();
-
-    QHash<QString, QMdmmCore::Data::StoneScissorsCloth> replies;
-    for (QJsonObject::const_iterator it = ob.constBegin(); it != ob.constEnd(); ++it) {
-        QString playerName = it.key();
-        if (!agents.contains(playerName))
-            return;
-        QJsonValue vssc = it.value();
-        if (!vssc.isDouble())
+    for (QHash<QString, QMdmmCore::Data::StoneScissorsCloth>::const_iterator it = replies.constBegin(); it != replies.constEnd(); ++it) {
+        if (!agents.contains(it.key()))
             return;
-        QMdmmCore::Data::StoneScissorsCloth ssc = static_cast<QMdmmCore::Data::StoneScissorsCloth>(vssc.toInt());
-        switch (ssc) {
-        case QMdmmCore::Data::Stone:
-        case QMdmmCore::Data::Scissors:
-        case QMdmmCore::Data::Cloth:
-            break;
-        default:
-            return;
-        }
-        replies.insert(playerName, ssc);
     }
 
-    ++lastRoundEventSeq;
     emit q->notifyStoneScissorsCloth(replies, Client::QPrivateSignal());
     onRet_.dismiss();
 }
@@ -458,104 +389,45 @@ void ClientP::notifyActionOrder(const QJsonValue &value)
 {
     ONERRPRINTJSON(value);
 
-    if (!value.isArray())
+    QMdmmCore::Protocol::NotifyPayloadType<QMdmmCore::Protocol::NotifyActionOrder> playerNames;
+    if (!QMdmmCore::Protocol::decodePayload(value, &playerNames))
         return;
-    QJsonArray arr = value.toArray();
 
     QHash<int, QString> result;
     int i = 0;
-    for (const QJsonValueRef &val : arr) {
-        if (!val.isString())
-            return;
-        QString playerName = val.toString();
+    foreach (const QString &playerName, playerNames) {
         if (!agents.contains(playerName))
             return;
         result.insert(++i, playerName);
     }
 
-    ++lastRoundEventSeq;
     emit q->notifyActionOrder(result, Client::QPrivateSignal());
     onRet_.dismiss();
 }
 
-// NOLINTNEXTLINE(readability-make-member-function-const,readability-function-cognitive-complexity)
+// NOLINTNEXTLINE(readability-make-member-function-const)
 void ClientP::notifyAction(const QJsonValue &value)
 {
     ONERRPRINTJSON(value);
 
-    if (!value.isObject())
+    // The description of ActionNotify checks that the targets needed by the action are present
+    QMdmmCore::Protocol::ActionNotify notify;
+    if (!QMdmmCore::Protocol::decodePayload(value, &notify))
         return;
-    QJsonObject ob = value.toObject();
 
-    if (!ob.contains(QStringLiteral("playerName")))
-        return;
-    QJsonValue vplayerName = ob.value(QStringLiteral("playerName"));
-    if (!vplayerName.isString())
-        return;
-    QString playerName = vplayerName.toString();
+    const QString &playerName = notify.playerName;
     if (!agents.contains(playerName))
         return;
+    QMdmmCore::Data::Action action = notify.action;
 
-    if (!ob.contains(QStringLiteral("action")))
+    QString toPlayer = notify.toPlayer.value_or(QString());
+    if (notify.toPlayer.has_value() && !agents.contains(toPlayer))
         return;
-    QJsonValue vaction = ob.value(QStringLiteral("action"));
-    if (!vaction.isDouble())
-        return;
-    QMdmmCore::Data::Action action = static_cast<QMdmmCore::Data::Action>(vaction.toInt());
-    switch (action) {
-    case QMdmmCore::Data::DoNothing:
-    case QMdmmCore::Data::BuyKnife:
-    case QMdmmCore::Data::BuyHorse:
-    case QMdmmCore::Data::Slash:
-    case QMdmmCore::Data::Kick:
-    case QMdmmCore::Data::Move:
-    case QMdmmCore::Data::LetMove:
-        break;
-    default:
-        return;
-    }
-
-    QString toPlayer;
-    int toPlace = -1;
-
-    switch (action) {
-    case QMdmmCore::Data::Slash:
-    case QMdmmCore::Data::Kick:
-    case QMdmmCore::Data::LetMove: {
-        if (!ob.contains(QStringLiteral("toPlayer")))
-            return;
-        QJsonValue vtoPlayer = ob.value(QStringLiteral("toPlayer"));
-        if (!vtoPlayer.isString())
-            return;
-        toPlayer = vtoPlayer.toString();
-        if (!agents.contains(toPlayer))
-            return;
-
-        break;
-    }
-    default:
-        break;
-    }
 
-    switch (action) {
-    case QMdmmCore::Data::Move:
-    case QMdmmCore::Data::LetMove: {
-        if (!ob.contains(QStringLiteral("toPlace")))
-            return;
-        QJsonValue vtoPlace = ob.value(QStringLiteral("toPlace"));
-        if (!vtoPlace.isDouble())
-            return;
-        toPlace = vtoPlace.toInt();
-        if ((toPlace < 0) || (toPlace > agents.count()))
-            return;
-
-        break;
-    }
-    default:
-        break;
-    }
+    int toPlace = notify.toPlace.value_or(-1);
+    if (notify.toPlace.has_value() && ((toPlace < 0) || (toPlace > agents.count())))
+        return;
 
-    ++lastRoundEventSeq;
     emit q->notifyAction(playerName, action, toPlayer, toPlace, Client::QPrivateSignal());
 
     // This replyed action should always be success, since it is judged in Server
@@ -576,38 +448,14 @@ void ClientP::notifyUpgrade(const QJsonValue &value)
 {
     ONERRPRINTJSON(value);
 
-    if (!value.isObject())
+    QMdmmCore::Protocol::NotifyPayloadType<QMdmmCore::Protocol::NotifyUpgrade> replies;
+    if (!QMdmmCore::Protocol::decodePayload(value, &replies))
         return;
-    QJsonObject ob = value.toObject();
-
-    QHash<QString, QList<QMdmmCore::Data::UpgradeItem>> replies;
-    for (QJsonObject::const_iterator it = ob.constBegin(); it != ob.constEnd(); ++it) {
-        QString playerName = it.key();
-        if (!agents.contains(playerName))
-            return;
-        QJsonValue vupgrades = it.value();
-        if (!vupgrades.isArray())
+    for (QHash<QString, QList<QMdmmCore::Data::UpgradeItem>>::const_iterator it = replies.constBegin(); it != replies.constEnd(); ++it) {
+        if (!agents.contains(it.key()))
             return;
-        QJsonArray vaupgrades = vupgrades.toArray();
-        QList<QMdmmCore::Data::UpgradeItem> upgrades;
-        for (const QJsonValueRef &vupgrade : vaupgrades) {
-            if (!vupgrade.isDouble())
-                return;
-            QMdmmCore::Data::UpgradeItem upgrade = static_cast<QMdmmCore::Data::UpgradeItem>(vupgrade.toInt());
-            switch (upgrade) {
-            case QMdmmCore::Data::UpgradeKnife:
-            case QMdmmCore::Data::UpgradeHorse:
-            case QMdmmCore::Data::UpgradeMaxHp:
-                break;
-            default:
-                return;
-            }
-            upgrades << upgrade;
-        }
-        replies.insert(playerName, upgrades);
     }
 
-    ++lastRoundEventSeq;
     emit q->notifyUpgrade(replies, Client::QPrivateSignal());
 
     // This replyed upgrade should always be success, since it is judged in Server
@@ -633,15 +481,12 @@ void ClientP::notifyGameOver(const QJsonValue &value)
         socket->deleteLater();
     }
 
-    if (!value.isArray())
+    QMdmmCore::Protocol::NotifyPayloadType<QMdmmCore::Protocol::NotifyGameOver> playerNames;
+    if (!QMdmmCore::Protocol::decodePayload(value, &playerNames))
         return;
-    QJsonArray arr = value.toArray();
 
     QStringList winners;
-    for (const QJsonValueRef &vwinner : arr) {
-        if (!vwinner.isString())
-            return;
-        QString winner = vwinner.toString();
+    foreach (const QString &winner, playerNames) {
         // Only trust winners we actually know about; ignore unknown names.
         if (!agents.contains(winner))
             continue;
@@ -657,25 +502,15 @@ void ClientP::notifySpoken(const QJsonValue &value)
 {
     ONERRPRINTJSON(value);
 
-    if (!value.isObject())
+    QMdmmCore::Protocol::SpokenNotify notify;
+    if (!QMdmmCore::Protocol::decodePayload(value, &notify))
         return;
-    QJsonObject ob = value.toObject();
 
-    if (!ob.contains(QStringLiteral("playerName")))
-        return;
-    QJsonValue vplayerName = ob.value(QStringLiteral("playerName"));
-    if (!vplayerName.isString())
-        return;
-    QString playerName = vplayerName.toString();
+    const QString &playerName = notify.playerName;
     if (!agents.contains(playerName))
         return;
 
-    if (!ob.contains(QStringLiteral("content")))
-        return;
-    QJsonValue vContent = ob.value(QStringLiteral("content"));
-    if (!vContent.isString())
-        return;
-    QString content = QString::fromUtf8(QByteArray::fromBase64(vContent.toString().toLatin1()));
+    QString content = QString::fromUtf8(QByteArray::fromBase64(notify.content.toLatin1()));
 
     emit q->notifySpoken(playerName, content, Client::QPrivateSignal());
     onRet_.dismiss();
@@ -688,6 +523,55 @@ void ClientP::notifyOperated(const QJsonValue &value)
     Q_UNIMPLEMENTED();
 }
 
+void ClientP::notifyRoomSnapshot(const QJsonValue &value)
+{
+    ONERRPRINTJSON(value);
+
+    QMdmmCore::Protocol::RoomSnapshotNotify notify;
+    if (!QMdmmCore::Protocol::decodePayload(value, &notify))
+        return;
+
+    if (notify.state < QMdmmCore::Logic::BeforeRoundStart || notify.state > QMdmmCore::Logic::Upgrade)
+        return;
+
+    // A reconnecting client rebuilds its whole room from the snapshot. Players which are already
+    // known (including ourselves) are updated in place, the others are added.
+    foreach (const QMdmmCore::Protocol::PlayerSnapshot &snapshot, notify.players) {
+        QMdmmCore::Player *player = room->player(snapshot.playerName);
+        bool added = (player == nullptr);
+        if (added) {
+            player = room->addPlayer(snapshot.playerName);
+            if (player == nullptr)
+                return;
+        }
+
+        Agent *agent = agents.value(snapshot.playerName, nullptr);
+        if (agent == nullptr) {
+            agent = new Agent(snapshot.playerName, this);
+            agents.insert(snapshot.playerName, agent);
+        }
+        agent->setScreenName(snapshot.screenName);
+        agent->setState(snapshot.agentState);
+
+        player->setHasKnife(snapshot.hasKnife);
+        player->setHasHorse(snapshot.hasHorse);
+        // maxHp goes first, so that whoever observes hpChanged sees the matching maxHp
+        player->setMaxHp(snapshot.maxHp);
+        player->setHp(snapshot.hp);
+        player->setInitialPlace(snapshot.initialPlace);
+        player->setPlace(snapshot.place);
+        player->setKnifeDamage(snapshot.knifeDamage);
+        player->setHorseDamage(snapshot.horseDamage);
+        player->setUpgradePoint(snapshot.upgradePoint);
+
+        if (added)
+            emit q->notifyPlayerAdded(snapshot.playerName, snapshot.screenName, snapshot.agentState, Client::QPrivateSignal());
+    }
+
+    emit q->notifyRoomSnapshot(static_cast<QMdmmCore::Logic::State>(notify.state), Client::QPrivateSignal());
+    onRet_.dismiss();
+}
+
 // NOLINTNEXTLINE(readability-make-member-function-const)
 bool ClientP::applyAction(const QString &playerName, QMdmmCore::Data::Action action, const QString &toPlayer, int toPlace)
 {
@@ -762,14 +646,14 @@ void ClientP::socketPacketReceived(const QMdmmCore::Packet &packet)
 
     if (packet.type() == QMdmmCore::Protocol::TypeRequest) {
         currentRequest = packet.requestId();
-        void (ClientP::*call)(const QJsonValue &) = requestCallback.value(packet.requestId(), nullptr);
+        void (ClientP::*call)(const QJsonValue &) = requestCallback.value(packet.requestId());
         if (call != nullptr)
             (this->*call)(packet.value());
         else
             socket->setHasError(true);
     } else if (packet.type() == QMdmmCore::Protocol::TypeNotify) {
         if (((packet.notifyId() & QMdmmCore::Protocol::NotifyFromServerMask) != 0) || ((packet.notifyId() & QMdmmCore::Protocol::NotifyFromAgentMask) != 0)) {
-            void (ClientP::*call)(const QJsonValue &) = notifyCallback.value(packet.notifyId(), nullptr);
+            void (ClientP::*call)(const QJsonValue &) = notifyCallback.value(packet.notifyId());
             if (call != nullptr)
                 (this->*call)(packet.value());
             else
@@ -819,7 +703,7 @@ bool ClientP::connectSocket()
     connect(socket, &Socket::socketDisconnected, this, &ClientP::socketDisconnected);
     connect(socket, &Socket::socketErrorOccurred, this, &ClientP::socketErrorOccurred);
     connect(socket, &Socket::packetReceived, this, &ClientP::socketPacketReceived);
-    if (socket->connectToHost(host))
+    if (socket->connectToHost(host, sslConfiguration))
         return true;
 
     // The host does not map to a known transport. Drop the socketless wrapper so
@@ -848,6 +732,8 @@ void ClientP::scheduleReconnect()
 void ClientP::reconnectTimeout()
 {
     ++reconnectAttempts;
+    // sslConfiguration still carries the session ticket of the lost connection, so an encrypted
+    // reconnect resumes the TLS session instead of doing a full handshake
     if (connectSocket())
         return;
 
@@ -27,8 +27,8 @@ class QMDMMNETWORKING_PRIVATE_EXPORT ClientP final : public QObject
     Q_OBJECT
 
 public:
-    static QHash<QMdmmCore::Protocol::RequestId, void (ClientP::*)(const QJsonValue &)> requestCallback;
-    static QHash<QMdmmCore::Protocol::NotifyId, void (ClientP::*)(const QJsonValue &)> notifyCallback;
+    static QMdmmCore::Protocol::DispatchTable<QMdmmCore::Protocol::RequestId, void (ClientP::*)(const QJsonValue &)> requestCallback;
+    static QMdmmCore::Protocol::DispatchTable<QMdmmCore::Protocol::NotifyId, void (ClientP::*)(const QJsonValue &)> notifyCallback;
 
     ClientP(ClientConfiguration clientConfiguration, Client *q);
 
@@ -48,15 +48,14 @@ public:
     int reconnectAttempts;
     bool reconnectInProgress;
 
+    // The TLS configuration for qmdmms:// and wss:// hosts. Once signed in, it is replaced by the configuration of
+    // the connection, whose session ticket lets the automatic reconnect resume the TLS session without a full handshake
+    QSslConfiguration sslConfiguration;
+    void resetSslConfiguration();
+
     QMdmmCore::Protocol::RequestId currentRequest;
     QMdmmCore::Data::AgentState initialState;
 
-    // Number of round events received this round. The client increments this counter by one for
-    // every round-event notify it receives (and resets it on notifyRoundStart), and reports it on
-    // reconnect for the precise catch-up (see backlog "precise catch-up"). Its value doubles as
-    // the last received round-event sequence number.
-    int lastRoundEventSeq = 0;
-
     void requestStoneScissorsCloth(const QJsonValue &value);
     void requestActionOrder(const QJsonValue &value);
     void requestAction(const QJsonValue &value);
@@ -78,6 +77,7 @@ public:
     void notifyGameOver(const QJsonValue &value);
     void notifySpoken(const QJsonValue &value);
     void notifyOperated(const QJsonValue &value);
+    void notifyRoomSnapshot(const QJsonValue &value);
 
     bool applyAction(const QString &playerName, QMdmmCore::Data::Action action, const QString &toPlayer, int toPlace);
     bool applyUpgrade(const QHash<QString, QList<QMdmmCore::Data::UpgradeItem>> &upgrades);
@@ -0,0 +1,452 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+
+#include "qmdmmepoll_p.h"
+
+#ifdef Q_OS_LINUX
+
+#include <QTimer>
+
+#include <algorithm>
+#include <cerrno>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace QMdmmNetworking {
+namespace p {
+
+std::shared_ptr<EpollReactor> EpollReactor::instance()
+{
+    thread_local std::weak_ptr<EpollReactor> current;
+
+    std::shared_ptr<EpollReactor> reactor = current.lock();
+    if (reactor == nullptr) {
+        // A handler may release the reactor while it is dispatching, so it is deleted by the event loop
+        reactor = std::shared_ptr<EpollReactor>(new EpollReactor, [](EpollReactor *r) { r->deleteLater(); });
+        current = reactor;
+    }
+
+    return reactor;
+}
+
+EpollReactor::EpollReactor()
+    : epollFd(epoll_create1(EPOLL_CLOEXEC))
+    , notifier(nullptr)
+    , dispatching(nullptr)
+    , dispatchingCount(0)
+{
+    if (epollFd == -1) {
+        qWarning("epoll_create1 failed: %s", qPrintable(qt_error_string(errno)));
+        return;
+    }
+
+    notifier = new QSocketNotifier(epollFd, QSocketNotifier::Read, this);
+    connect(notifier, &QSocketNotifier::activated, this, &EpollReactor::activated);
+}
+
+EpollReactor::~EpollReactor()
+{
+    if (epollFd != -1)
+        ::close(epollFd);
+}
+
+bool EpollReactor::add(int fd, uint32_t events, EpollHandler *handler)
+{
+    epoll_event event {};
+    event.events = events;
+    event.data.ptr = handler;
+    return epollFd != -1 && epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+bool EpollReactor::modify(int fd, uint32_t events, EpollHandler *handler)
+{
+    epoll_event event {};
+    event.events = events;
+    event.data.ptr = handler;
+    return epollFd != -1 && epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event) == 0;
+}
+
+void EpollReactor::remove(int fd, EpollHandler *handler)
+{
+    if (epollFd != -1)
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+
+    for (int i = 0; i < dispatchingCount; ++i) {
+        if (dispatching[i].data.ptr == handler)
+            dispatching[i].data.ptr = nullptr;
+    }
+}
+
+void EpollReactor::activated()
+{
+    epoll_event events[maximumEvents];
+    int count = epoll_wait(epollFd, events, maximumEvents, 0);
+    if (count <= 0)
+        return;
+
+    // More ready descriptors than maximumEvents keep the epoll descriptor readable, so they are reported in the next
+    // event loop iteration, after other events are processed
+    dispatching = events;
+    dispatchingCount = count;
+    for (int i = 0; i < count; ++i) {
+        auto *handler = static_cast<EpollHandler *>(events[i].data.ptr);
+        if (handler != nullptr)
+            handler->epollEvents(events[i].events);
+    }
+    dispatching = nullptr;
+    dispatchingCount = 0;
+}
+
+SocketP_Epoll::SocketP_Epoll(int fd, Socket *q)
+    : SocketP_Stream(q)
+    , reactor(EpollReactor::instance())
+    , fd(fd)
+    , writeOffset(0)
+    , closing(false)
+    , watchedEvents(EPOLLIN)
+{
+    if (fd == -1)
+        return;
+
+    // Packets are already coalesced by corking, so Nagle's algorithm would only delay them
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    applyReceiveLimits();
+
+    if (!reactor->add(fd, watchedEvents, this)) {
+        qWarning("Socket %d can't be watched: %s", fd, qPrintable(qt_error_string(errno)));
+        ::close(fd);
+        this->fd = -1;
+    }
+}
+
+SocketP_Epoll::SocketP_Epoll(Socket *q)
+    : SocketP_Epoll(-1, q)
+{
+}
+
+SocketP_Epoll::~SocketP_Epoll()
+{
+    if (fd != -1) {
+        if (reactor != nullptr)
+            reactor->remove(fd, this);
+        ::close(fd);
+    }
+}
+
+bool SocketP_Epoll::connectToHost(const QString & /*addr*/)
+{
+    return false;
+}
+
+bool SocketP_Epoll::disconnectFromHost()
+{
+    if (fd == -1)
+        return false;
+
+    uncork();
+    if (bytesToWrite() == 0) {
+        closeFd();
+        return true;
+    }
+
+    closing = true;
+    updateEvents();
+    return true;
+}
+
+void SocketP_Epoll::abort()
+{
+    corkedFrames.clear();
+    closeFd();
+}
+
+qint64 SocketP_Epoll::bytesToWrite() const
+{
+    return writeBuffer.size() - writeOffset;
+}
+
+QSslConfiguration SocketP_Epoll::sessionSslConfiguration() const
+{
+    return {};
+}
+
+bool SocketP_Epoll::streamOpen() const
+{
+    return fd != -1;
+}
+
+void SocketP_Epoll::writeStreamFrames(const QByteArray &frames)
+{
+    if (fd == -1)
+        return;
+
+    if (writeOffset == writeBuffer.size()) {
+        writeBuffer = frames;
+    } else {
+        writeBuffer.remove(0, writeOffset);
+        writeBuffer.append(frames);
+    }
+    writeOffset = 0;
+
+    writePending();
+}
+
+void SocketP_Epoll::applyReceiveLimits()
+{
+    // The kernel buffers at most about this much, TCP flow control holds back the peer beyond it
+    if (fd != -1)
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &receiveBufferSize, sizeof(receiveBufferSize));
+}
+
+void SocketP_Epoll::epollEvents(uint32_t events)
+{
+    if ((events & EPOLLERR) != 0) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length);
+        connectionError(error);
+        return;
+    }
+
+    // Data which arrived before a hang up is still read
+    if ((events & EPOLLIN) != 0)
+        readAvailable();
+    if (fd != -1 && (events & EPOLLOUT) != 0)
+        writePending();
+    if (fd != -1 && (events & EPOLLHUP) != 0)
+        closeFd();
+}
+
+bool SocketP_Epoll::event(QEvent *e)
+{
+    // Sent in the old thread before the move. The queued call moves along with this object
+    if (e->type() == QEvent::ThreadChange && reactor != nullptr) {
+        if (fd != -1)
+            reactor->remove(fd, this);
+        reactor.reset();
+        QMetaObject::invokeMethod(this, &SocketP_Epoll::attachReactor, Qt::QueuedConnection);
+    }
+
+    return SocketP::event(e);
+}
+
+void SocketP_Epoll::attachReactor()
+{
+    if (reactor != nullptr)
+        return;
+
+    reactor = EpollReactor::instance();
+    if (fd == -1)
+        return;
+
+    watchedEvents = ((hasError || closing) ? 0 : EPOLLIN) | (writeOffset < writeBuffer.size() ? EPOLLOUT : 0);
+    if (!reactor->add(fd, watchedEvents, this))
+        connectionError(errno);
+}
+
+void SocketP_Epoll::readAvailable()
+{
+    // Read at most the receive buffer limit per event, so one busy peer doesn't hold up the others.
+    // What is left is reported again, since watching is level-triggered
+    qsizetype budget = receiveBufferLimit();
+    while (fd != -1 && !hasError && budget > 0) {
+        int pending = 0;
+        ioctl(fd, FIONREAD, &pending);
+        // Nothing pending on a readable descriptor means the peer has closed the connection, which recv tells
+        qsizetype chunk = std::min<qsizetype>({std::max(pending, 1), receiveBufferLimit() - receiveBuffer.size(), budget});
+        if (chunk <= 0)
+            break;
+
+        ssize_t received = ::recv(fd, receiveBuffer.reserve(chunk), chunk, 0);
+        if (received > 0) {
+            receiveBuffer.commit(received);
+            budget -= received;
+            if (!streamFramesReceived() || received >= pending)
+                break;
+            continue;
+        }
+        if (received == 0) {
+            closeFd();
+            return;
+        }
+        if (errno == EINTR)
+            continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            connectionError(errno);
+        break;
+    }
+
+    receiveBuffer.squeeze();
+
+    // Nothing is read from a connection with error any more, stop watching it for reading
+    if (fd != -1 && hasError)
+        updateEvents();
+}
+
+void SocketP_Epoll::writePending()
+{
+    while (fd != -1 && writeOffset < writeBuffer.size()) {
+        ssize_t sent = ::send(fd, writeBuffer.constData() + writeOffset, writeBuffer.size() - writeOffset, MSG_NOSIGNAL);
+        if (sent >= 0) {
+            writeOffset += sent;
+            continue;
+        }
+        if (errno == EINTR)
+            continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            connectionError(errno);
+        break;
+    }
+
+    if (fd == -1)
+        return;
+
+    if (writeOffset == writeBuffer.size()) {
+        writeBuffer.clear();
+        writeOffset = 0;
+        if (closing) {
+            closeFd();
+            return;
+        }
+    }
+
+    updateEvents();
+}
+
+void SocketP_Epoll::updateEvents()
+{
+    // Applied by attachReactor while moving to another thread
+    if (reactor == nullptr)
+        return;
+
+    uint32_t events = ((hasError || closing) ? 0 : EPOLLIN) | (writeOffset < writeBuffer.size() ? EPOLLOUT : 0);
+    if (events != watchedEvents && reactor->modify(fd, events, this))
+        watchedEvents = events;
+}
+
+void SocketP_Epoll::connectionError(int error)
+{
+    errorOccurred(qt_error_string(error));
+    closeFd();
+}
+
+void SocketP_Epoll::closeFd()
+{
+    if (fd == -1)
+        return;
+
+    if (reactor != nullptr)
+        reactor->remove(fd, this);
+    ::close(fd);
+    fd = -1;
+    writeBuffer.clear();
+    writeOffset = 0;
+    closing = false;
+    watchedEvents = 0;
+
+    socketDisconnected();
+}
+
+EpollListener::EpollListener(QObject *parent)
+    : QObject(parent)
+    , reactor(EpollReactor::instance())
+    , fd(-1)
+{
+}
+
+EpollListener::~EpollListener()
+{
+    close();
+}
+
+bool EpollListener::listen(uint16_t port)
+{
+    close();
+
+    // A dual stack socket listens on every IPv4 and IPv6 address, like QHostAddress::Any
+    bool ipv6 = true;
+    int s = ::socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (s == -1) {
+        ipv6 = false;
+        s = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (s == -1)
+            return false;
+    }
+
+    int one = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    int bound = -1;
+    if (ipv6) {
+        int zero = 0;
+        setsockopt(s, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+        sockaddr_in6 address {};
+        address.sin6_family = AF_INET6;
+        address.sin6_addr = in6addr_any;
+        address.sin6_port = htons(port);
+        bound = ::bind(s, reinterpret_cast<sockaddr *>(&address), sizeof(address)); // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+    } else {
+        sockaddr_in address {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(port);
+        bound = ::bind(s, reinterpret_cast<sockaddr *>(&address), sizeof(address)); // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+    }
+
+    if (bound == -1 || ::listen(s, SOMAXCONN) == -1 || !reactor->add(s, EPOLLIN, this)) {
+        ::close(s);
+        return false;
+    }
+
+    fd = s;
+    return true;
+}
+
+void EpollListener::close()
+{
+    if (fd != -1) {
+        reactor->remove(fd, this);
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+void EpollListener::epollEvents(uint32_t /*events*/)
+{
+    while (fd != -1) {
+        int s = accept4(fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (s != -1) {
+            emit newConnection(s);
+            continue;
+        }
+
+        if (errno == EINTR || errno == ECONNABORTED)
+            continue;
+        if (errno == EMFILE || errno == ENFILE) {
+            // The pending connection keeps the listening socket readable, so stop watching it for a while instead of
+            // being woken up again at once
+            qWarning("accept4 failed: %s", qPrintable(qt_error_string(errno)));
+            reactor->modify(fd, 0, this);
+            QTimer::singleShot(acceptRetryInterval, this, &EpollListener::resumeAccepting);
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            qWarning("accept4 failed: %s", qPrintable(qt_error_string(errno)));
+        }
+        break;
+    }
+}
+
+void EpollListener::resumeAccepting()
+{
+    if (fd != -1)
+        reactor->modify(fd, EPOLLIN, this);
+}
+
+} // namespace p
+} // namespace QMdmmNetworking
+
+#endif
@@ -0,0 +1,153 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+
+#ifndef QMDMMEPOLL_P
+#define QMDMMEPOLL_P
+
+#include "qmdmmsocket_p.h"
+
+#include <QByteArray>
+#include <QEvent>
+#include <QObject>
+#include <QSocketNotifier>
+#include <QtGlobal>
+
+#include <cstdint>
+#include <memory>
+
+#ifdef Q_OS_LINUX
+
+#include <sys/epoll.h>
+
+// NOLINTBEGIN(misc-non-private-member-variables-in-classes): This is private header
+
+namespace QMdmmNetworking {
+namespace p {
+
+// A file descriptor watched by an EpollReactor, which is called with the events it is ready for
+class QMDMMNETWORKING_PRIVATE_EXPORT EpollHandler
+{
+public:
+    EpollHandler() = default;
+    virtual ~EpollHandler() = default;
+    Q_DISABLE_COPY_MOVE(EpollHandler);
+
+    virtual void epollEvents(uint32_t events) = 0;
+};
+
+// One epoll instance per thread, shared by every EpollHandler living in it.
+// Only the epoll file descriptor is watched by the Qt event loop, so any number of connections cost a single
+// QSocketNotifier, and one epoll_wait call reports every connection which is ready. Watching is level-triggered.
+class QMDMMNETWORKING_PRIVATE_EXPORT EpollReactor final : public QObject
+{
+    Q_OBJECT
+
+public:
+    // The reactor of the current thread. It is created on first use and deleted after its last handler is gone
+    static std::shared_ptr<EpollReactor> instance();
+
+    ~EpollReactor() override;
+    Q_DISABLE_COPY_MOVE(EpollReactor);
+
+    bool add(int fd, uint32_t events, EpollHandler *handler);
+    bool modify(int fd, uint32_t events, EpollHandler *handler);
+    void remove(int fd, EpollHandler *handler);
+
+public slots: // NOLINT(readability-redundant-access-specifiers)
+    void activated();
+
+private:
+    EpollReactor();
+
+    static constexpr int maximumEvents = 256;
+
+    int epollFd;
+    QSocketNotifier *notifier;
+    // The events being dispatched. A handler removed meanwhile is cleared from them, so that it is not called any more
+    epoll_event *dispatching;
+    int dispatchingCount;
+};
+
+// A TCP connection on a non-blocking file descriptor, read and written directly with system calls.
+// It is a server side transport: a descriptor is adopted from EpollListener, and connectToHost is not supported
+class QMDMMNETWORKING_PRIVATE_EXPORT SocketP_Epoll final : public SocketP_Stream, public EpollHandler
+{
+    Q_OBJECT
+
+public:
+    SocketP_Epoll(int fd, Socket *q);
+    explicit SocketP_Epoll(Socket *q);
+    ~SocketP_Epoll() override;
+    Q_DISABLE_COPY_MOVE(SocketP_Epoll);
+
+    [[nodiscard]] Socket::Type type() const override
+    {
+        return Socket::TypeEpoll;
+    }
+
+    bool connectToHost(const QString &addr) override;
+    bool disconnectFromHost() override;
+    void abort() override;
+    [[nodiscard]] qint64 bytesToWrite() const override;
+    [[nodiscard]] QSslConfiguration sessionSslConfiguration() const override;
+    [[nodiscard]] bool streamOpen() const override;
+    void writeStreamFrames(const QByteArray &frames) override;
+    void applyReceiveLimits() override;
+
+    void epollEvents(uint32_t events) override;
+    bool event(QEvent *e) override;
+
+    // The descriptor is watched by the reactor of the thread the socket lives in. Moving to another thread detaches it
+    // from the old reactor, and it is attached to the new one once the event loop there picks it up
+    void attachReactor();
+    void readAvailable();
+    void writePending();
+    void updateEvents();
+    void connectionError(int error);
+    void closeFd();
+
+    std::shared_ptr<EpollReactor> reactor;
+    int fd;
+    // Bytes the kernel did not take yet. Written bytes before writeOffset are dropped on the next append
+    QByteArray writeBuffer;
+    qsizetype writeOffset;
+    // disconnectFromHost was called, the connection is closed once the write buffer is empty
+    bool closing;
+    uint32_t watchedEvents;
+};
+
+// Accepts TCP connections on every address with non-blocking file descriptors for SocketP_Epoll
+class QMDMMNETWORKING_PRIVATE_EXPORT EpollListener final : public QObject, public EpollHandler
+{
+    Q_OBJECT
+
+public:
+    explicit EpollListener(QObject *parent = nullptr);
+    ~EpollListener() override;
+    Q_DISABLE_COPY_MOVE(EpollListener);
+
+    bool listen(uint16_t port);
+    void close();
+
+    void epollEvents(uint32_t events) override;
+
+signals:
+    void newConnection(qintptr socketDescriptor);
+
+private slots:
+    void resumeAccepting();
+
+private:
+    static constexpr int acceptRetryInterval = 100;
+
+    std::shared_ptr<EpollReactor> reactor;
+    int fd;
+};
+
+} // namespace p
+} // namespace QMdmmNetworking
+
+// NOLINTEND(misc-non-private-member-variables-in-classes): This is private header
+
+#endif
+
+#endif
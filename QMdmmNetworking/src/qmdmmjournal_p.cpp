@@ -0,0 +1,230 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+
+#include "qmdmmjournal_p.h"
+
+#include <QCborValue>
+#include <QtEndian>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <cstdio>
+#include <sys/mman.h>
+#endif
+
+namespace QMdmmNetworking {
+namespace p {
+
+namespace {
+// The file grows by this much at least, so most records are appended without remapping it
+constexpr qint64 chunkSize = 65536;
+constexpr qint64 sizeFieldSize = sizeof(quint32);
+
+qint64 roundUpToChunk(qint64 size)
+{
+    return std::max<qint64>((size + chunkSize - 1) / chunkSize * chunkSize, chunkSize);
+}
+} // namespace
+
+RoomJournal::RoomJournal(const QString &path)
+    : path(path)
+    , file(std::make_unique<QFile>(path))
+    , data(nullptr)
+    , capacity(0)
+    , end(0)
+{
+}
+
+RoomJournal::~RoomJournal()
+{
+    close();
+}
+
+bool RoomJournal::map(qint64 newCapacity)
+{
+    if (data != nullptr) {
+        file->unmap(data);
+        data = nullptr;
+    }
+
+    // The grown part of the file reads as zeros
+    if (!file->resize(newCapacity))
+        return false;
+
+    data = file->map(0, newCapacity);
+    if (data == nullptr)
+        return false;
+
+    capacity = newCapacity;
+    return true;
+}
+
+void RoomJournal::close()
+{
+    if (data != nullptr) {
+        commit();
+        file->unmap(data);
+        data = nullptr;
+    }
+    file->close();
+    capacity = 0;
+    end = 0;
+}
+
+bool RoomJournal::create()
+{
+    close();
+    if (!file->open(QIODevice::ReadWrite | QIODevice::Truncate))
+        return false;
+
+    return map(chunkSize);
+}
+
+bool RoomJournal::open(QList<QCborArray> *records)
+{
+    close();
+    if (!file->open(QIODevice::ReadWrite))
+        return false;
+
+    if (!map(roundUpToChunk(file->size())))
+        return false;
+
+    while (end + sizeFieldSize <= capacity) {
+        auto size = static_cast<qint64>(qFromBigEndian<quint32>(data + end));
+        if (size == 0 || end + sizeFieldSize + size > capacity)
+            break;
+
+        QCborValue record = QCborValue::fromCbor(QByteArray(reinterpret_cast<const char *>(data + end + sizeFieldSize), size));
+        if (!record.isArray())
+            break;
+
+        records->append(record.toArray());
+        end += sizeFieldSize + size;
+    }
+
+    // Whatever follows the last whole record is torn, and it must not be read as a part of the next record appended
+    std::memset(data + end, 0, capacity - end);
+    return true;
+}
+
+void RoomJournal::append(const QCborArray &record)
+{
+    if (data == nullptr)
+        return;
+
+    QByteArray bytes = QCborValue(record).toCbor();
+    // The size field after the record stays zero
+    qint64 needed = end + sizeFieldSize + bytes.size() + sizeFieldSize;
+    if (needed > capacity && !map(roundUpToChunk(std::max(needed, capacity * 2)))) {
+        qWarning("Journal %s can't grow, the room won't be recovered", qPrintable(path));
+        close();
+        return;
+    }
+
+    std::memcpy(data + end + sizeFieldSize, bytes.constData(), bytes.size());
+    // The record is complete before its size is
+    std::atomic_thread_fence(std::memory_order_release);
+    qToBigEndian<quint32>(static_cast<quint32>(bytes.size()), data + end);
+    end += sizeFieldSize + bytes.size();
+}
+
+void RoomJournal::commit()
+{
+#ifdef Q_OS_UNIX
+    if (data != nullptr)
+        ::msync(data, static_cast<size_t>(capacity), MS_ASYNC);
+#endif
+}
+
+bool RoomJournal::compact(const QList<QCborArray> &records, qint64 offset)
+{
+    if (data == nullptr || offset < 0 || offset > end)
+        return false;
+
+    QByteArray head;
+    foreach (const QCborArray &record, records) {
+        QByteArray bytes = QCborValue(record).toCbor();
+        char size[sizeFieldSize];
+        qToBigEndian<quint32>(static_cast<quint32>(bytes.size()), size);
+        head.append(size, sizeFieldSize).append(bytes);
+    }
+    qint64 newEnd = head.size() + (end - offset);
+    qint64 newCapacity = roundUpToChunk(newEnd + sizeFieldSize);
+
+    // The compacted journal is copied into a mapping of a new file, like appended records, and the kernel writes it back
+    // later. A file left by a crash before the rename is not a journal, and it is truncated by the next compaction
+    auto compacted = std::make_unique<QFile>(path + QStringLiteral(".compact"));
+    if (!compacted->open(QIODevice::ReadWrite | QIODevice::Truncate))
+        return false;
+
+    uchar *compactedData = nullptr;
+    if (compacted->resize(newCapacity))
+        compactedData = compacted->map(0, newCapacity);
+    if (compactedData == nullptr) {
+        compacted->remove();
+        return false;
+    }
+
+    std::memcpy(compactedData, head.constData(), head.size());
+    std::memcpy(compactedData + head.size(), data + offset, end - offset);
+
+#ifdef Q_OS_UNIX
+    ::msync(compactedData, static_cast<size_t>(newCapacity), MS_ASYNC);
+
+    // rename(2) replaces the journal atomically while both files stay open and mapped, then the new one is appended to
+    if (::rename(QFile::encodeName(compacted->fileName()).constData(), QFile::encodeName(path).constData()) != 0) {
+        compacted->unmap(compactedData);
+        compacted->remove();
+        return false;
+    }
+
+    // The old file is unlinked already, nothing of it needs to be written back
+    file->unmap(data);
+    file->close();
+    file = std::move(compacted);
+    data = compactedData;
+    capacity = newCapacity;
+    end = newEnd;
+    return true;
+#else
+    // An open file can't be replaced here, so both are closed for the rename. A crash between the removal and the rename
+    // loses the journal
+    compacted->unmap(compactedData);
+    compacted->close();
+    qint64 oldEnd = end;
+    close();
+    bool replaced = QFile::remove(path);
+    if (!replaced) {
+        compacted->remove();
+        newEnd = oldEnd;
+    } else if (!compacted->rename(path)) {
+        qWarning("Journal %s can't be replaced, the room won't be recovered", qPrintable(path));
+        compacted->remove();
+        return false;
+    }
+
+    file = std::make_unique<QFile>(path);
+    if (!file->open(QIODevice::ReadWrite) || !map(roundUpToChunk(newEnd + sizeFieldSize))) {
+        close();
+        return false;
+    }
+    end = newEnd;
+    return replaced;
+#endif
+}
+
+void RoomJournal::remove()
+{
+    close();
+    QFile::remove(path);
+}
+
+qint64 RoomJournal::size() const noexcept
+{
+    return end;
+}
+
+} // namespace p
+} // namespace QMdmmNetworking
@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+
+#ifndef QMDMMJOURNAL_P
+#define QMDMMJOURNAL_P
+
+#include "qmdmmnetworkingglobal.h"
+
+#include <QCborArray>
+#include <QFile>
+#include <QList>
+#include <QString>
+#include <QtGlobal>
+
+#include <cstdint>
+#include <memory>
+
+// NOLINTBEGIN(misc-non-private-member-variables-in-classes): This is private header
+
+namespace QMdmmNetworking {
+namespace p {
+
+// The input journal of a room: every input its Logic consumes, in order, from which a restarted server rebuilds the room.
+// The file only grows, and it is mapped into memory, so appending a record is a copy into the page cache, which survives
+// a crash of the process. The kernel is asked to write it back once per event loop iteration (see commit), without
+// waiting for the disk.
+// A record is its size as a 32-bit big endian integer followed by a CBOR array, whose first element is its type. The
+// file is preallocated with zeros, and a record is written before its size, so a record torn by a crash reads as the end
+// of the journal.
+class QMDMMNETWORKING_PRIVATE_EXPORT RoomJournal final
+{
+public:
+    enum RecordType : uint8_t
+    {
+        RecordConfiguration,
+        RecordPlayerAdded,
+        RecordPlayerRemoved,
+        RecordRoundStart,
+        RecordSscReply,
+        RecordActionOrderReply,
+        RecordActionReply,
+        RecordUpgradeReply,
+        RecordSnapshot,
+    };
+
+    explicit RoomJournal(const QString &path);
+    ~RoomJournal();
+    Q_DISABLE_COPY_MOVE(RoomJournal);
+
+    // Start an empty journal, replacing the file
+    bool create();
+    // Read the records of an existing journal, then append to it
+    bool open(QList<QCborArray> *records);
+
+    void append(const QCborArray &record);
+    // Ask the kernel to write the appended records back to the disk, without waiting for it
+    void commit();
+    // Replace the records before offset with the given ones. The new file is written through a mapping as well, without
+    // waiting for the disk, and renamed over the old one, so a crash meanwhile leaves either of them
+    bool compact(const QList<QCborArray> &records, qint64 offset);
+    // Delete the file, the journal is closed
+    void remove();
+
+    // The offset where the next record is appended
+    [[nodiscard]] qint64 size() const noexcept;
+
+private:
+    bool map(qint64 newCapacity);
+    void close();
+
+    QString path;
+    // Compaction replaces the file, so it is held by pointer
+    std::unique_ptr<QFile> file;
+    uchar *data;
+    qint64 capacity;
+    qint64 end;
+};
+
+} // namespace p
+} // namespace QMdmmNetworking
+
+// NOLINTEND(misc-non-private-member-variables-in-classes): This is private header
+
+#endif
@@ -3,9 +3,14 @@
 #include "qmdmmlogicrunner.h"
 #include "qmdmmlogicrunner_p.h"
 
+#include <QCborMap>
+#include <QCborValue>
+#include <QCoreApplication>
+#include <QEvent>
 #include <QJsonArray>
 #include <QMetaType>
 #include <QRandomGenerator>
+#include <algorithm>
 #include <utility>
 
 /**
@@ -17,19 +22,19 @@ namespace QMdmmNetworking {
 #ifndef DOXYGEN
 namespace p {
 
-QHash<QMdmmCore::Protocol::NotifyId, void (ServerConnection::*)(const QJsonValue &)> ServerConnection::notifyCallback {
+QMdmmCore::Protocol::DispatchTable<QMdmmCore::Protocol::NotifyId, void (ServerConnection::*)(const QJsonValue &)> ServerConnection::notifyCallback {
     std::make_pair(QMdmmCore::Protocol::NotifySpeak, &ServerConnection::receiveSpeak),
     std::make_pair(QMdmmCore::Protocol::NotifyOperate, &ServerConnection::receiveOperate),
 };
 
-QHash<QMdmmCore::Protocol::RequestId, void (ServerConnection::*)(const QJsonValue &)> ServerConnection::replyCallback {
+QMdmmCore::Protocol::DispatchTable<QMdmmCore::Protocol::RequestId, void (ServerConnection::*)(const QJsonValue &)> ServerConnection::replyCallback {
     std::make_pair(QMdmmCore::Protocol::RequestStoneScissorsCloth, &ServerConnection::decodeStoneScissorsClothReply),
     std::make_pair(QMdmmCore::Protocol::RequestActionOrder, &ServerConnection::decodeActionOrderReply),
     std::make_pair(QMdmmCore::Protocol::RequestAction, &ServerConnection::decodeActionReply),
     std::make_pair(QMdmmCore::Protocol::RequestUpgrade, &ServerConnection::decodeUpgradeReply),
 };
 
-QHash<QMdmmCore::Protocol::RequestId, void (ServerConnection::*)()> ServerConnection::defaultReplyCallback {
+QMdmmCore::Protocol::DispatchTable<QMdmmCore::Protocol::RequestId, void (ServerConnection::*)()> ServerConnection::defaultReplyCallback {
     std::make_pair(QMdmmCore::Protocol::RequestStoneScissorsCloth, &ServerConnection::defaultReplyStoneScissorsCloth),
     std::make_pair(QMdmmCore::Protocol::RequestActionOrder, &ServerConnection::defaultReplyActionOrder),
     std::make_pair(QMdmmCore::Protocol::RequestAction, &ServerConnection::defaultReplyAction),
@@ -44,6 +49,7 @@ ServerConnection::ServerConnection(Agent *agent, const QMdmmCore::LogicConfigura
     , conf(logicConfiguration)
     , currentRequest(QMdmmCore::Protocol::RequestInvalid)
     , requestTimer(new QTimer(this))
+    , snapshotPending(false)
 {
     requestTimer->setInterval(conf.requestTimeout() + requestTimeoutGracePeriod);
     requestTimer->setSingleShot(true);
@@ -136,155 +142,47 @@ void ServerConnection::addRequest(QMdmmCore::Protocol::RequestId requestId, cons
 
 void ServerConnection::decodeStoneScissorsClothReply(const QJsonValue &value)
 {
-#define DEFAULTREPLY                      \
-    do {                                  \
-        defaultReplyStoneScissorsCloth(); \
-        return;                           \
-    } while (0)
-
-    if (!value.isDouble())
-        DEFAULTREPLY;
-
-    QMdmmCore::Data::StoneScissorsCloth ssc = static_cast<QMdmmCore::Data::StoneScissorsCloth>(value.toInt());
-    switch (ssc) {
-    case QMdmmCore::Data::Stone:
-    case QMdmmCore::Data::Scissors:
-    case QMdmmCore::Data::Cloth:
-        break;
-    default:
-        DEFAULTREPLY;
+    QMdmmCore::Protocol::ReplyPayloadType<QMdmmCore::Protocol::RequestStoneScissorsCloth> ssc {};
+    if (!QMdmmCore::Protocol::decodePayload(value, &ssc)) {
+        defaultReplyStoneScissorsCloth();
+        return;
     }
 
     agent->stoneScissorsCloth(ssc);
-
-#undef DEFAULTREPLY
 }
 
 void ServerConnection::decodeActionOrderReply(const QJsonValue &value)
 {
-#define DEFAULTREPLY               \
-    do {                           \
-        defaultReplyActionOrder(); \
-        return;                    \
-    } while (0)
-
-    if (!value.isArray())
-        DEFAULTREPLY;
-
-    QJsonArray arr = value.toArray();
-    QList<int> ao;
-    for (QJsonArray::const_iterator it = arr.constBegin(); it != arr.constEnd(); ++it) {
-        if (!it->isDouble())
-            DEFAULTREPLY;
-        ao << it->toInt();
+    QMdmmCore::Protocol::ReplyPayloadType<QMdmmCore::Protocol::RequestActionOrder> ao;
+    if (!QMdmmCore::Protocol::decodePayload(value, &ao)) {
+        defaultReplyActionOrder();
+        return;
     }
 
     agent->actionOrder(ao);
-
-#undef DEFAULTREPLY
 }
 
 void ServerConnection::decodeActionReply(const QJsonValue &value)
 {
-#define DEFAULTREPLY          \
-    do {                      \
-        defaultReplyAction(); \
-        return;               \
-    } while (0)
-
-    if (!value.isObject())
-        DEFAULTREPLY;
-
-    QJsonObject arr = value.toObject();
-
-    if (!arr.contains(QStringLiteral("action")))
-        DEFAULTREPLY;
-    QJsonValue vaction = arr.value(QStringLiteral("action"));
-    if (!vaction.isDouble())
-        DEFAULTREPLY;
-    QMdmmCore::Data::Action act = static_cast<QMdmmCore::Data::Action>(vaction.toInt());
-    switch (act) {
-    case QMdmmCore::Data::DoNothing:
-    case QMdmmCore::Data::BuyKnife:
-    case QMdmmCore::Data::BuyHorse:
-    case QMdmmCore::Data::Slash:
-    case QMdmmCore::Data::Kick:
-    case QMdmmCore::Data::Move:
-    case QMdmmCore::Data::LetMove:
-        break;
-    default:
-        DEFAULTREPLY;
-    }
-
-    QString toPlayer;
-    switch (act) {
-    case QMdmmCore::Data::Slash:
-    case QMdmmCore::Data::Kick:
-    case QMdmmCore::Data::LetMove: {
-        if (!arr.contains(QStringLiteral("toPlayer")))
-            DEFAULTREPLY;
-        QJsonValue vtoPlayer = arr.value(QStringLiteral("toPlayer"));
-        if (!vtoPlayer.isString())
-            DEFAULTREPLY;
-        toPlayer = vtoPlayer.toString();
-        break;
-    }
-    default:
-        break;
-    }
-
-    int toPlace = 0;
-    switch (act) {
-    case QMdmmCore::Data::Move:
-    case QMdmmCore::Data::LetMove: {
-        if (!arr.contains(QStringLiteral("toPlace")))
-            DEFAULTREPLY;
-        QJsonValue vtoPlace = arr.value(QStringLiteral("toPlace"));
-        if (!vtoPlace.isDouble())
-            DEFAULTREPLY;
-        toPlace = vtoPlace.toInt();
-        break;
-    }
-    default:
-        break;
+    // The description of ActionReply also checks that the targets needed by the action are present
+    QMdmmCore::Protocol::ReplyPayloadType<QMdmmCore::Protocol::RequestAction> reply;
+    if (!QMdmmCore::Protocol::decodePayload(value, &reply)) {
+        defaultReplyAction();
+        return;
     }
 
-    agent->action(act, toPlayer, toPlace);
-
-#undef DEFAULTREPLY
+    agent->action(reply.action, reply.toPlayer.value_or(QString()), reply.toPlace.value_or(0));
 }
 
 void ServerConnection::decodeUpgradeReply(const QJsonValue &value)
 {
-#define DEFAULTREPLY           \
-    do {                       \
-        defaultReplyUpgrade(); \
-        return;                \
-    } while (0)
-
-    if (!value.isArray())
-        DEFAULTREPLY;
-
-    QJsonArray arr = value.toArray();
-    QList<QMdmmCore::Data::UpgradeItem> ups;
-    for (QJsonArray::const_iterator it = arr.constBegin(); it != arr.constEnd(); ++it) {
-        if (!it->isDouble())
-            DEFAULTREPLY;
-        QMdmmCore::Data::UpgradeItem up = static_cast<QMdmmCore::Data::UpgradeItem>(it->toInt());
-        switch (up) {
-        case QMdmmCore::Data::UpgradeKnife:
-        case QMdmmCore::Data::UpgradeHorse:
-        case QMdmmCore::Data::UpgradeMaxHp:
-            break;
-        default:
-            DEFAULTREPLY;
-        }
-        ups << up;
+    QMdmmCore::Protocol::ReplyPayloadType<QMdmmCore::Protocol::RequestUpgrade> ups;
+    if (!QMdmmCore::Protocol::decodePayload(value, &ups)) {
+        defaultReplyUpgrade();
+        return;
     }
 
     agent->upgrade(ups);
-
-#undef DEFAULTREPLY
 }
 
 void ServerConnection::defaultReplyStoneScissorsCloth()
@@ -327,7 +225,7 @@ void ServerConnection::packetReceived(const QMdmmCore::Packet &packet)
 
     if (packet.type() == QMdmmCore::Protocol::TypeNotify) {
         if ((packet.notifyId() & QMdmmCore::Protocol::NotifyToAgentMask) != 0) {
-            void (ServerConnection::*call)(const QJsonValue &) = notifyCallback.value(packet.notifyId(), nullptr);
+            void (ServerConnection::*call)(const QJsonValue &) = notifyCallback.value(packet.notifyId());
             if (call != nullptr)
                 (this->*call)(packet.value());
             else
@@ -337,7 +235,7 @@ void ServerConnection::packetReceived(const QMdmmCore::Packet &packet)
         if (currentRequest == packet.requestId()) {
             requestTimer->stop();
             currentRequest = QMdmmCore::Protocol::RequestInvalid;
-            void (ServerConnection::*call)(const QJsonValue &) = replyCallback.value(packet.requestId(), nullptr);
+            void (ServerConnection::*call)(const QJsonValue &) = replyCallback.value(packet.requestId());
             if (call != nullptr)
                 (this->*call)(packet.value());
             else
@@ -348,22 +246,19 @@ void ServerConnection::packetReceived(const QMdmmCore::Packet &packet)
 
 void ServerConnection::sendStoneScissorsClothRequested(const QStringList &playerNames, int strivedOrder)
 {
-    QJsonObject ob;
-    ob.insert(QStringLiteral("playerNames"), QJsonArray::fromStringList(playerNames));
-    ob.insert(QStringLiteral("strivedOrder"), strivedOrder);
-    addRequest(QMdmmCore::Protocol::RequestStoneScissorsCloth, ob);
+    QMdmmCore::Protocol::StoneScissorsClothRequest request;
+    request.playerNames = playerNames;
+    request.strivedOrder = strivedOrder;
+    addRequest(QMdmmCore::Protocol::RequestStoneScissorsCloth, QMdmmCore::Protocol::encodePayload(request));
 }
 
 void ServerConnection::sendActionOrderRequested(const QList<int> &remainedOrders, int maximumOrder, int selectionNum)
 {
-    QJsonObject ob;
-    QJsonArray arr;
-    foreach (int remainedOrder, remainedOrders)
-        arr.append(remainedOrder);
-    ob.insert(QStringLiteral("remainedOrders"), arr);
-    ob.insert(QStringLiteral("maximumOrder"), maximumOrder);
-    ob.insert(QStringLiteral("selectionNum"), selectionNum);
-    addRequest(QMdmmCore::Protocol::RequestActionOrder, ob);
+    QMdmmCore::Protocol::ActionOrderRequest request;
+    request.remainedOrders = remainedOrders;
+    request.maximumOrder = maximumOrder;
+    request.selectionNum = selectionNum;
+    addRequest(QMdmmCore::Protocol::RequestActionOrder, QMdmmCore::Protocol::encodePayload(request));
 }
 
 void ServerConnection::sendActionRequested(int currentOrder)
@@ -381,71 +276,65 @@ void ServerConnection::sendLogicConfigurationNotified()
     emit sendPacket(QMdmmCore::Packet(QMdmmCore::Protocol::NotifyLogicConfiguration, conf));
 }
 
-void ServerConnection::sendAgentStateChangeNotified(const QString &playerName, const QMdmmCore::Data::AgentState &agentState)
+QMdmmCore::Packet ServerConnection::agentStateChangeNotifyPacket(const QString &playerName, const QMdmmCore::Data::AgentState &agentState)
 {
-    QJsonObject ob;
-    ob.insert(QStringLiteral("playerName"), playerName);
-    ob.insert(QStringLiteral("agentState"), static_cast<int>(QMdmmCore::Data::AgentState::Int(agentState)));
-    emit sendPacket(QMdmmCore::Packet(QMdmmCore::Protocol::NotifyAgentStateChanged, ob));
+    QMdmmCore::Protocol::AgentStateChangedNotify notify;
+    notify.playerName = playerName;
+    notify.agentState = agentState;
+    return QMdmmCore::Protocol::notifyPacket<QMdmmCore::Protocol::NotifyAgentStateChanged>(notify);
 }
 
-void ServerConnection::sendPlayerAddNotified(const QString &playerName, const QString &screenName, const QMdmmCore::Data::AgentState &agentState)
+QMdmmCore::Packet ServerConnection::playerAddNotifyPacket(const QString &playerName, const QString &screenName, const QMdmmCore::Data::AgentState &agentState)
 {
-    QJsonObject ob;
-    ob.insert(QStringLiteral("playerName"), playerName);
-    ob.insert(QStringLiteral("screenName"), screenName);
-    ob.insert(QStringLiteral("agentState"), static_cast<int>(QMdmmCore::Data::AgentState::Int(agentState)));
-    emit sendPacket(QMdmmCore::Packet(QMdmmCore::Protocol::NotifyPlayerAdded, ob));
+    QMdmmCore::Protocol::PlayerAddedNotify notify;
+    notify.playerName = playerName;
+    notify.screenName = screenName;
+    notify.agentState = agentState;
+    return QMdmmCore::Protocol::notifyPacket<QMdmmCore::Protocol::NotifyPlayerAdded>(notify);
 }
 
-void ServerConnection::sendPlayerRemoveNotified(const QString &playerName)
+QMdmmCore::Packet ServerConnection::playerRemoveNotifyPacket(const QString &playerName)
 {
-    QJsonObject ob;
-    ob.insert(QStringLiteral("playerName"), playerName);
-    emit sendPacket(QMdmmCore::Packet(QMdmmCore::Protocol::NotifyPlayerRemoved, ob));
+    QMdmmCore::Protocol::PlayerRemovedNotify notify;
+    notify.playerName = playerName;
+    return QMdmmCore::Protocol::notifyPacket<QMdmmCore::Protocol::NotifyPlayerRemoved>(notify);
 }
 
-void ServerConnection::sendGameStartNotified()
+QMdmmCore::Packet ServerConnection::gameStartNotifyPacket()
 {
-    emit sendPacket(QMdmmCore::Packet(QMdmmCore::Protocol::NotifyGameStart, {}));
+    return QMdmmCore::Protocol::notifyPacket<QMdmmCore::Protocol::NotifyGameStart>({});
 }
 
-void ServerConnection::sendRoundStartNotified()
+QMdmmCore::Packet ServerConnection::roundStartNotifyPacket()
 {
-    emit sendPacket(QMdmmCore::Packet(QMdmmCore::Protocol::NotifyRoundStart, {}));
+    return QMdmmCore::Protocol::notifyPacket<QMdmmCore::Protocol::NotifyRoundStart>({});
 }
 
-void ServerConnection::sendStoneScissorsClothNotified(const QHash<QString, QMdmmCore::Data::StoneScissorsCloth> &replies)
+QMdmmCore::Packet ServerConnection::stoneScissorsClothNotifyPacket(const QHash<QString, QMdmmCore::Data::StoneScissorsCloth> &replies)
 {
-    QJsonObject ob;
-    for (QHash<QString, QMdmmCore::Data::StoneScissorsCloth>::const_iterator it = replies.constBegin(); it != replies.constEnd(); ++it)
-        ob.insert(it.key(), static_cast<int>(it.value()));
-    QMdmmCore::Packet packet(QMdmmCore::Protocol::NotifyStoneScissorsCloth, ob);
-    roundEventLog.append(packet);
-    emit sendPacket(packet);
+    return QMdmmCore::Protocol::notifyPacket<QMdmmCore::Protocol::NotifyStoneScissorsCloth>(replies);
 }
 
-void ServerConnection::sendActionOrderNotified(const QHash<int, QString> &result)
+QMdmmCore::Packet ServerConnection::actionOrderNotifyPacket(const QHash<int, QString> &result)
 {
-    QJsonArray arr;
+    QStringList playerNames;
+    playerNames.reserve(result.count());
     for (int i = 1; i <= result.count(); ++i)
-        arr.append(result.value(i));
-    QMdmmCore::Packet packet(QMdmmCore::Protocol::NotifyActionOrder, arr);
-    roundEventLog.append(packet);
-    emit sendPacket(packet);
+        playerNames.append(result.value(i));
+    return QMdmmCore::Protocol::notifyPacket<QMdmmCore::Protocol::NotifyActionOrder>(playerNames);
 }
 
-void ServerConnection::sendActionNotified(const QString &playerName, QMdmmCore::Data::Action action, const QString &toPlayer, int toPlace)
+QMdmmCore::Packet ServerConnection::actionNotifyPacket(const QString &playerName, QMdmmCore::Data::Action action, const QString &toPlayer, int toPlace)
 {
-    QJsonObject ob;
-    ob.insert(QStringLiteral("playerName"), playerName);
-    ob.insert(QStringLiteral("action"), static_cast<int>(action));
+    QMdmmCore::Protocol::ActionNotify notify;
+    notify.playerName = playerName;
+    notify.action = action;
 
     switch (action) {
     case QMdmmCore::Data::Slash:
     case QMdmmCore::Data::Kick:
     case QMdmmCore::Data::LetMove:
-        ob.insert(QStringLiteral("toPlayer"), toPlayer);
+        notify.toPlayer = toPlayer;
         break;
     default:
         break;
@@ -454,75 +343,137 @@ void ServerConnection::sendActionNotified(const QString &playerName, QMdmmCore::
     switch (action) {
     case QMdmmCore::Data::Move:
     case QMdmmCore::Data::LetMove:
-        ob.insert(QStringLiteral("toPlace"), toPlace);
+        notify.toPlace = toPlace;
         break;
     default:
         break;
     }
 
-    QMdmmCore::Packet packet(QMdmmCore::Protocol::NotifyAction, ob);
-    roundEventLog.append(packet);
-    emit sendPacket(packet);
+    return QMdmmCore::Protocol::notifyPacket<QMdmmCore::Protocol::NotifyAction>(notify);
 }
 
-void ServerConnection::sendRoundOverNotified()
+QMdmmCore::Packet ServerConnection::roundOverNotifyPacket()
 {
-    emit sendPacket(QMdmmCore::Packet(QMdmmCore::Protocol::NotifyRoundOver, {}));
+    return QMdmmCore::Protocol::notifyPacket<QMdmmCore::Protocol::NotifyRoundOver>({});
 }
 
-void ServerConnection::sendUpgradeNotified(const QHash<QString, QList<QMdmmCore::Data::UpgradeItem>> &upgrades)
+QMdmmCore::Packet ServerConnection::upgradeNotifyPacket(const QHash<QString, QList<QMdmmCore::Data::UpgradeItem>> &upgrades)
+{
+    return QMdmmCore::Protocol::notifyPacket<QMdmmCore::Protocol::NotifyUpgrade>(upgrades);
+}
+
+QMdmmCore::Packet ServerConnection::gameOverNotifyPacket(const QStringList &playerNames)
+{
+    return QMdmmCore::Protocol::notifyPacket<QMdmmCore::Protocol::NotifyGameOver>(playerNames);
+}
+
+QMdmmCore::Packet ServerConnection::speakNotifyPacket(const QString &playerName, const QString &content)
+{
+    QMdmmCore::Protocol::SpokenNotify notify;
+    notify.playerName = playerName;
+    notify.content = content;
+    return QMdmmCore::Protocol::notifyPacket<QMdmmCore::Protocol::NotifySpoken>(notify);
+}
+
+QMdmmCore::Packet ServerConnection::roomSnapshotNotifyPacket(const QMdmmCore::Protocol::RoomSnapshotNotify &snapshot)
+{
+    return QMdmmCore::Protocol::notifyPacket<QMdmmCore::Protocol::NotifyRoomSnapshot>(snapshot);
+}
+
+void ServerConnection::sendNotifyPacket(const QMdmmCore::Packet &packet)
+{
+    if (snapshotPending)
+        deferredPackets.append(packet);
+    else
+        emit sendPacket(packet);
+}
+
+void ServerConnection::sendRoomStatePacket(const QMdmmCore::Packet &packet)
+{
+    if (!snapshotPending)
+        emit sendPacket(packet);
+}
+
+void ServerConnection::sendRoomSnapshot(const QMdmmCore::Packet &packet)
 {
-    QJsonObject ob;
-    for (QHash<QString, QList<QMdmmCore::Data::UpgradeItem>>::const_iterator it = upgrades.constBegin(); it != upgrades.constEnd(); ++it) {
-        QJsonArray arr;
-        foreach (QMdmmCore::Data::UpgradeItem up, it.value())
-            arr.append(static_cast<int>(up));
-        ob.insert(it.key(), arr);
-    }
-    QMdmmCore::Packet packet(QMdmmCore::Protocol::NotifyUpgrade, ob);
-    roundEventLog.append(packet);
     emit sendPacket(packet);
+
+    snapshotPending = false;
+    foreach (const QMdmmCore::Packet &deferred, deferredPackets)
+        emit sendPacket(deferred);
+    deferredPackets.clear();
 }
 
-void ServerConnection::clearRoundEventLog()
+void ServerConnection::sendAgentStateChangeNotified(const QString &playerName, const QMdmmCore::Data::AgentState &agentState)
+{
+    sendRoomStatePacket(agentStateChangeNotifyPacket(playerName, agentState));
+}
+
+void ServerConnection::sendPlayerAddNotified(const QString &playerName, const QString &screenName, const QMdmmCore::Data::AgentState &agentState)
 {
-    roundEventLog.clear();
+    sendNotifyPacket(playerAddNotifyPacket(playerName, screenName, agentState));
 }
 
-void ServerConnection::replayMissedRoundEvents(int lastRoundEventSeq)
+void ServerConnection::sendPlayerRemoveNotified(const QString &playerName)
+{
+    sendNotifyPacket(playerRemoveNotifyPacket(playerName));
+}
+
+void ServerConnection::sendGameStartNotified()
 {
-    // roundEventLog is ordered by send order, and its index IS the round-event sequence number
-    // (see roundEventLog in qmdmmlogicrunner_p.h), which equals the client's received-event
-    // counter. Replaying in-place needs no sorting: skip the first `lastRoundEventSeq` events the
-    // client already got and re-send the rest, in order.
-    for (int i = lastRoundEventSeq; i < roundEventLog.size(); ++i)
-        emit sendPacket(roundEventLog.at(i));
+    sendNotifyPacket(gameStartNotifyPacket());
 }
 
-void ServerConnection::reconnect(Socket *socket, int lastRoundEventSeq)
+void ServerConnection::sendRoundStartNotified()
+{
+    sendNotifyPacket(roundStartNotifyPacket());
+}
+
+void ServerConnection::sendStoneScissorsClothNotified(const QHash<QString, QMdmmCore::Data::StoneScissorsCloth> &replies)
+{
+    sendRoomStatePacket(stoneScissorsClothNotifyPacket(replies));
+}
+
+void ServerConnection::sendActionOrderNotified(const QHash<int, QString> &result)
+{
+    sendRoomStatePacket(actionOrderNotifyPacket(result));
+}
+
+void ServerConnection::sendActionNotified(const QString &playerName, QMdmmCore::Data::Action action, const QString &toPlayer, int toPlace)
+{
+    sendRoomStatePacket(actionNotifyPacket(playerName, action, toPlayer, toPlace));
+}
+
+void ServerConnection::sendRoundOverNotified()
+{
+    sendRoomStatePacket(roundOverNotifyPacket());
+}
+
+void ServerConnection::sendUpgradeNotified(const QHash<QString, QList<QMdmmCore::Data::UpgradeItem>> &upgrades)
+{
+    sendRoomStatePacket(upgradeNotifyPacket(upgrades));
+}
+
+void ServerConnection::reconnect(Socket *socket)
 {
     // Rebind the socket. setSocket is safe because onSocketDisconnected already set the old
     // socket to nullptr before this point, so nothing gets double-deleted.
     setSocket(socket);
 
-    // Precise catch-up: replay the round events the client missed. The client reported how many
-    // round events it received before the drop (lastRoundEventSeq); every event this connection
-    // broadcast while the client was gone is replayed in send order, skipping the first
-    // `lastRoundEventSeq` (already received). See replayMissedRoundEvents.
-    replayMissedRoundEvents(lastRoundEventSeq);
+    // The client rebuilds its room from the room snapshot, whose cost only depends on the number
+    // of players. Nothing which happened while it was gone is replayed.
+    snapshotPending = true;
+    deferredPackets.clear();
 }
 
 void ServerConnection::sendGameOverNotified(const QStringList &playerNames)
 {
-    emit sendPacket(QMdmmCore::Packet(QMdmmCore::Protocol::NotifyGameOver, QJsonArray::fromStringList(playerNames)));
+    sendNotifyPacket(gameOverNotifyPacket(playerNames));
 }
 
 void ServerConnection::sendSpeakNotified(const QString &playerName, const QString &content)
 {
-    QJsonObject ob;
-    ob.insert(QStringLiteral("playerName"), playerName);
-    ob.insert(QStringLiteral("content"), content);
-    emit sendPacket(QMdmmCore::Packet(QMdmmCore::Protocol::NotifySpoken, ob));
+    sendNotifyPacket(speakNotifyPacket(playerName, content));
 }
 
 void ServerConnection::sendOperateNotified(const QString &playerName, const QJsonValue &todo)
@@ -542,7 +493,7 @@ void ServerConnection::requestTimeout()
 void ServerConnection::executeDefaultReply()
 {
     if (currentRequest != QMdmmCore::Protocol::RequestInvalid) {
-        void (ServerConnection::*call)() = defaultReplyCallback.value(currentRequest, nullptr);
+        void (ServerConnection::*call)() = defaultReplyCallback.value(currentRequest);
         currentRequest = QMdmmCore::Protocol::RequestInvalid;
         if (call != nullptr)
             (this->*call)();
@@ -553,7 +504,11 @@ void ServerConnection::receiveSpeak(const QJsonValue &value)
 {
     // The value is the Base64-encoded content sent by Client::notifySpeak. The server forwards it
     // verbatim (it does not decode); the receiving client decodes it in ClientP::notifySpoken.
-    agent->speak(value.toString());
+    QMdmmCore::Protocol::NotifyPayloadType<QMdmmCore::Protocol::NotifySpeak> content;
+    if (!QMdmmCore::Protocol::decodePayload(value, &content))
+        return;
+
+    agent->speak(content);
 }
 
 void ServerConnection::receiveOperate(const QJsonValue &value)
@@ -561,16 +516,145 @@ void ServerConnection::receiveOperate(const QJsonValue &value)
     agent->operate(value);
 }
 
+std::shared_ptr<LogicWorkerPool> LogicWorkerPool::instance()
+{
+    static QMutex lock;
+    static std::weak_ptr<LogicWorkerPool> current;
+
+    QMutexLocker locker(&lock);
+    std::shared_ptr<LogicWorkerPool> pool = current.lock();
+    if (pool == nullptr) {
+        pool = std::shared_ptr<LogicWorkerPool>(new LogicWorkerPool);
+        current = pool;
+    }
+
+    return pool;
+}
+
+LogicWorkerPool::LogicWorkerPool()
+    : maximumWorkerCount(std::max(QThread::idealThreadCount(), 1))
+{
+}
+
+LogicWorkerPool::~LogicWorkerPool()
+{
+    // The last room is usually deleted on the server thread, which must not wait for the workers. A worker finishes on its
+    // own, deleting the logics deleted by deleteLater after their rooms are gone, and then deletes itself
+    foreach (const Worker &worker, workers)
+        worker.thread->quit();
+}
+
+QThread *LogicWorkerPool::acquire()
+{
+    QMutexLocker locker(&mutex);
+
+    Worker *leastLoaded = nullptr;
+    for (Worker &worker : workers) {
+        if (leastLoaded == nullptr || worker.rooms < leastLoaded->rooms)
+            leastLoaded = &worker;
+    }
+
+    if (leastLoaded == nullptr || (leastLoaded->rooms > 0 && workers.size() < maximumWorkerCount)) {
+        auto *thread = new QThread;
+        thread->setObjectName(QStringLiteral("QMdmm logic worker %1").arg(workers.size()));
+        QObject::connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+        thread->start();
+        workers.append(Worker {thread, 0});
+        leastLoaded = &workers.last();
+    }
+
+    ++leastLoaded->rooms;
+    return leastLoaded->thread;
+}
+
+void LogicWorkerPool::release(QThread *worker)
+{
+    QMutexLocker locker(&mutex);
+
+    for (Worker &w : workers) {
+        if (w.thread == worker) {
+            --w.rooms;
+            break;
+        }
+    }
+}
+
+int LogicWorkerPool::workerCount()
+{
+    QMutexLocker locker(&mutex);
+    return workers.size();
+}
+
+void LogicWorkerPool::drain()
+{
+    // A worker still running rooms, such as those of another server in the process, is left alone
+    QList<QThread *> idle;
+    {
+        QMutexLocker locker(&mutex);
+        workers.removeIf([&idle](const Worker &worker) -> bool {
+            if (worker.rooms > 0)
+                return false;
+            idle.append(worker.thread);
+            return true;
+        });
+    }
+
+    // A finished thread deletes the objects deleted by deleteLater in it, which are the logics of the deleted rooms
+    foreach (QThread *thread, idle) {
+        QObject::disconnect(thread, &QThread::finished, thread, &QObject::deleteLater);
+        thread->quit();
+        thread->wait();
+        delete thread;
+    }
+}
+
 LogicRunnerP::LogicRunnerP(QMdmmCore::LogicConfiguration logicConfiguration, LogicRunner *q)
     : QObject(q)
     , q(q)
+    , workerPool(LogicWorkerPool::instance())
     , conf(std::move(logicConfiguration))
+    , journalCommitPending(false)
+    , journalSnapshotOffset(-1)
+    , recoveredRoundStart(false)
+{
+    logicThread = workerPool->acquire();
+    createLogic();
+
+    // The inputs of the logic are recorded as they are emitted to it
+    connect(this, &LogicRunnerP::addPlayer, this, [this](const QString &playerName) {
+        const Agent *agent = agents.value(playerName);
+        record(QCborArray {RoomJournal::RecordPlayerAdded, playerName, agent->screenName(), static_cast<int>(agent->state().toInt())});
+    });
+    connect(this, &LogicRunnerP::removePlayer, this, [this](const QString &playerName) {
+        record(QCborArray {RoomJournal::RecordPlayerRemoved, playerName});
+    });
+    connect(this, &LogicRunnerP::roundStart, this, [this]() {
+        record(QCborArray {RoomJournal::RecordRoundStart});
+    });
+    connect(this, &LogicRunnerP::sscReply, this, [this](const QString &playerName, QMdmmCore::Data::StoneScissorsCloth ssc) {
+        record(QCborArray {RoomJournal::RecordSscReply, playerName, static_cast<int>(ssc)});
+    });
+    connect(this, &LogicRunnerP::actionOrderReply, this, [this](const QString &playerName, const QList<int> &desiredOrder) {
+        QCborArray orders;
+        foreach (int order, desiredOrder)
+            orders.append(order);
+        record(QCborArray {RoomJournal::RecordActionOrderReply, playerName, orders});
+    });
+    connect(this, &LogicRunnerP::actionReply, this, [this](const QString &playerName, QMdmmCore::Data::Action action, const QString &toPlayer, int toPlace) {
+        record(QCborArray {RoomJournal::RecordActionReply, playerName, static_cast<int>(action), toPlayer, toPlace});
+    });
+    connect(this, &LogicRunnerP::upgradeReply, this, [this](const QString &playerName, const QList<QMdmmCore::Data::UpgradeItem> &items) {
+        QCborArray upgrades;
+        foreach (QMdmmCore::Data::UpgradeItem item, items)
+            upgrades.append(static_cast<int>(item));
+        record(QCborArray {RoomJournal::RecordUpgradeReply, playerName, upgrades});
+    });
+}
+
+void LogicRunnerP::createLogic()
 {
-    logicThread = new QThread(this);
     logic = new QMdmmCore::Logic(conf);
     logic->moveToThread(logicThread);
-    connect(logicThread, &QThread::finished, logic, &QMdmmCore::Logic::deleteLater);
-    logicThread->start();
 
 #define CONNECTRUNNERTOLOGIC(signalName) connect(this, &LogicRunnerP::signalName, logic, &QMdmmCore::Logic::signalName, Qt::QueuedConnection)
 
@@ -581,9 +665,15 @@ LogicRunnerP::LogicRunnerP(QMdmmCore::LogicConfiguration logicConfiguration, Log
     CONNECTRUNNERTOLOGIC(actionOrderReply);
     CONNECTRUNNERTOLOGIC(actionReply);
     CONNECTRUNNERTOLOGIC(upgradeReply);
+    CONNECTRUNNERTOLOGIC(snapshot);
 
 #undef CONNECTRUNNERTOLOGIC
 
+    connectLogicResults();
+}
+
+void LogicRunnerP::connectLogicResults()
+{
 #define CONNECTLOGICTORUNNER(signalName) connect(logic, &QMdmmCore::Logic::signalName, this, &LogicRunnerP::signalName, Qt::QueuedConnection)
 
     CONNECTLOGICTORUNNER(requestSscForAction);
@@ -597,6 +687,7 @@ LogicRunnerP::LogicRunnerP(QMdmmCore::LogicConfiguration logicConfiguration, Log
     CONNECTLOGICTORUNNER(upgradeResult);
     CONNECTLOGICTORUNNER(roundOver);
     CONNECTLOGICTORUNNER(gameOver);
+    CONNECTLOGICTORUNNER(snapshotResult);
 
 #undef CONNECTLOGICTORUNNER
 }
@@ -607,8 +698,9 @@ void LogicRunnerP::agentStateChanged(const QMdmmCore::Data::AgentState &state)
     if (changedAgent == nullptr)
         return;
 
-    foreach (Agent *agent, agents)
+    broadcast(ServerConnection::agentStateChangeNotifyPacket(changedAgent->objectName(), state), true, [changedAgent, &state](Agent *agent) {
         agent->notifyAgentStateChange(changedAgent->objectName(), state);
+    });
 }
 
 void LogicRunnerP::agentSpoken(const QString &content)
@@ -618,8 +710,9 @@ void LogicRunnerP::agentSpoken(const QString &content)
         return;
 
     if (!content.isEmpty()) {
-        foreach (Agent *agent, agents)
+        broadcast(ServerConnection::speakNotifyPacket(speakAgent->objectName(), content), false, [speakAgent, &content](Agent *agent) {
             agent->notifySpeak(speakAgent->objectName(), content);
+        });
     }
 }
 
@@ -692,7 +785,7 @@ void LogicRunnerP::agentDisconnected(Agent *disconnectedAgent)
         }
 
         if (allDisconnected)
-            emit q->gameOver(LogicRunner::QPrivateSignal());
+            finishGame();
     } else {
         // case 2: room is not full, so game hasn't started
         // Agent should be deleted.
@@ -703,8 +796,9 @@ void LogicRunnerP::agentDisconnected(Agent *disconnectedAgent)
         Q_ASSERT(takenAgent == disconnectedAgent);
         Q_ASSERT(takenConn != nullptr);
 
-        foreach (Agent *agent, agents)
+        broadcast(ServerConnection::playerRemoveNotifyPacket(playerName), false, [&playerName](Agent *agent) {
             agent->notifyPlayerRemove(playerName);
+        });
         emit removePlayer(playerName);
 
         disconnectedAgent->deleteLater();
@@ -714,14 +808,294 @@ void LogicRunnerP::agentDisconnected(Agent *disconnectedAgent)
 
 LogicRunnerP::~LogicRunnerP()
 {
-    // The logic lives in logicThread. Tear it down cleanly so the thread is no
-    // longer running when this object (and thus logicThread, its child) is
-    // destroyed -- otherwise Qt's QThread destructor hits
-    // qFatal("QThread: Destroyed while thread ... is still running") and aborts.
+    // The logic lives in a worker shared with other rooms, which keeps running. The logic is deleted there, and the
+    // results it may still emit meanwhile are dropped along with the queued connections to this object.
     if (logic)
         logic->deleteLater();
-    logicThread->quit();
-    logicThread->wait();
+    workerPool->release(logicThread);
+}
+
+void LogicRunnerP::record(const QCborArray &record)
+{
+    if (journal == nullptr)
+        return;
+
+    journal->append(record);
+
+    // Group commit: the records of one event loop iteration are written back together
+    if (!journalCommitPending) {
+        journalCommitPending = true;
+        QMetaObject::invokeMethod(this, &LogicRunnerP::commitJournal, Qt::QueuedConnection);
+    }
+}
+
+void LogicRunnerP::commitJournal()
+{
+    journalCommitPending = false;
+    if (journal != nullptr)
+        journal->commit();
+}
+
+QCborArray LogicRunnerP::configurationRecord() const
+{
+    return QCborArray {RoomJournal::RecordConfiguration, QCborMap::fromJsonObject(conf)};
+}
+
+QCborArray LogicRunnerP::snapshotRecord(const QMdmmCore::Protocol::RoomSnapshotNotify &snapshot) const
+{
+    return QCborArray {RoomJournal::RecordSnapshot, QCborValue::fromJsonValue(QMdmmCore::Protocol::encodePayload(snapshot))};
+}
+
+void LogicRunnerP::fillIdentities(QMdmmCore::Protocol::RoomSnapshotNotify *snapshot) const
+{
+    // The identity and the online state of players are kept by agents on this thread
+    for (QMdmmCore::Protocol::PlayerSnapshot &player : snapshot->players) {
+        if (const Agent *agent = agents.value(player.playerName, nullptr); agent != nullptr) {
+            player.screenName = agent->screenName();
+            player.agentState = agent->state();
+        }
+    }
+}
+
+void LogicRunnerP::finishGame()
+{
+    if (journal != nullptr) {
+        journal->remove();
+        journal.reset();
+    }
+    recoveredRequests.clear();
+    recoveredRoundStart = false;
+
+    emit q->gameOver(LogicRunner::QPrivateSignal());
+}
+
+void LogicRunnerP::addRecoveredAgent(const QString &playerName, const QString &screenName, QMdmmCore::Data::AgentState state)
+{
+    auto *agent = new Agent(playerName, q);
+    agent->setScreenName(screenName);
+    // Nobody is connected to a recovered room, the players come back by reconnecting
+    state.setFlag(QMdmmCore::Data::StateMaskOnline, false).setFlag(QMdmmCore::Data::StateMaskTrust, false);
+    agent->setState(state);
+    new ServerConnection(agent, conf, agent);
+
+    // The logic is rebuilt by replaying, nothing is emitted to it
+    blockSignals(true);
+    q->addAgent(agent);
+    blockSignals(false);
+}
+
+bool LogicRunnerP::replay(const QList<QCborArray> &records)
+{
+    // The agents are rebuilt on this thread. A game which has not started is not recovered, its players have not lost
+    // anything but their seats
+    bool started = false;
+    foreach (const QCborArray &record, records) {
+        const QString playerName = record.at(1).toString();
+        switch (record.at(0).toInteger()) {
+        case RoomJournal::RecordSnapshot: {
+            QMdmmCore::Protocol::RoomSnapshotNotify snapshot;
+            if (!QMdmmCore::Protocol::decodePayload(record.at(1).toJsonValue(), &snapshot))
+                return false;
+            foreach (const QMdmmCore::Protocol::PlayerSnapshot &player, snapshot.players)
+                addRecoveredAgent(player.playerName, player.screenName, player.agentState);
+            started = true;
+            break;
+        }
+        case RoomJournal::RecordPlayerAdded:
+            addRecoveredAgent(playerName, record.at(2).toString(),
+                              QMdmmCore::Data::AgentState(static_cast<QMdmmCore::Data::AgentState::Int>(record.at(3).toInteger())));
+            break;
+        case RoomJournal::RecordPlayerRemoved:
+            connections.remove(playerName);
+            delete agents.take(playerName);
+            break;
+        case RoomJournal::RecordRoundStart:
+            started = true;
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (!started)
+        return false;
+
+    // The results of the logic while replaying are carried by the replay, they are not posted to this room. The logic
+    // only emits them once the replay runs on its worker, since it is queued before anything else is posted to it
+    disconnect(logic, nullptr, this, nullptr);
+
+    auto *job = new LogicReplay(logic, records, this);
+    job->moveToThread(logicThread);
+    replayConnection = connect(job, &LogicReplay::finished, this, &LogicRunnerP::replayFinished, Qt::QueuedConnection);
+    QMetaObject::invokeMethod(job, &LogicReplay::run, Qt::QueuedConnection);
+    return true;
+}
+
+void LogicRunnerP::replayFinished(bool replayed, const QHash<QString, std::function<void()>> &pending, bool roundStartDue)
+{
+    replayConnection = {};
+    connectLogicResults();
+
+    if (!replayed) {
+        qWarning("A recovered room can't be replayed or its game is over, the game is dropped");
+        finishGame();
+        return;
+    }
+
+    recoveredRequests = pending;
+    recoveredRoundStart = roundStartDue;
+
+    // The snapshot of a player who reconnected while replaying was taken without being posted back, so it is taken again
+    foreach (const Agent *agent, agents) {
+        if (agent->state().testFlag(QMdmmCore::Data::StateMaskOnline))
+            emit snapshot(agent->objectName());
+    }
+
+    QTimer::singleShot(conf.requestTimeout(), this, &LogicRunnerP::askRecoveredRequests);
+}
+
+LogicReplay::LogicReplay(QMdmmCore::Logic *logic, QList<QCborArray> records, LogicRunnerP *runner)
+    : logic(logic)
+    , records(std::move(records))
+    , runner(runner)
+{
+}
+
+void LogicReplay::run()
+{
+    // The logic of a room is deleted after the jobs posted before its deletion, unless the worker pool is drained
+    if (logic.isNull()) {
+        emit finished(false, {}, false);
+        deleteLater();
+        return;
+    }
+
+    // The logic is rebuilt here, where its requests are watched to find the ones left unanswered: a request is answered
+    // by the next reply of its player
+    bool replayed = true;
+    bool over = false;
+    bool roundStartDue = false;
+    QHash<QString, std::function<void()>> pending;
+
+    {
+        QObject watcher;
+        connect(logic, &QMdmmCore::Logic::requestSscForAction, &watcher, [this, &pending](const QStringList &playerNames) {
+            foreach (const QString &playerName, playerNames)
+                pending.insert(playerName, [runner = runner, playerName, playerNames]() { runner->agents.value(playerName)->requestStoneScissorsCloth(playerNames, 0); });
+        });
+        connect(logic, &QMdmmCore::Logic::requestSscForActionOrder, &watcher, [this, &pending](const QStringList &playerNames, int strivedOrder) {
+            foreach (const QString &playerName, playerNames) {
+                pending.insert(playerName, [runner = runner, playerName, playerNames, strivedOrder]() {
+                    runner->agents.value(playerName)->requestStoneScissorsCloth(playerNames, strivedOrder);
+                });
+            }
+        });
+        connect(logic, &QMdmmCore::Logic::requestActionOrder, &watcher,
+                [this, &pending](const QString &playerName, const QList<int> &availableOrders, int maximumOrderNum, int selections) {
+                    pending.insert(playerName, [runner = runner, playerName, availableOrders, maximumOrderNum, selections]() {
+                        runner->agents.value(playerName)->requestActionOrder(availableOrders, maximumOrderNum, selections);
+                    });
+                });
+        connect(logic, &QMdmmCore::Logic::requestAction, &watcher, [this, &pending](const QString &playerName, int actionOrder) {
+            pending.insert(playerName, [runner = runner, playerName, actionOrder]() { runner->agents.value(playerName)->requestAction(actionOrder); });
+        });
+        connect(logic, &QMdmmCore::Logic::requestUpgrade, &watcher, [this, &pending](const QString &playerName, int upgradePoint) {
+            pending.insert(playerName, [runner = runner, playerName, upgradePoint]() { runner->agents.value(playerName)->requestUpgrade(upgradePoint); });
+        });
+        connect(logic, &QMdmmCore::Logic::upgradeResult, &watcher, [&roundStartDue]() {
+            roundStartDue = true;
+        });
+        connect(logic, &QMdmmCore::Logic::gameOver, &watcher, [&over]() {
+            over = true;
+        });
+
+        foreach (const QCborArray &record, records) {
+            const QString playerName = record.at(1).toString();
+            switch (record.at(0).toInteger()) {
+            case RoomJournal::RecordSnapshot: {
+                QMdmmCore::Protocol::RoomSnapshotNotify snapshot;
+                replayed = QMdmmCore::Protocol::decodePayload(record.at(1).toJsonValue(), &snapshot) && logic->restore(snapshot) && replayed;
+                // Taken between rounds
+                roundStartDue = true;
+                break;
+            }
+            case RoomJournal::RecordPlayerAdded:
+                logic->addPlayer(playerName);
+                break;
+            case RoomJournal::RecordPlayerRemoved:
+                logic->removePlayer(playerName);
+                break;
+            case RoomJournal::RecordRoundStart:
+                roundStartDue = false;
+                logic->roundStart();
+                break;
+            case RoomJournal::RecordSscReply:
+                pending.remove(playerName);
+                logic->sscReply(playerName, static_cast<QMdmmCore::Data::StoneScissorsCloth>(record.at(2).toInteger()));
+                break;
+            case RoomJournal::RecordActionOrderReply: {
+                QList<int> desiredOrder;
+                foreach (const QCborValue &order, record.at(2).toArray())
+                    desiredOrder << static_cast<int>(order.toInteger());
+                pending.remove(playerName);
+                logic->actionOrderReply(playerName, desiredOrder);
+                break;
+            }
+            case RoomJournal::RecordActionReply:
+                pending.remove(playerName);
+                logic->actionReply(playerName, static_cast<QMdmmCore::Data::Action>(record.at(2).toInteger()), record.at(3).toString(),
+                                   static_cast<int>(record.at(4).toInteger()));
+                break;
+            case RoomJournal::RecordUpgradeReply: {
+                QList<QMdmmCore::Data::UpgradeItem> items;
+                foreach (const QCborValue &item, record.at(2).toArray())
+                    items << static_cast<QMdmmCore::Data::UpgradeItem>(item.toInteger());
+                pending.remove(playerName);
+                logic->upgradeReply(playerName, items);
+                break;
+            }
+            default:
+                break;
+            }
+        }
+    }
+
+    emit finished(replayed && !over, pending, roundStartDue);
+    deleteLater();
+}
+
+void LogicRunnerP::askRecoveredRequest(const QString &playerName)
+{
+    if (std::function<void()> request = recoveredRequests.take(playerName); request)
+        request();
+
+    // The next round starts once every player is back, or after the request timeout
+    if (recoveredRoundStart && std::all_of(agents.cbegin(), agents.cend(), [](const Agent *agent) -> bool {
+            return agent->state().testFlag(QMdmmCore::Data::StateMaskOnline);
+        }))
+        startRecoveredRound();
+}
+
+void LogicRunnerP::askRecoveredRequests()
+{
+    QHash<QString, std::function<void()>> requests;
+    requests.swap(recoveredRequests);
+    foreach (const std::function<void()> &request, requests)
+        request();
+
+    if (recoveredRoundStart)
+        startRecoveredRound();
+}
+
+void LogicRunnerP::startRecoveredRound()
+{
+    recoveredRoundStart = false;
+
+    broadcast(ServerConnection::roundStartNotifyPacket(), false, [](Agent *agent) {
+        agent->notifyRoundStart();
+    });
+
+    emit roundStart();
 }
 
 // NOLINTNEXTLINE(readability-make-member-function-const)
@@ -736,10 +1110,9 @@ void LogicRunnerP::requestSscForAction(const QStringList &playerNames)
 // NOLINTNEXTLINE(readability-make-member-function-const)
 void LogicRunnerP::sscResult(const QHash<QString, QMdmmCore::Data::StoneScissorsCloth> &replies)
 {
-    // Each agent records the round event it broadcasts in its connection's roundEventLog (see
-    // ServerConnection::sendStoneScissorsClothNotified), for the per-agent reconnect catch-up.
-    foreach (Agent *agent, agents)
+    broadcast(ServerConnection::stoneScissorsClothNotifyPacket(replies), true, [&replies](Agent *agent) {
         agent->notifyStoneScissorsCloth(replies);
+    });
 }
 
 // NOLINTNEXTLINE(readability-make-member-function-const)
@@ -752,8 +1125,9 @@ void LogicRunnerP::requestActionOrder(const QString &playerName, const QList<int
 // NOLINTNEXTLINE(readability-make-member-function-const)
 void LogicRunnerP::actionOrderResult(const QHash<int, QString> &result)
 {
-    foreach (Agent *agent, agents)
+    broadcast(ServerConnection::actionOrderNotifyPacket(result), true, [&result](Agent *agent) {
         agent->notifyActionOrder(result);
+    });
 }
 
 // NOLINTNEXTLINE(readability-make-member-function-const)
@@ -775,8 +1149,9 @@ void LogicRunnerP::requestAction(const QString &playerName, int actionOrder)
 // NOLINTNEXTLINE(readability-make-member-function-const)
 void LogicRunnerP::actionResult(const QString &playerName, QMdmmCore::Data::Action action, const QString &toPlayer, int toPlace)
 {
-    foreach (Agent *agent, agents)
+    broadcast(ServerConnection::actionNotifyPacket(playerName, action, toPlayer, toPlace), true, [&](Agent *agent) {
         agent->notifyAction(playerName, action, toPlayer, toPlace);
+    });
 }
 
 // NOLINTNEXTLINE(readability-make-member-function-const)
@@ -802,45 +1177,68 @@ void LogicRunnerP::upgradeResult(const QHash<QString, QList<QMdmmCore::Data::Upg
                     winners << onlineAgent->objectName();
             }
             gameOver(winners);
-            emit q->gameOver(LogicRunner::QPrivateSignal());
             return;
         }
     }
 
-    foreach (Agent *agent, agents)
+    broadcast(ServerConnection::upgradeNotifyPacket(upgrades), true, [&upgrades](Agent *agent) {
         agent->notifyUpgrade(upgrades);
+    });
 
     // The upgrade phase finished without a game over. Advance to the next round.
     // This mirrors the initial kick-off in addAgent(): announce the new round to
     // every agent (so clients reset their local room via notifyRoundStart) and
     // then start it. Without this, the match stalls after the very first round.
-    foreach (Agent *agent, agents)
+    broadcast(ServerConnection::roundStartNotifyPacket(), false, [](Agent *agent) {
         agent->notifyRoundStart();
+    });
 
-    // A new round begins: drop the previous round's events so the next round's log restarts empty
-    // (the client resets its per-round event counter on notifyRoundStart, mirroring this).
-    foreach (ServerConnection *conn, connections)
-        conn->clearRoundEventLog();
+    // The logic takes a snapshot for the journal before the next round, which replaces the records from here back
+    if (journal != nullptr) {
+        journalSnapshotOffset = journal->size();
+        emit snapshot(QString());
+    }
 
     emit roundStart();
 }
 
 void LogicRunnerP::roundOver()
 {
-    // The round's action phase is over: drop each connection's round-event log. A reconnect from
-    // here on is in the upgrade phase or the next round, where the old round's events are no longer
-    // needed.
-    foreach (ServerConnection *conn, connections)
-        conn->clearRoundEventLog();
-
-    foreach (Agent *agent, agents)
+    broadcast(ServerConnection::roundOverNotifyPacket(), true, [](Agent *agent) {
         agent->notifyRoundOver();
+    });
+}
+
+void LogicRunnerP::snapshotResult(const QString &playerName, const QMdmmCore::Protocol::RoomSnapshotNotify &snapshot)
+{
+    QMdmmCore::Protocol::RoomSnapshotNotify notify = snapshot;
+    fillIdentities(&notify);
+
+    // The snapshot of the room itself, see upgradeResult
+    if (playerName.isEmpty()) {
+        if (journal != nullptr && journalSnapshotOffset >= 0 && !journal->compact(QList<QCborArray> {configurationRecord(), snapshotRecord(notify)}, journalSnapshotOffset))
+            qWarning("The journal of a room can't be compacted");
+        journalSnapshotOffset = -1;
+        return;
+    }
+
+    ServerConnection *conn = connections.value(playerName, nullptr);
+    if (conn == nullptr)
+        return;
+
+    conn->sendRoomSnapshot(ServerConnection::roomSnapshotNotifyPacket(notify));
+
+    // A player reconnecting to a recovered room is asked what was asked before the restart
+    askRecoveredRequest(playerName);
 }
 
 void LogicRunnerP::gameOver(const QStringList &winners)
 {
-    foreach (Agent *agent, agents)
+    broadcast(ServerConnection::gameOverNotifyPacket(winners), false, [&winners](Agent *agent) {
         agent->notifyGameOver(winners);
+    });
+
+    finishGame();
 }
 } // namespace p
 #endif
@@ -851,14 +1249,13 @@ namespace v0 {
 
 /**
  * @class LogicRunner
- * @brief The server-side object that runs a single complete game.
+ * @brief The server-side object that runs the games of one room.
  *
  * A LogicRunner owns the agents (server-side representations of connected clients) and
- * runs a @c QMdmmCore::Logic on a separate thread. It handles exactly one complete game:
- * when the game is over, the LogicRunner should be destroyed and all agents disconnected.
- *
- * @note This class is designed for one game only. Lobby / multi-room support is not
- * implemented yet.
+ * runs a @c QMdmmCore::Logic on a separate thread, one of a pool shared by every room. It runs one game at a time:
+ * @c LogicRunner::gameOver() is emitted when the game is over, then the LogicRunner is either destroyed, or reset by
+ * @c LogicRunner::reset() , which lets the agents of the game go and builds a new logic, and reused for another game.
+ * A game recorded in a journal can be rebuilt after a restart (see @c LogicRunner::openJournal() ).
  */
 
 /**
@@ -926,8 +1323,9 @@ Agent *LogicRunner::addAgent(Agent *agent)
 
     emit d->addPlayer(playerName);
 
-    foreach (Agent *a, d->agents)
+    d->broadcast(p::ServerConnection::playerAddNotifyPacket(playerName, agent->screenName(), agent->state()), false, [&playerName, agent](Agent *a) {
         a->notifyPlayerAdd(playerName, agent->screenName(), agent->state());
+    });
 
     // Tell the newly added agent about every player that joined before it.
     // NOTE: iterate over the *existing* agents and report their identities,
@@ -939,10 +1337,12 @@ Agent *LogicRunner::addAgent(Agent *agent)
     }
 
     if (full()) {
-        foreach (Agent *a, d->agents)
+        d->broadcast(p::ServerConnection::gameStartNotifyPacket(), false, [](Agent *a) {
             a->notifyGameStart();
-        foreach (Agent *a, d->agents)
+        });
+        d->broadcast(p::ServerConnection::roundStartNotifyPacket(), false, [](Agent *a) {
             a->notifyRoundStart();
+        });
         emit d->roundStart();
     }
 
@@ -957,8 +1357,9 @@ Agent *LogicRunner::addAgent(Agent *agent)
  * A reconnect only makes sense for a player who is already in the room (the room is full, so the
  * game has started) but whose socket was cleared by @c ServerConnection::onSocketDisconnected,
  * which also marked the agent offline. This is the logic-side half of a reconnect: it restores
- * the online / trust flags and resends the state snapshot so the reconnecting client can rebuild
- * its room view. The wire-side half (rebind the socket + replay the missed round events) is
+ * the online / trust flags, resends the logic configuration and asks the logic for a room snapshot,
+ * from which the reconnecting client rebuilds its room view in one packet. The wire-side half
+ * (rebind the socket + hold back packets until the snapshot is sent) is
  * @c ServerConnection::reconnect, called by the operation side (ServerP) that owns the socket.
  * The room itself only ever deals with agents, never sockets (D-018).
  */
@@ -984,18 +1385,127 @@ Agent *LogicRunner::reconnectAgent(Agent *agent)
     state.setFlag(QMdmmCore::Data::StateMaskOnline, true).setFlag(QMdmmCore::Data::StateMaskTrust, true);
     agent->setState(state);
 
-    // Resend the state snapshot to the reconnected client so it can rebuild its room: the logic
-    // configuration, then every player (identity + current state). The client treats a duplicate
-    // notifyPlayerAdd as benign (ClientP::notifyPlayerAdded), and the notifyAgentStateChange
-    // broadcast above is dropped by the reconnected client until it has learned the players here.
+    // Resend the logic configuration, then the room snapshot: every player (identity + current
+    // state) and the logic state. The snapshot is taken by the logic on its thread, and it is sent
+    // by LogicRunnerP::snapshotResult. The notifyAgentStateChange broadcast above is carried by the
+    // snapshot, so it is not sent to the reconnected client.
     agent->notifyLogicConfiguration();
 
-    foreach (Agent *a, d->agents)
-        agent->notifyPlayerAdd(a->objectName(), a->screenName(), a->state());
+    emit d->snapshot(agent->objectName());
 
     return agent;
 }
 
+/**
+ * @brief Make the room ready for another game
+ *
+ * A finished room can be recycled instead of deleted. The agents of the last game leave the room without any notify, and
+ * the ones owned by the room are deleted later together with their @c ServerConnection s. The logic is replaced by a new
+ * one on the same worker, and the results the old logic has not delivered yet are dropped. The room keeps its logic
+ * configuration, and its journal is deleted.
+ */
+void LogicRunner::reset()
+{
+    for (QHash<QString, Agent *>::const_iterator it = d->agents.constBegin(); it != d->agents.constEnd(); ++it) {
+        Agent *agent = it.value();
+        disconnect(agent, nullptr, d, nullptr);
+        if (p::ServerConnection *conn = d->connections.value(it.key(), nullptr); conn != nullptr)
+            disconnect(conn, nullptr, d, nullptr);
+
+        // A local agent belongs to its operation side
+        if (agent->parent() == this) {
+            agent->setParent(nullptr);
+            agent->deleteLater();
+        }
+    }
+    d->agents.clear();
+    d->connections.clear();
+
+    if (d->journal != nullptr) {
+        d->journal->remove();
+        d->journal.reset();
+    }
+    d->journalCommitPending = false;
+    d->journalSnapshotOffset = -1;
+    d->recoveredRequests.clear();
+    d->recoveredRoundStart = false;
+    // A replay still running is left to the old logic
+    disconnect(d->replayConnection);
+    d->replayConnection = {};
+
+    if (d->logic) {
+        disconnect(d->logic, nullptr, d, nullptr);
+        disconnect(d, nullptr, d->logic, nullptr);
+        d->logic->deleteLater();
+    }
+    // Only the logic posts calls to the room
+    QCoreApplication::removePostedEvents(d, QEvent::MetaCall);
+
+    d->createLogic();
+}
+
+/**
+ * @brief Record the game in a journal, from which the room is rebuilt after a restart
+ * @param path the path of the journal file, which is replaced
+ * @return @c true if the journal is created, @c false if it can't be or the room is not empty
+ *
+ * Every input of the logic is appended to the journal, which is a memory mapped file, and the kernel is asked to write
+ * the records of an event loop iteration back at once, without waiting for the disk. Between rounds the records before
+ * the round are replaced by a snapshot of the room. The journal is deleted when the game is over or the room is reset,
+ * and it is kept when the room is deleted otherwise, e.g. when the server stops.
+ *
+ * @sa @c LogicRunner::recover()
+ */
+bool LogicRunner::openJournal(const QString &path)
+{
+    if (!d->agents.isEmpty())
+        return false;
+
+    auto journal = std::make_unique<p::RoomJournal>(path);
+    if (!journal->create())
+        return false;
+
+    d->journal = std::move(journal);
+    d->record(d->configurationRecord());
+    return true;
+}
+
+/**
+ * @brief Rebuild a room from its journal
+ * @param path the path of the journal written after @c LogicRunner::openJournal()
+ * @param parent QObject parent.
+ * @return the rebuilt room, or @c nullptr if the journal can't be read or its game has not started, in which case the
+ * journal is deleted
+ *
+ * The agents are created with their @c ServerConnection s, and they are offline until their players reconnect (see
+ * @c LogicRunner::reconnectAgent() ). The logic is rebuilt on its worker afterwards, without blocking the calling
+ * thread. A game which can't be replayed or which was over is then dropped as a finished game: the journal is deleted
+ * and @c LogicRunner::gameOver() is emitted. A request left unanswered is asked again after the room snapshot is sent to
+ * its reconnecting player, and the rest are asked after the request timeout, which offline players answer by default.
+ * The room keeps appending to the journal.
+ */
+LogicRunner *LogicRunner::recover(const QString &path, QObject *parent)
+{
+    auto journal = std::make_unique<p::RoomJournal>(path);
+    QList<QCborArray> records;
+    QMdmmCore::LogicConfiguration conf;
+    if (!journal->open(&records) || records.isEmpty() || records.first().at(0).toInteger() != p::RoomJournal::RecordConfiguration
+        || !conf.deserialize(records.first().at(1).toJsonValue())) {
+        journal->remove();
+        return nullptr;
+    }
+
+    auto *runner = new LogicRunner(conf, parent);
+    if (!runner->d->replay(records)) {
+        journal->remove();
+        delete runner;
+        return nullptr;
+    }
+
+    runner->d->journal = std::move(journal);
+    return runner;
+}
+
 /**
  * @brief get the agent of a specific internal name
  * @param playerName the internal name of the searched agent
@@ -44,6 +44,11 @@ public:
     // Functions to be called in Server thread
     Agent *addAgent(Agent *agent);
     Agent *reconnectAgent(Agent *agent);
+    void reset();
+
+    // Crash recovery
+    bool openJournal(const QString &path);
+    static LogicRunner *recover(const QString &path, QObject *parent = nullptr);
 
     Agent *agent(const QString &playerName);
     [[nodiscard]] const Agent *agent(const QString &playerName) const;
@@ -6,14 +6,20 @@
 #include "qmdmmlogicrunner.h"
 
 #include "qmdmmagent.h"
+#include "qmdmmjournal_p.h"
 #include "qmdmmsocket.h"
 
 #include <QMdmmLogic>
 #include <QMdmmRoom>
 
+#include <QCborArray>
+#include <QList>
+#include <QMutex>
 #include <QPointer>
 #include <QThread>
 #include <QTimer>
+#include <functional>
+#include <memory>
 #include <utility>
 
 // NOLINTBEGIN(misc-non-private-member-variables-in-classes): This is private header
@@ -22,7 +28,7 @@ namespace QMdmmNetworking {
 namespace p {
 
 // The server-side plumbing for one connected player: the socket, the request timer, the current
-// request state, the protocol dispatch tables, and the round-event log. It is a *companion* to an
+// request state, the protocol dispatch tables, and the packets held back during a reconnect. It is a *companion* to an
 // Agent (composition, not inheritance): the Agent owns the player identity (name / screen name /
 // state), while the ServerConnection owns everything tied to the wire. This split lets a
 // socket-less local agent exist later without dragging socket machinery into the Agent type.
@@ -30,9 +36,9 @@ class QMDMMNETWORKING_PRIVATE_EXPORT ServerConnection : public QObject
 {
     Q_OBJECT
 
-    static QHash<QMdmmCore::Protocol::NotifyId, void (ServerConnection::*)(const QJsonValue &)> notifyCallback;
-    static QHash<QMdmmCore::Protocol::RequestId, void (ServerConnection::*)(const QJsonValue &)> replyCallback;
-    static QHash<QMdmmCore::Protocol::RequestId, void (ServerConnection::*)()> defaultReplyCallback;
+    static QMdmmCore::Protocol::DispatchTable<QMdmmCore::Protocol::NotifyId, void (ServerConnection::*)(const QJsonValue &)> notifyCallback;
+    static QMdmmCore::Protocol::DispatchTable<QMdmmCore::Protocol::RequestId, void (ServerConnection::*)(const QJsonValue &)> replyCallback;
+    static QMdmmCore::Protocol::DispatchTable<QMdmmCore::Protocol::RequestId, void (ServerConnection::*)()> defaultReplyCallback;
 
     static int requestTimeoutGracePeriod;
 
@@ -50,27 +56,51 @@ public:
     QJsonValue currentRequestValue;
     QTimer *requestTimer;
 
-    // Round-event log: every round-event packet this connection has broadcast (ssc / action-order
-    // / action / upgrade), in send order. The list index IS the round-event sequence number (events
-    // are appended in broadcast order, and the client counts one per event it receives), so no
-    // explicit sequence is stored and no sorting is needed. Used for the per-agent precise
-    // catch-up on reconnect (backlog "precise catch-up"): a reconnecting client is replayed only
-    // the events it missed, in send order.
-    QList<QMdmmCore::Packet> roundEventLog;
+    // A reconnecting client rebuilds its room from a room snapshot, which the Logic takes on its
+    // own thread. Until the snapshot arrives, the room state packets are dropped (the snapshot
+    // already carries their effect, since the Logic emitted them before taking it, and the agent
+    // states are filled in when it arrives), and the other notifications are held back and sent
+    // after the snapshot, in order. The latter are posted to the Logic from this thread after the
+    // snapshot was asked for, so the Logic handles them after taking it.
+    bool snapshotPending;
+    QList<QMdmmCore::Packet> deferredPackets;
 
-    void clearRoundEventLog();
-    void replayMissedRoundEvents(int lastRoundEventSeq);
-
-    // Reconnect on the wire layer (D-018): rebind the socket and replay the round events the
-    // reconnecting client missed. The logic-side half of a reconnect (restore online/trust +
-    // state snapshot) lives on LogicRunner::reconnectAgent, which only deals with agents.
-    void reconnect(Socket *socket, int lastRoundEventSeq);
+    // Reconnect on the wire layer (D-018): rebind the socket and wait for the room snapshot. The
+    // logic-side half of a reconnect (restore online/trust + take the snapshot) lives on
+    // LogicRunner::reconnectAgent, which only deals with agents.
+    void reconnect(Socket *socket);
 
     void addRequest(QMdmmCore::Protocol::RequestId requestId, const QJsonValue &value);
 
+    // notification packets: build the wire packet of a notification. A broadcast builds its packet
+    // once per room event with these (see LogicRunnerP::broadcast), and the per-agent slots below
+    // use them too, so both paths put the same bytes on the wire.
+    static QMdmmCore::Packet agentStateChangeNotifyPacket(const QString &playerName, const QMdmmCore::Data::AgentState &agentState);
+    static QMdmmCore::Packet playerAddNotifyPacket(const QString &playerName, const QString &screenName, const QMdmmCore::Data::AgentState &agentState);
+    static QMdmmCore::Packet playerRemoveNotifyPacket(const QString &playerName);
+    static QMdmmCore::Packet gameStartNotifyPacket();
+    static QMdmmCore::Packet roundStartNotifyPacket();
+    static QMdmmCore::Packet stoneScissorsClothNotifyPacket(const QHash<QString, QMdmmCore::Data::StoneScissorsCloth> &replies);
+    static QMdmmCore::Packet actionOrderNotifyPacket(const QHash<int, QString> &result);
+    static QMdmmCore::Packet actionNotifyPacket(const QString &playerName, QMdmmCore::Data::Action action, const QString &toPlayer, int toPlace);
+    static QMdmmCore::Packet roundOverNotifyPacket();
+    static QMdmmCore::Packet upgradeNotifyPacket(const QHash<QString, QList<QMdmmCore::Data::UpgradeItem>> &upgrades);
+    static QMdmmCore::Packet gameOverNotifyPacket(const QStringList &playerNames);
+    static QMdmmCore::Packet speakNotifyPacket(const QString &playerName, const QString &content);
+    static QMdmmCore::Packet roomSnapshotNotifyPacket(const QMdmmCore::Protocol::RoomSnapshotNotify &snapshot);
+
+    // send an already built notification packet. The packet is shared with every other recipient
+    // of the same broadcast, and it is only serialized once (see QMdmmCore::Packet::serialize).
+    // A room state packet is a result of the Logic or an agent state change, which a room snapshot
+    // carries as a whole.
+    void sendNotifyPacket(const QMdmmCore::Packet &packet);
+    void sendRoomStatePacket(const QMdmmCore::Packet &packet);
+    void sendRoomSnapshot(const QMdmmCore::Packet &packet);
+
     // reply decode callbacks: validate the wire value and hand the strong-typed reply to the Agent
-    // (which then forwards it as the corresponding replyXxx signal). These keep only the JSON
-    // validation / type conversion, which is the wire's job; the controller logic lives on Agent.
+    // (which then forwards it as the corresponding replyXxx signal). The validation / type
+    // conversion is generated from the payload description in QMdmmCore::Protocol, which is the
+    // wire's job; the controller logic lives on Agent.
     void decodeStoneScissorsClothReply(const QJsonValue &value);
     void decodeActionOrderReply(const QJsonValue &value);
     void decodeActionReply(const QJsonValue &value);
@@ -124,6 +154,64 @@ public slots: // NOLINT(readability-redundant-access-specifiers)
     void executeDefaultReply();
 };
 
+// The threads running the Logic of every room. There are at most as many workers as processors, so thousands of rooms,
+// which are idle most of the time, share a few threads instead of having one each. A room is assigned to the worker
+// running the fewest rooms, and a new worker is only started when every running one is busy.
+// The pool is shared by every LogicRunner in the process, and its workers are stopped after the last room is gone.
+// That doesn't wait for them, since the last room is usually deleted on the server thread while it serves other rooms.
+// A server shutting down drains the pool instead, which waits for the workers left without rooms
+class QMDMMNETWORKING_PRIVATE_EXPORT LogicWorkerPool final
+{
+public:
+    static std::shared_ptr<LogicWorkerPool> instance();
+
+    ~LogicWorkerPool();
+    Q_DISABLE_COPY_MOVE(LogicWorkerPool);
+
+    // Called from any thread
+    QThread *acquire();
+    void release(QThread *worker);
+    [[nodiscard]] int workerCount();
+    // Stop the workers running no room and wait for them, deleting the logics left to them
+    void drain();
+
+private:
+    LogicWorkerPool();
+
+    struct Worker
+    {
+        QThread *thread;
+        int rooms;
+    };
+
+    QMutex mutex;
+    QList<Worker> workers;
+    int maximumWorkerCount;
+};
+
+class LogicRunnerP;
+
+// A recovered room replays its journal through the logic on the worker, as this job posted there, so that the server
+// thread goes on serving other rooms meanwhile. The job watches the requests of the logic to find the ones left
+// unanswered, posts them to the room when it is done and deletes itself. The room is only referred to by the requests,
+// which are asked on the thread of the room
+class QMDMMNETWORKING_PRIVATE_EXPORT LogicReplay final : public QObject
+{
+    Q_OBJECT
+
+public:
+    LogicReplay(QMdmmCore::Logic *logic, QList<QCborArray> records, LogicRunnerP *runner);
+
+    void run();
+
+    QPointer<QMdmmCore::Logic> logic;
+    QList<QCborArray> records;
+    LogicRunnerP *runner;
+
+signals:
+    void finished(bool replayed, const QHash<QString, std::function<void()>> &pending, bool roundStartDue);
+};
+
 class QMDMMNETWORKING_PRIVATE_EXPORT LogicRunnerP : public QObject
 {
     Q_OBJECT
@@ -132,20 +220,72 @@ public:
     LogicRunnerP(QMdmmCore::LogicConfiguration logicConfiguration, LogicRunner *q);
     ~LogicRunnerP() override;
 
+    // Create the logic on the worker and wire it to this room, for a new room and for a room reset
+    void createLogic();
+    // The results of the logic are not wired while a recovered room replays its journal
+    void connectLogicResults();
+
     LogicRunner *q;
 
     QHash<QString, Agent *> agents;
     QHash<QString, ServerConnection *> connections;
 
+    // The pool is held so that the worker running the logic outlives it
+    std::shared_ptr<LogicWorkerPool> workerPool;
     QThread *logicThread;
     QPointer<QMdmmCore::Logic> logic;
 
     QMdmmCore::LogicConfiguration conf;
 
-    // No qRegisterMetaType<>() is needed for the queued signals / slots below: their argument
-    // types are QMdmmCore::Data enums / flags (auto-registered via Q_ENUM_NS / Q_FLAG_NS) plus
-    // Qt's built-in container metatypes, and the connections use the function-pointer syntax.
-    // Verified by the in-process smoke test, which drives a full game across the logic thread.
+    // Broadcast a room event. The packet is built by the caller once and the same shared packet is
+    // handed to the connection of every networked agent, so it is encoded once per room event
+    // instead of once per recipient. An agent without a connection (a local agent) is notified
+    // through notifyLocal, which calls the corresponding Agent::notifyXxx. roomState tells whether
+    // the event is carried by a room snapshot (see ServerConnection::sendRoomStatePacket).
+    template<typename NotifyLocal>
+    void broadcast(const QMdmmCore::Packet &packet, bool roomState, NotifyLocal notifyLocal)
+    {
+        for (QHash<QString, Agent *>::const_iterator it = agents.constBegin(); it != agents.constEnd(); ++it) {
+            ServerConnection *conn = connections.value(it.key(), nullptr);
+            if (conn == nullptr)
+                notifyLocal(it.value());
+            else if (roomState)
+                conn->sendRoomStatePacket(packet);
+            else
+                conn->sendNotifyPacket(packet);
+        }
+    }
+
+    // Crash recovery (see LogicRunner::openJournal). Every input emitted to the logic is recorded in the journal, which
+    // is committed once per event loop iteration. The logic takes a snapshot of the room between rounds, which replaces
+    // the records before the round in the journal
+    std::unique_ptr<RoomJournal> journal;
+    bool journalCommitPending;
+    qint64 journalSnapshotOffset;
+    void record(const QCborArray &record);
+    [[nodiscard]] QCborArray configurationRecord() const;
+    [[nodiscard]] QCborArray snapshotRecord(const QMdmmCore::Protocol::RoomSnapshotNotify &snapshot) const;
+    void fillIdentities(QMdmmCore::Protocol::RoomSnapshotNotify *snapshot) const;
+    // A finished game is not recovered
+    void finishGame();
+
+    // A recovered room is rebuilt from its journal by replaying the records. The agents are rebuilt at once, and the
+    // logic is rebuilt by a LogicReplay queued before anything else is posted to it. Nobody is connected then, so the
+    // requests which were not answered are asked again when their players reconnect, or after the request timeout,
+    // which the offline ones answer by default
+    void addRecoveredAgent(const QString &playerName, const QString &screenName, QMdmmCore::Data::AgentState state);
+    bool replay(const QList<QCborArray> &records);
+    void replayFinished(bool replayed, const QHash<QString, std::function<void()>> &pending, bool roundStartDue);
+    QMetaObject::Connection replayConnection;
+    QHash<QString, std::function<void()>> recoveredRequests;
+    bool recoveredRoundStart;
+    void askRecoveredRequest(const QString &playerName);
+    void startRecoveredRound();
+
+    // The queued signals / slots below carry QMdmmCore::Data enums / flags (Q_ENUM_NS / Q_FLAG_NS),
+    // Qt containers of them, and QMdmmCore::Protocol::RoomSnapshotNotify for snapshotResult, which
+    // is declared with Q_DECLARE_METATYPE next to the protocol. The connections use the
+    // function-pointer syntax, so moc resolves every metatype and no qRegisterMetaType<>() is called.
 
 public slots: // NOLINT(readability-redundant-access-specifiers)
     // slots called from agent
@@ -170,6 +310,10 @@ public slots: // NOLINT(readability-redundant-access-specifiers)
     void upgradeResult(const QHash<QString, QList<QMdmmCore::Data::UpgradeItem>> &upgrades);
     void roundOver();
     void gameOver(const QStringList &winners);
+    void snapshotResult(const QString &playerName, const QMdmmCore::Protocol::RoomSnapshotNotify &snapshot);
+
+    void commitJournal();
+    void askRecoveredRequests();
 
 signals: // NOLINT(readability-redundant-access-specifiers)
     // These signals are emitted to Logic
@@ -180,6 +324,7 @@ signals: // NOLINT(readability-redundant-access-specifiers)
     void actionOrderReply(const QString &playerName, const QList<int> &desiredOrder);
     void actionReply(const QString &playerName, QMdmmCore::Data::Action action, const QString &toPlayer, int toPlace);
     void upgradeReply(const QString &playerName, const QList<QMdmmCore::Data::UpgradeItem> &items);
+    void snapshot(const QString &playerName);
 };
 
 } // namespace p
@@ -4,10 +4,20 @@
 #include "qmdmmserver_p.h"
 
 #include "qmdmmagent.h"
+#include "qmdmmepoll_p.h"
 #include "qmdmmlogicrunner_p.h"
+#include "qmdmmsocket_p.h"
 
+#include <QDir>
+#include <QFile>
 #include <QLocalSocket>
+#include <QLoggingCategory>
+#include <QSet>
+#include <QSslKey>
+#include <QSslServer>
 #include <QTcpSocket>
+#include <QUuid>
+#include <algorithm>
 #include <utility>
 
 /**
@@ -30,6 +40,11 @@ namespace v0 {
  * @brief Whether the TCP server is enabled, default true
  */
 
+/**
+ * @property ServerConfiguration::epollEnabled
+ * @brief Whether TCP is served by the epoll backend instead of QTcpServer, default false. Linux only, and not used with TLS
+ */
+
 /**
  * @property ServerConfiguration::tcpPort
  * @brief The TCP port, default 6366
@@ -60,6 +75,131 @@ namespace v0 {
  * @brief The WebSocket port, default 6367
  */
 
+/**
+ * @property ServerConfiguration::inProcessEnabled
+ * @brief Whether the in-process server is enabled, default false. Only clients in the same process can connect to it
+ */
+
+/**
+ * @property ServerConfiguration::inProcessName
+ * @brief The in-process server name, to which clients connect with "inproc://" followed by it, default "QMdmm"
+ */
+
+/**
+ * @property ServerConfiguration::maximumFrameSize
+ * @brief The maximum size of a received frame in bytes, default 1048576
+ */
+
+/**
+ * @property ServerConfiguration::receiveBufferSize
+ * @brief The number of received bytes buffered for a client before reading from it pauses in bytes, default 65536
+ */
+
+/**
+ * @property ServerConfiguration::compressionThreshold
+ * @brief The minimum size of a frame compressed for clients which support compression in bytes, default 1024. 0 disables compression
+ */
+
+/**
+ * @property ServerConfiguration::outboundLowWatermark
+ * @brief The size of the outbound queue of a client to which it drains before non-essential packets are sent again in bytes, default 65536
+ */
+
+/**
+ * @property ServerConfiguration::outboundHighWatermark
+ * @brief The size of the outbound queue of a client from which non-essential packets are dropped in bytes, default 262144. 0 never drops packets
+ */
+
+/**
+ * @property ServerConfiguration::maximumOutboundSize
+ * @brief The maximum size of the outbound queue of a client in bytes, default 1048576. A client exceeding it is disconnected. 0 for no limit
+ */
+
+/**
+ * @property ServerConfiguration::speakRateLimit
+ * @brief The number of chat messages (@c NotifySpeak ) accepted from a client per second, default 2. Messages over the limit are dropped. 0 for no limit
+ */
+
+/**
+ * @property ServerConfiguration::speakBurst
+ * @brief The number of chat messages accepted from a client at once, default 5
+ */
+
+/**
+ * @property ServerConfiguration::notifyRateLimit
+ * @brief The number of all other notifies together accepted from a client per second, default 20. Notifies over the limit are dropped. 0 for no limit
+ */
+
+/**
+ * @property ServerConfiguration::notifyBurst
+ * @brief The number of all other notifies together accepted from a client at once, default 40
+ */
+
+/**
+ * @property ServerConfiguration::tlsCertificate
+ * @brief The path of the PEM encoded certificate (chain) of the server, default empty. TCP and WebSocket are encrypted with TLS when it is set
+ */
+
+/**
+ * @property ServerConfiguration::tlsPrivateKey
+ * @brief The path of the PEM encoded private key of the certificate, default empty
+ */
+
+/**
+ * @property ServerConfiguration::ioThreadCount
+ * @brief The number of threads serving the TCP connections of rooms, default 0. Each room is assigned to one of them, and
+ * the connections of its players move there after signing in. 0 serves every connection on the thread of the server
+ */
+
+/**
+ * @property ServerConfiguration::matchmakingInterval
+ * @brief The time in milliseconds a batch of the matchmaking queue is collected for, default 0. A new player waits in
+ * the queue until the batch is seated in the recruiting rooms. 0 seats the players signed in during one event loop
+ * iteration together
+ */
+
+/**
+ * @property ServerConfiguration::recruitingRoomCount
+ * @brief The number of rooms recruiting players at once, default 1. More than one room only makes difference when
+ * players are grouped by latency
+ */
+
+/**
+ * @property ServerConfiguration::latencyTolerance
+ * @brief The largest difference in milliseconds between the sign in round trip of a player and the one of the first
+ * player of a room for the player to be seated there, default 0 for not grouping players by latency
+ */
+
+/**
+ * @property ServerConfiguration::roomPoolSize
+ * @brief The number of idle rooms kept ready for new games, default 2. A finished room is reset and kept as an idle one
+ * until there are as many, and new rooms are created for the pool only once it runs out
+ */
+
+/**
+ * @property ServerConfiguration::journalDirectory
+ * @brief The directory of the journals of the rooms, default empty for not keeping journals. The games in the journals
+ * there are recovered when the server starts, and their players can reconnect to them
+ */
+
+/**
+ * @property ServerConfiguration::maximumConnectionCount
+ * @brief The number of connections served at once, default 10000. A connection over it is closed as soon as it is
+ * accepted. 0 for no limit
+ */
+
+/**
+ * @property ServerConfiguration::signInTimeout
+ * @brief The time in milliseconds a connection has to sign in, default 30000. A connection not signed in by then is
+ * closed. 0 for no limit
+ */
+
+/**
+ * @property ServerConfiguration::idleTimeout
+ * @brief The time in milliseconds a connection which has not signed in may send nothing, default 10000. A connection
+ * silent for longer is closed. 0 for no limit
+ */
+
 /**
  * @fn ServerConfiguration::tcpEnabled() const
  * @brief getter of @c ServerConfiguration::tcpEnabled
@@ -72,6 +212,18 @@ namespace v0 {
  * @param tcpEnabled @c ServerConfiguration::tcpEnabled
  */
 
+/**
+ * @fn ServerConfiguration::epollEnabled() const
+ * @brief getter of @c ServerConfiguration::epollEnabled
+ * @return @c ServerConfiguration::epollEnabled
+ */
+
+/**
+ * @fn ServerConfiguration::setEpollEnabled(bool epollEnabled)
+ * @brief setter of @c ServerConfiguration::epollEnabled
+ * @param epollEnabled @c ServerConfiguration::epollEnabled
+ */
+
 /**
  * @fn ServerConfiguration::tcpPort() const
  * @brief getter of @c ServerConfiguration::tcpPort
@@ -144,6 +296,282 @@ namespace v0 {
  * @param websocketPort @c ServerConfiguration::websocketPort
  */
 
+/**
+ * @fn ServerConfiguration::inProcessEnabled() const
+ * @brief getter of @c ServerConfiguration::inProcessEnabled
+ * @return @c ServerConfiguration::inProcessEnabled
+ */
+
+/**
+ * @fn ServerConfiguration::setInProcessEnabled(bool inProcessEnabled)
+ * @brief setter of @c ServerConfiguration::inProcessEnabled
+ * @param inProcessEnabled @c ServerConfiguration::inProcessEnabled
+ */
+
+/**
+ * @fn ServerConfiguration::inProcessName() const
+ * @brief getter of @c ServerConfiguration::inProcessName
+ * @return @c ServerConfiguration::inProcessName
+ */
+
+/**
+ * @fn ServerConfiguration::setInProcessName(const QString &inProcessName)
+ * @brief setter of @c ServerConfiguration::inProcessName
+ * @param inProcessName @c ServerConfiguration::inProcessName
+ */
+
+/**
+ * @fn ServerConfiguration::maximumFrameSize() const
+ * @brief getter of @c ServerConfiguration::maximumFrameSize
+ * @return @c ServerConfiguration::maximumFrameSize
+ */
+
+/**
+ * @fn ServerConfiguration::setMaximumFrameSize(int maximumFrameSize)
+ * @brief setter of @c ServerConfiguration::maximumFrameSize
+ * @param maximumFrameSize @c ServerConfiguration::maximumFrameSize
+ */
+
+/**
+ * @fn ServerConfiguration::receiveBufferSize() const
+ * @brief getter of @c ServerConfiguration::receiveBufferSize
+ * @return @c ServerConfiguration::receiveBufferSize
+ */
+
+/**
+ * @fn ServerConfiguration::setReceiveBufferSize(int receiveBufferSize)
+ * @brief setter of @c ServerConfiguration::receiveBufferSize
+ * @param receiveBufferSize @c ServerConfiguration::receiveBufferSize
+ */
+
+/**
+ * @fn ServerConfiguration::compressionThreshold() const
+ * @brief getter of @c ServerConfiguration::compressionThreshold
+ * @return @c ServerConfiguration::compressionThreshold
+ */
+
+/**
+ * @fn ServerConfiguration::setCompressionThreshold(int compressionThreshold)
+ * @brief setter of @c ServerConfiguration::compressionThreshold
+ * @param compressionThreshold @c ServerConfiguration::compressionThreshold
+ */
+
+/**
+ * @fn ServerConfiguration::outboundLowWatermark() const
+ * @brief getter of @c ServerConfiguration::outboundLowWatermark
+ * @return @c ServerConfiguration::outboundLowWatermark
+ */
+
+/**
+ * @fn ServerConfiguration::setOutboundLowWatermark(int outboundLowWatermark)
+ * @brief setter of @c ServerConfiguration::outboundLowWatermark
+ * @param outboundLowWatermark @c ServerConfiguration::outboundLowWatermark
+ */
+
+/**
+ * @fn ServerConfiguration::outboundHighWatermark() const
+ * @brief getter of @c ServerConfiguration::outboundHighWatermark
+ * @return @c ServerConfiguration::outboundHighWatermark
+ */
+
+/**
+ * @fn ServerConfiguration::setOutboundHighWatermark(int outboundHighWatermark)
+ * @brief setter of @c ServerConfiguration::outboundHighWatermark
+ * @param outboundHighWatermark @c ServerConfiguration::outboundHighWatermark
+ */
+
+/**
+ * @fn ServerConfiguration::maximumOutboundSize() const
+ * @brief getter of @c ServerConfiguration::maximumOutboundSize
+ * @return @c ServerConfiguration::maximumOutboundSize
+ */
+
+/**
+ * @fn ServerConfiguration::setMaximumOutboundSize(int maximumOutboundSize)
+ * @brief setter of @c ServerConfiguration::maximumOutboundSize
+ * @param maximumOutboundSize @c ServerConfiguration::maximumOutboundSize
+ */
+
+/**
+ * @fn ServerConfiguration::speakRateLimit() const
+ * @brief getter of @c ServerConfiguration::speakRateLimit
+ * @return @c ServerConfiguration::speakRateLimit
+ */
+
+/**
+ * @fn ServerConfiguration::setSpeakRateLimit(int speakRateLimit)
+ * @brief setter of @c ServerConfiguration::speakRateLimit
+ * @param speakRateLimit @c ServerConfiguration::speakRateLimit
+ */
+
+/**
+ * @fn ServerConfiguration::speakBurst() const
+ * @brief getter of @c ServerConfiguration::speakBurst
+ * @return @c ServerConfiguration::speakBurst
+ */
+
+/**
+ * @fn ServerConfiguration::setSpeakBurst(int speakBurst)
+ * @brief setter of @c ServerConfiguration::speakBurst
+ * @param speakBurst @c ServerConfiguration::speakBurst
+ */
+
+/**
+ * @fn ServerConfiguration::notifyRateLimit() const
+ * @brief getter of @c ServerConfiguration::notifyRateLimit
+ * @return @c ServerConfiguration::notifyRateLimit
+ */
+
+/**
+ * @fn ServerConfiguration::setNotifyRateLimit(int notifyRateLimit)
+ * @brief setter of @c ServerConfiguration::notifyRateLimit
+ * @param notifyRateLimit @c ServerConfiguration::notifyRateLimit
+ */
+
+/**
+ * @fn ServerConfiguration::notifyBurst() const
+ * @brief getter of @c ServerConfiguration::notifyBurst
+ * @return @c ServerConfiguration::notifyBurst
+ */
+
+/**
+ * @fn ServerConfiguration::setNotifyBurst(int notifyBurst)
+ * @brief setter of @c ServerConfiguration::notifyBurst
+ * @param notifyBurst @c ServerConfiguration::notifyBurst
+ */
+
+/**
+ * @fn ServerConfiguration::tlsCertificate() const
+ * @brief getter of @c ServerConfiguration::tlsCertificate
+ * @return @c ServerConfiguration::tlsCertificate
+ */
+
+/**
+ * @fn ServerConfiguration::setTlsCertificate(const QString &tlsCertificate)
+ * @brief setter of @c ServerConfiguration::tlsCertificate
+ * @param tlsCertificate @c ServerConfiguration::tlsCertificate
+ */
+
+/**
+ * @fn ServerConfiguration::tlsPrivateKey() const
+ * @brief getter of @c ServerConfiguration::tlsPrivateKey
+ * @return @c ServerConfiguration::tlsPrivateKey
+ */
+
+/**
+ * @fn ServerConfiguration::setTlsPrivateKey(const QString &tlsPrivateKey)
+ * @brief setter of @c ServerConfiguration::tlsPrivateKey
+ * @param tlsPrivateKey @c ServerConfiguration::tlsPrivateKey
+ */
+
+/**
+ * @fn ServerConfiguration::ioThreadCount() const
+ * @brief getter of @c ServerConfiguration::ioThreadCount
+ * @return @c ServerConfiguration::ioThreadCount
+ */
+
+/**
+ * @fn ServerConfiguration::setIoThreadCount(int ioThreadCount)
+ * @brief setter of @c ServerConfiguration::ioThreadCount
+ * @param ioThreadCount @c ServerConfiguration::ioThreadCount
+ */
+
+/**
+ * @fn ServerConfiguration::matchmakingInterval() const
+ * @brief getter of @c ServerConfiguration::matchmakingInterval
+ * @return @c ServerConfiguration::matchmakingInterval
+ */
+
+/**
+ * @fn ServerConfiguration::setMatchmakingInterval(int matchmakingInterval)
+ * @brief setter of @c ServerConfiguration::matchmakingInterval
+ * @param matchmakingInterval @c ServerConfiguration::matchmakingInterval
+ */
+
+/**
+ * @fn ServerConfiguration::recruitingRoomCount() const
+ * @brief getter of @c ServerConfiguration::recruitingRoomCount
+ * @return @c ServerConfiguration::recruitingRoomCount
+ */
+
+/**
+ * @fn ServerConfiguration::setRecruitingRoomCount(int recruitingRoomCount)
+ * @brief setter of @c ServerConfiguration::recruitingRoomCount
+ * @param recruitingRoomCount @c ServerConfiguration::recruitingRoomCount
+ */
+
+/**
+ * @fn ServerConfiguration::latencyTolerance() const
+ * @brief getter of @c ServerConfiguration::latencyTolerance
+ * @return @c ServerConfiguration::latencyTolerance
+ */
+
+/**
+ * @fn ServerConfiguration::setLatencyTolerance(int latencyTolerance)
+ * @brief setter of @c ServerConfiguration::latencyTolerance
+ * @param latencyTolerance @c ServerConfiguration::latencyTolerance
+ */
+
+/**
+ * @fn ServerConfiguration::roomPoolSize() const
+ * @brief getter of @c ServerConfiguration::roomPoolSize
+ * @return @c ServerConfiguration::roomPoolSize
+ */
+
+/**
+ * @fn ServerConfiguration::setRoomPoolSize(int roomPoolSize)
+ * @brief setter of @c ServerConfiguration::roomPoolSize
+ * @param roomPoolSize @c ServerConfiguration::roomPoolSize
+ */
+
+/**
+ * @fn ServerConfiguration::journalDirectory() const
+ * @brief getter of @c ServerConfiguration::journalDirectory
+ * @return @c ServerConfiguration::journalDirectory
+ */
+
+/**
+ * @fn ServerConfiguration::setJournalDirectory(const QString &journalDirectory)
+ * @brief setter of @c ServerConfiguration::journalDirectory
+ * @param journalDirectory @c ServerConfiguration::journalDirectory
+ */
+
+/**
+ * @fn ServerConfiguration::maximumConnectionCount() const
+ * @brief getter of @c ServerConfiguration::maximumConnectionCount
+ * @return @c ServerConfiguration::maximumConnectionCount
+ */
+
+/**
+ * @fn ServerConfiguration::setMaximumConnectionCount(int maximumConnectionCount)
+ * @brief setter of @c ServerConfiguration::maximumConnectionCount
+ * @param maximumConnectionCount @c ServerConfiguration::maximumConnectionCount
+ */
+
+/**
+ * @fn ServerConfiguration::signInTimeout() const
+ * @brief getter of @c ServerConfiguration::signInTimeout
+ * @return @c ServerConfiguration::signInTimeout
+ */
+
+/**
+ * @fn ServerConfiguration::setSignInTimeout(int signInTimeout)
+ * @brief setter of @c ServerConfiguration::signInTimeout
+ * @param signInTimeout @c ServerConfiguration::signInTimeout
+ */
+
+/**
+ * @fn ServerConfiguration::idleTimeout() const
+ * @brief getter of @c ServerConfiguration::idleTimeout
+ * @return @c ServerConfiguration::idleTimeout
+ */
+
+/**
+ * @fn ServerConfiguration::setIdleTimeout(int idleTimeout)
+ * @brief setter of @c ServerConfiguration::idleTimeout
+ * @param idleTimeout @c ServerConfiguration::idleTimeout
+ */
+
 /**
  * @brief Get default values of configuration
  * @return default configuration
@@ -153,12 +581,36 @@ const ServerConfiguration &ServerConfiguration::defaults()
     // clang-format off
     static const ServerConfiguration defaultInstance {
         qMakePair(QStringLiteral("tcpEnabled"), true),
+        qMakePair(QStringLiteral("epollEnabled"), false),
         qMakePair(QStringLiteral("tcpPort"), (int)(6366U)),
         qMakePair(QStringLiteral("localEnabled"), true),
         qMakePair(QStringLiteral("localSocketName"), QStringLiteral("QMdmm")),
         qMakePair(QStringLiteral("websocketEnabled"), true),
         qMakePair(QStringLiteral("websocketName"), QStringLiteral("QMdmm")),
         qMakePair(QStringLiteral("websocketPort"), (int)(6367U)),
+        qMakePair(QStringLiteral("inProcessEnabled"), false),
+        qMakePair(QStringLiteral("inProcessName"), QStringLiteral("QMdmm")),
+        qMakePair(QStringLiteral("maximumFrameSize"), 1048576),
+        qMakePair(QStringLiteral("receiveBufferSize"), 65536),
+        qMakePair(QStringLiteral("compressionThreshold"), 1024),
+        qMakePair(QStringLiteral("outboundLowWatermark"), 65536),
+        qMakePair(QStringLiteral("outboundHighWatermark"), 262144),
+        qMakePair(QStringLiteral("maximumOutboundSize"), 1048576),
+        qMakePair(QStringLiteral("speakRateLimit"), 2),
+        qMakePair(QStringLiteral("speakBurst"), 5),
+        qMakePair(QStringLiteral("notifyRateLimit"), 20),
+        qMakePair(QStringLiteral("notifyBurst"), 40),
+        qMakePair(QStringLiteral("tlsCertificate"), QString()),
+        qMakePair(QStringLiteral("tlsPrivateKey"), QString()),
+        qMakePair(QStringLiteral("ioThreadCount"), 0),
+        qMakePair(QStringLiteral("matchmakingInterval"), 0),
+        qMakePair(QStringLiteral("recruitingRoomCount"), 1),
+        qMakePair(QStringLiteral("latencyTolerance"), 0),
+        qMakePair(QStringLiteral("roomPoolSize"), 2),
+        qMakePair(QStringLiteral("journalDirectory"), QString()),
+        qMakePair(QStringLiteral("maximumConnectionCount"), 10000),
+        qMakePair(QStringLiteral("signInTimeout"), 30000),
+        qMakePair(QStringLiteral("idleTimeout"), 10000),
     };
     // clang-format on
 
@@ -166,6 +618,7 @@ const ServerConfiguration &ServerConfiguration::defaults()
 }
 
 #define CONVERTTOTYPEBOOL(v) ((v).toBool())
+#define CONVERTTOTYPEINT(v) ((v).toInt())
 #define CONVERTTOTYPEUINT16T(v) ((uint16_t)((v).toInt()))
 #define CONVERTTOTYPEQSTRING(v) ((v).toString())
 #define IMPLEMENTATION_CONFIGURATION(type, valueName, ValueName, convertToType, convertToJsonValue) \
@@ -193,17 +646,42 @@ const ServerConfiguration &ServerConfiguration::defaults()
     }
 
 IMPLEMENTATION_CONFIGURATION(bool, tcpEnabled, TcpEnabled, CONVERTTOTYPEBOOL, )
+IMPLEMENTATION_CONFIGURATION(bool, epollEnabled, EpollEnabled, CONVERTTOTYPEBOOL, )
 IMPLEMENTATION_CONFIGURATION(uint16_t, tcpPort, TcpPort, CONVERTTOTYPEUINT16T, )
 IMPLEMENTATION_CONFIGURATION(bool, localEnabled, LocalEnabled, CONVERTTOTYPEBOOL, )
 IMPLEMENTATION_CONFIGURATION_SETTER_CONST_REFERENCE(QString, localSocketName, LocalSocketName, CONVERTTOTYPEQSTRING, )
 IMPLEMENTATION_CONFIGURATION(bool, websocketEnabled, WebsocketEnabled, CONVERTTOTYPEBOOL, )
 IMPLEMENTATION_CONFIGURATION_SETTER_CONST_REFERENCE(QString, websocketName, WebsocketName, CONVERTTOTYPEQSTRING, )
 IMPLEMENTATION_CONFIGURATION(uint16_t, websocketPort, WebsocketPort, CONVERTTOTYPEUINT16T, )
+IMPLEMENTATION_CONFIGURATION(bool, inProcessEnabled, InProcessEnabled, CONVERTTOTYPEBOOL, )
+IMPLEMENTATION_CONFIGURATION_SETTER_CONST_REFERENCE(QString, inProcessName, InProcessName, CONVERTTOTYPEQSTRING, )
+IMPLEMENTATION_CONFIGURATION(int, maximumFrameSize, MaximumFrameSize, CONVERTTOTYPEINT, )
+IMPLEMENTATION_CONFIGURATION(int, receiveBufferSize, ReceiveBufferSize, CONVERTTOTYPEINT, )
+IMPLEMENTATION_CONFIGURATION(int, compressionThreshold, CompressionThreshold, CONVERTTOTYPEINT, )
+IMPLEMENTATION_CONFIGURATION(int, outboundLowWatermark, OutboundLowWatermark, CONVERTTOTYPEINT, )
+IMPLEMENTATION_CONFIGURATION(int, outboundHighWatermark, OutboundHighWatermark, CONVERTTOTYPEINT, )
+IMPLEMENTATION_CONFIGURATION(int, maximumOutboundSize, MaximumOutboundSize, CONVERTTOTYPEINT, )
+IMPLEMENTATION_CONFIGURATION(int, speakRateLimit, SpeakRateLimit, CONVERTTOTYPEINT, )
+IMPLEMENTATION_CONFIGURATION(int, speakBurst, SpeakBurst, CONVERTTOTYPEINT, )
+IMPLEMENTATION_CONFIGURATION(int, notifyRateLimit, NotifyRateLimit, CONVERTTOTYPEINT, )
+IMPLEMENTATION_CONFIGURATION(int, notifyBurst, NotifyBurst, CONVERTTOTYPEINT, )
+IMPLEMENTATION_CONFIGURATION_SETTER_CONST_REFERENCE(QString, tlsCertificate, TlsCertificate, CONVERTTOTYPEQSTRING, )
+IMPLEMENTATION_CONFIGURATION_SETTER_CONST_REFERENCE(QString, tlsPrivateKey, TlsPrivateKey, CONVERTTOTYPEQSTRING, )
+IMPLEMENTATION_CONFIGURATION(int, ioThreadCount, IoThreadCount, CONVERTTOTYPEINT, )
+IMPLEMENTATION_CONFIGURATION(int, matchmakingInterval, MatchmakingInterval, CONVERTTOTYPEINT, )
+IMPLEMENTATION_CONFIGURATION(int, recruitingRoomCount, RecruitingRoomCount, CONVERTTOTYPEINT, )
+IMPLEMENTATION_CONFIGURATION(int, latencyTolerance, LatencyTolerance, CONVERTTOTYPEINT, )
+IMPLEMENTATION_CONFIGURATION(int, roomPoolSize, RoomPoolSize, CONVERTTOTYPEINT, )
+IMPLEMENTATION_CONFIGURATION_SETTER_CONST_REFERENCE(QString, journalDirectory, JournalDirectory, CONVERTTOTYPEQSTRING, )
+IMPLEMENTATION_CONFIGURATION(int, maximumConnectionCount, MaximumConnectionCount, CONVERTTOTYPEINT, )
+IMPLEMENTATION_CONFIGURATION(int, signInTimeout, SignInTimeout, CONVERTTOTYPEINT, )
+IMPLEMENTATION_CONFIGURATION(int, idleTimeout, IdleTimeout, CONVERTTOTYPEINT, )
 
 #undef IMPLEMENTATION_CONFIGURATION_SETTER_CONST_REFERENCE
 #undef IMPLEMENTATION_CONFIGURATION
 #undef CONVERTTOTYPEQSTRING
 #undef CONVERTTOTYPEUINT16T
+#undef CONVERTTOTYPEINT
 #undef CONVERTTOTYPEBOOL
 
 #ifndef DOXYGEN
@@ -213,7 +691,7 @@ IMPLEMENTATION_CONFIGURATION(uint16_t, websocketPort, WebsocketPort, CONVERTTOTY
 #ifndef DOXYGEN
 namespace p {
 
-QHash<QMdmmCore::Protocol::NotifyId, void (ServerP::*)(Socket *, const QJsonValue &)> ServerP::notifyCallback {
+QMdmmCore::Protocol::DispatchTable<QMdmmCore::Protocol::NotifyId, void (ServerP::*)(Socket *, const QJsonValue &)> ServerP::notifyCallback {
     std::make_pair(QMdmmCore::Protocol::NotifyPingServer, &ServerP::pingServer),
     std::make_pair(QMdmmCore::Protocol::NotifySignIn, &ServerP::signIn),
     std::make_pair(QMdmmCore::Protocol::NotifyObserve, &ServerP::observe),
@@ -225,13 +703,44 @@ ServerP::ServerP(ServerConfiguration serverConfiguration_, QMdmmCore::LogicConfi
     , logicConfiguration(std::move(logicConfiguration))
     , q(q)
     , t(nullptr)
+    , e(nullptr)
     , l(nullptr)
+    , i(nullptr)
     , w(nullptr)
-    , current(nullptr)
+    , admissionTimer(new QTimer(this))
+    , connectionCount(0)
+    , connectionSerial(0)
+    , rejectedConnectionCount(0)
+    , reapedConnectionCount(0)
+    , matchmakingTimer(new QTimer(this))
+    , nextWaitTime(0)
+    , roomPoolFilling(false)
+    , tlsEnabled(!serverConfiguration.tlsCertificate().isEmpty())
+    , workerPool(LogicWorkerPool::instance())
 {
+    if (tlsEnabled) {
+        sslConfiguration = loadSslConfiguration(serverConfiguration.tlsCertificate(), serverConfiguration.tlsPrivateKey());
+        if (sslConfiguration.isNull())
+            qWarning("TLS certificate or private key can't be loaded");
+    }
+
     // Tcp
-    if (serverConfiguration.tcpEnabled()) {
-        t = new QTcpServer(this);
+#ifdef Q_OS_LINUX
+    // The epoll backend has no TLS, an encrypted server keeps QSslServer
+    if (serverConfiguration.tcpEnabled() && serverConfiguration.epollEnabled() && !tlsEnabled) {
+        e = new EpollListener(this);
+        connect(e, &EpollListener::newConnection, this, &ServerP::epollListenerNewConnection);
+    }
+#endif
+    if (serverConfiguration.tcpEnabled() && e == nullptr) {
+        if (tlsEnabled) {
+            // QSslServer only reports a connection after its handshake is done
+            auto *sslServer = new QSslServer(this);
+            sslServer->setSslConfiguration(sslConfiguration);
+            t = sslServer;
+        } else {
+            t = new QTcpServer(this);
+        }
 
         // Qt post-6.4: new pendingConnectionAvailable signal, emitted after connection is added to pending connection queue
         // instead of the connection is established (Pre 6.3 behavior)
@@ -245,11 +754,88 @@ ServerP::ServerP(ServerConfiguration serverConfiguration_, QMdmmCore::LogicConfi
         connect(l, &QLocalServer::newConnection, this, &ServerP::localServerNewConnection);
     }
 
+    // In-process
+    if (serverConfiguration.inProcessEnabled()) {
+        i = new InProcessServer(this);
+        connect(i, &InProcessServer::newConnection, this, &ServerP::inProcessServerNewConnection);
+    }
+
     // WebSocket
     if (serverConfiguration.websocketEnabled()) {
-        w = new QWebSocketServer(serverConfiguration.websocketName(), QWebSocketServer::NonSecureMode, this);
+        w = new QWebSocketServer(serverConfiguration.websocketName(), tlsEnabled ? QWebSocketServer::SecureMode : QWebSocketServer::NonSecureMode, this);
+        if (tlsEnabled)
+            w->setSslConfiguration(sslConfiguration);
         connect(w, &QWebSocketServer::newConnection, this, &ServerP::websocketServerNewConnection);
     }
+
+    // Admission
+    admissionTimer->setSingleShot(true);
+    connect(admissionTimer, &QTimer::timeout, this, &ServerP::reapConnections);
+
+    // Matchmaking
+    matchmakingTimer->setSingleShot(true);
+    matchmakingTimer->setInterval(serverConfiguration.matchmakingInterval());
+    connect(matchmakingTimer, &QTimer::timeout, this, &ServerP::formRooms);
+    clock.start();
+    fillRoomPool();
+
+    // IO threads
+    for (int n = 0; n < serverConfiguration.ioThreadCount(); ++n) {
+        auto *thread = new QThread(this);
+        thread->setObjectName(QStringLiteral("QMdmm IO %1").arg(n));
+        auto *sockets = new QObject;
+        sockets->moveToThread(thread);
+        thread->start();
+        ioThreads.append(IoThread {thread, sockets, 0});
+    }
+
+    // Crash recovery
+    recoverRooms();
+}
+
+ServerP::~ServerP()
+{
+    // The sockets moved to an IO thread are deleted there before it finishes
+    foreach (const IoThread &ioThread, ioThreads) {
+        ioThread.sockets->deleteLater();
+        ioThread.thread->quit();
+        ioThread.thread->wait();
+    }
+
+    // The rooms are deleted before the workers running their logics are drained, so that nothing runs a logic once the
+    // server is gone
+    qDeleteAll(findChildren<LogicRunner *>(Qt::FindDirectChildrenOnly));
+    workerPool->drain();
+}
+
+QSslConfiguration ServerP::loadSslConfiguration(const QString &certificatePath, const QString &privateKeyPath)
+{
+    QList<QSslCertificate> certificateChain = QSslCertificate::fromPath(certificatePath, QSsl::Pem);
+    if (certificateChain.isEmpty())
+        return {};
+
+    QFile keyFile(privateKeyPath);
+    if (!keyFile.open(QIODevice::ReadOnly))
+        return {};
+    QByteArray pem = keyFile.readAll();
+
+    QSslKey privateKey;
+    for (QSsl::KeyAlgorithm algorithm : {QSsl::Rsa, QSsl::Ec}) {
+        privateKey = QSslKey(pem, algorithm, QSsl::Pem);
+        if (!privateKey.isNull())
+            break;
+    }
+    if (privateKey.isNull())
+        return {};
+
+    QSslConfiguration configuration = QSslConfiguration::defaultConfiguration();
+    configuration.setLocalCertificateChain(certificateChain);
+    configuration.setPrivateKey(privateKey);
+    // The server never asks for a client certificate
+    configuration.setPeerVerifyMode(QSslSocket::VerifyNone);
+    // Session tickets let a reconnecting client resume its TLS session (see ClientP::scheduleReconnect)
+    configuration.setSslOption(QSsl::SslOptionDisableSessionTickets, false);
+    return configuration;
 }
 
 void ServerP::pingServer(Socket *socket, const QJsonValue &packetValue)
@@ -260,66 +846,67 @@ void ServerP::pingServer(Socket *socket, const QJsonValue &packetValue)
 void ServerP::signIn(Socket *socket, const QJsonValue &packetValue)
 {
     do {
-        if (!packetValue.isObject())
+        QMdmmCore::Protocol::SignInNotify signIn;
+        if (!QMdmmCore::Protocol::decodePayload(packetValue, &signIn))
             break;
 
-        QJsonObject ob = packetValue.toObject();
+        const QString &playerName = signIn.playerName;
 
-#define CONVERTAGENTSTATE() QMdmmCore::Data::AgentState(v.toInt())
-
-        // NOLINTBEGIN(bugprone-macro-parentheses)
-
-        // no do .. while (0) here since I'd like 'break' to exit outside this block
-        // where "socket->hasError(true)" should be done
-#define CONF(member, check, convert)                      \
-    {                                                     \
-        if (!ob.contains(QStringLiteral(#member)))        \
-            break;                                        \
-        QJsonValue v = ob.value(QStringLiteral(#member)); \
-        if (!v.check())                                   \
-            break;                                        \
-        member = convert();                               \
-    }
-
-        // NOLINTEND(bugprone-macro-parentheses)
-
-        QString playerName;
-        CONF(playerName, isString, v.toString);
-
-        QString screenName;
-        CONF(screenName, isString, v.toString);
-
-        QMdmmCore::Data::AgentState agentState;
-        CONF(agentState, isDouble, CONVERTAGENTSTATE);
+        // A socket signs in once. A signed in socket may live on an IO thread already, where it must not be configured
+        // from here
+        auto connection = unauthenticatedConnections.find(socket);
+        if (connection == unauthenticatedConnections.end())
+            break;
 
-#undef CONF
-#undef CONVERTAGENTSTATE
+        // From NotifyVersion to NotifySignIn is one round trip to the client
+        // The connection is no longer reaped, its deadline is dropped when the heap gets to it
+        qint64 latency = clock.elapsed() - connection->greetedAt;
+        disconnect(connection->destroyedConnection);
+        unauthenticatedConnections.erase(connection);
 
-        // The client reports how many round events it received before a drop, so the server can
-        // replay only the events it missed (precise catch-up). A fresh sign-in omits the field and
-        // defaults to 0 -- harmless, since a fresh room has an empty round-event log.
-        int lastRoundEventSeq = 0;
-        if (ob.contains(QStringLiteral("lastRoundEventSeq"))) {
-            QJsonValue vlastRoundEventSeq = ob.value(QStringLiteral("lastRoundEventSeq"));
-            if (vlastRoundEventSeq.isDouble())
-                lastRoundEventSeq = vlastRoundEventSeq.toInt();
-        }
+        if (signIn.codec.has_value() && *signIn.codec != QMdmmCore::Protocol::CodecJson && *signIn.codec != QMdmmCore::Protocol::CodecCbor)
+            break;
+        if (signIn.framing.has_value() && *signIn.framing != Socket::FramingDelimited && *signIn.framing != Socket::FramingLengthPrefixed)
+            break;
 
-        // Reconnect path: a reconnecting player may live in ANY room, not just `current`. `current`
-        // only tracks the room currently recruiting players; full rooms keep running in the
-        // background and are deleted later on gameOver. So scan every LogicRunner child for the
-        // offline agent and reconnect it in whichever room it is found. A still-online duplicate
-        // name falls through to addAgent below, which rejects it as a spurious "new player" error.
-        const auto runners = findChildren<LogicRunner *>();
-        for (LogicRunner *runner : runners) {
-            Agent *existing = runner->agent(playerName);
-            if (existing == nullptr || existing->state().testFlag(QMdmmCore::Data::StateMaskOnline))
-                continue;
+        // The socket is configured in its own thread, before anything is sent to the player there
+        int compressionThreshold = signIn.compression.value_or(false) ? serverConfiguration.compressionThreshold() : 0;
+        QMetaObject::invokeMethod(socket, [socket, signIn, compressionThreshold]() {
+            // The codec picked by client from the ones listed in NotifyVersion. An old client omits it and stays with JSON.
+            // Switch before anything is sent to the player, since all the following packets are encoded with it.
+            if (signIn.codec.has_value())
+                socket->setCodec(static_cast<QMdmmCore::Protocol::Codec>(*signIn.codec));
+
+            // Same for the framing picked by client. It only makes difference on stream based transports.
+            if (signIn.framing.has_value())
+                socket->setFraming(static_cast<Socket::Framing>(*signIn.framing));
+
+            // A client which can unpack batch frames gets the packets sent during one event loop iteration in one frame,
+            // such as the burst of notifies when it joins a room.
+            socket->setBatching(signIn.batching.value_or(false));
+            // A batch is split at the maximum frame size of the client. An old client doesn't tell it, so a conservative size is assumed
+            if (signIn.maximumFrameSize.has_value())
+                socket->setPeerMaximumFrameSize(*signIn.maximumFrameSize);
+
+            // Only a client which can uncompress frames gets compressed ones
+            if (compressionThreshold > 0)
+                socket->setCompressionThreshold(compressionThreshold);
+        });
+
+        // Reconnect path: a reconnecting player may live in ANY room, not just a recruiting one.
+        // Full rooms keep running in the background and are deleted later on gameOver. So the room
+        // is looked up in the player index, and the offline agent is reconnected in whichever room
+        // it is found. A still-online player of the same name in any room makes this sign in a
+        // duplicate, which is rejected.
+        if (PlayerRoom room = playerRooms.value(playerName); room.runner != nullptr) {
+            LogicRunner *runner = room.runner;
+            Agent *existing = room.agent;
+            if (existing->state().testFlag(QMdmmCore::Data::StateMaskOnline))
+                break;
 
             // D-018: the socket is digested at the wire layer and the room only deals with agents,
             // so a reconnect is split across the two. Find the agent's wire plumbing, rebind the
-            // socket + replay the missed round events on it, then restore the agent's state +
-            // snapshot on the logic side.
+            // socket on it, then restore the agent's state + send the room snapshot on the logic side.
             p::ServerConnection *conn = existing->findChild<p::ServerConnection *>();
             if (conn == nullptr) {
                 // A local agent has no wire; a sign-in over the wire cannot reconnect it.
@@ -327,32 +914,24 @@ void ServerP::signIn(Socket *socket, const QJsonValue &packetValue)
                 return;
             }
 
-            conn->reconnect(socket, lastRoundEventSeq);
-            if (runner->reconnectAgent(existing) != nullptr)
+            conn->reconnect(socket);
+            if (runner->reconnectAgent(existing) != nullptr) {
+                moveToIoThread(socket, runner);
                 return;
+            }
 
             socket->setHasError(true);
             return;
         }
 
-        if (current == nullptr || current->full()) {
-            current = new LogicRunner(logicConfiguration, this);
-            connect(current, &LogicRunner::gameOver, this, &ServerP::logicRunnerGameOver);
-        }
-
-        // Assemble the agent on the operation side (network path): create the agent (identity +
-        // controller) and its wire plumbing (ServerConnection), bind the socket, then register the
-        // whole thing with the room via addAgent. The ServerConnection is a child of the agent so
-        // it travels with it; it reports socket drops as an Agent event the room listens to.
-        Agent *agent = new Agent(playerName, current);
-        agent->setScreenName(screenName);
-        agent->setState(agentState);
-        p::ServerConnection *conn = new p::ServerConnection(agent, logicConfiguration, agent);
-        conn->setSocket(socket);
-
-        if (current->addAgent(agent) == nullptr)
+        // A new player waits in the matchmaking queue, where the name is taken as well
+        if (Socket *pending = pendingPlayerNames.value(playerName, nullptr); pending != nullptr && !pending->hasError())
             break;
 
+        pendingPlayers.append(PendingPlayer {socket, playerName, signIn.screenName, signIn.agentState, latency, clock.elapsed()});
+        pendingPlayerNames.insert(playerName, socket);
+        if (!matchmakingTimer->isActive())
+            matchmakingTimer->start();
         return;
     } while (false);
 
@@ -366,15 +945,303 @@ void ServerP::observe(Socket *socket, const QJsonValue &packetValue)
     socket->setHasError(true);
 }
 
-void ServerP::introduceSocket(Socket *socket) // NOLINT(readability-make-member-function-const)
+void ServerP::introduceSocket(Socket *socket)
 {
+    // A signed in socket may be deleted on an IO thread, so nothing but the count is left to do when it is gone
+    ++connectionCount;
+    connect(socket, &QObject::destroyed, this, [this]() { --connectionCount; });
+    // A socket deletes its transport when it is disconnected, and nothing else would delete the socket before it is seated
+    connect(socket, &Socket::socketDisconnected, socket, &QObject::deleteLater);
+
+    if (int maximumConnectionCount = serverConfiguration.maximumConnectionCount(); maximumConnectionCount > 0 && connectionCount > maximumConnectionCount) {
+        ++rejectedConnectionCount;
+        socket->setHasError(true);
+        socket->deleteLater();
+        return;
+    }
+
     connect(socket, &Socket::packetReceived, this, &ServerP::socketPacketReceived);
+    socket->setMaximumFrameSize(serverConfiguration.maximumFrameSize());
+    socket->setReceiveBufferSize(serverConfiguration.receiveBufferSize());
+    socket->setOutboundLowWatermark(serverConfiguration.outboundLowWatermark());
+    socket->setOutboundHighWatermark(serverConfiguration.outboundHighWatermark());
+    socket->setMaximumOutboundSize(serverConfiguration.maximumOutboundSize());
+    // NotifySpeak is broadcast to the whole room, so it gets a limit of its own
+    socket->setInboundRateLimit(QMdmmCore::Protocol::NotifySpeak, serverConfiguration.speakRateLimit(), serverConfiguration.speakBurst());
+    socket->setDefaultInboundRateLimit(serverConfiguration.notifyRateLimit(), serverConfiguration.notifyBurst());
+
+    QMdmmCore::Protocol::VersionNotify version;
+    version.versionNumber = QMdmmCore::Global::version().toString();
+    version.protocolVersion = QMdmmCore::Protocol::version();
+    // in order of preference
+    version.codecs = QList<int> {QMdmmCore::Protocol::CodecCbor, QMdmmCore::Protocol::CodecJson};
+    version.framings = QList<int> {Socket::FramingLengthPrefixed, Socket::FramingDelimited};
+    version.batching = true;
+    version.maximumFrameSize = serverConfiguration.maximumFrameSize();
+    if (serverConfiguration.compressionThreshold() > 0)
+        version.compressionThreshold = serverConfiguration.compressionThreshold();
+    emit socket->sendPacket(QMdmmCore::Protocol::notifyPacket<QMdmmCore::Protocol::NotifyVersion>(version));
+
+    // A socket is moved to an IO thread only after signing in, so it is deleted on this thread if it never signs in.
+    // The record is dropped when signing in, so the handler never runs late for a socket at the same address
+    qint64 now = clock.elapsed();
+    quint64 serial = ++connectionSerial;
+    UnauthenticatedConnection connection {serial, {}, now, now};
+    connection.destroyedConnection = connect(socket, &QObject::destroyed, this, [this, socket, serial]() {
+        if (auto it = unauthenticatedConnections.find(socket); it != unauthenticatedConnections.end() && it->serial == serial)
+            unauthenticatedConnections.erase(it);
+    });
+    unauthenticatedConnections.insert(socket, connection);
+    if (qint64 deadline = deadlineOf(connection); deadline != -1)
+        scheduleDeadline(socket, serial, deadline);
+}
+
+qint64 ServerP::deadlineOf(const UnauthenticatedConnection &connection) const
+{
+    qint64 deadline = -1;
+    if (int signInTimeout = serverConfiguration.signInTimeout(); signInTimeout > 0)
+        deadline = connection.greetedAt + signInTimeout;
+    if (int idleTimeout = serverConfiguration.idleTimeout(); idleTimeout > 0 && (deadline == -1 || connection.activeAt + idleTimeout < deadline))
+        deadline = connection.activeAt + idleTimeout;
+    return deadline;
+}
+
+void ServerP::scheduleDeadline(Socket *socket, quint64 serial, qint64 at)
+{
+    connectionDeadlines.push(ConnectionDeadline {at, socket, serial});
+
+    // The timer is always due at the earliest deadline
+    if (connectionDeadlines.top().serial == serial && connectionDeadlines.top().at == at)
+        admissionTimer->start(static_cast<int>(std::max<qint64>(at - clock.elapsed(), 0)));
+}
+
+void ServerP::indexPlayer(Agent *agent, LogicRunner *runner)
+{
+    const QString playerName = agent->objectName();
+    playerRooms.insert(playerName, PlayerRoom {runner, agent});
+
+    // An agent is deleted when it leaves a room which is not full yet, or after its game is over. The players of a
+    // finished game are already out of the index, and the room may be hosting another game by then
+    connect(agent, &QObject::destroyed, this, [this, playerName, runner, agent]() {
+        if (playerRooms.value(playerName).agent != agent)
+            return;
+
+        playerRooms.remove(playerName);
+        for (RecruitingRoom &room : recruitingRooms) {
+            if (room.runner == runner)
+                --room.players;
+        }
+    });
+}
+
+int ServerP::recruitingRoomFor(qint64 latency)
+{
+    int latencyTolerance = serverConfiguration.latencyTolerance();
+    int best = -1;
+    int nearest = -1;
+    int recruiting = 0;
+
+    for (int n = 0; n < recruitingRooms.size(); ++n) {
+        const RecruitingRoom &room = recruitingRooms.at(n);
+        if (room.runner->full())
+            continue;
+
+        ++recruiting;
+        if (nearest == -1 || qAbs(room.latency - latency) < qAbs(recruitingRooms.at(nearest).latency - latency))
+            nearest = n;
+        // The fullest room of the latency group starts its game first
+        if ((latencyTolerance == 0 || qAbs(room.latency - latency) <= latencyTolerance) && (best == -1 || room.players > recruitingRooms.at(best).players))
+            best = n;
+    }
+
+    if (best != -1)
+        return best;
+
+    // Once enough rooms are recruiting, a player with no latency group joins the nearest one instead of waiting
+    if (nearest != -1 && recruiting >= std::max(serverConfiguration.recruitingRoomCount(), 1))
+        return nearest;
+
+    LogicRunner *runner = takeIdleRoom();
+    assignIoThread(runner);
+    recruitingRooms.append(RecruitingRoom {runner, latency, 0});
+    return recruitingRooms.size() - 1;
+}
+
+LogicRunner *ServerP::createRoom()
+{
+    auto *runner = new LogicRunner(logicConfiguration, this);
+    connect(runner, &LogicRunner::gameOver, this, &ServerP::logicRunnerGameOver);
+    return runner;
+}
+
+LogicRunner *ServerP::takeIdleRoom()
+{
+    LogicRunner *runner = nullptr;
+    if (idleRooms.isEmpty())
+        runner = createRoom();
+    else
+        runner = idleRooms.takeLast();
+
+    // The pool is filled again after the batch is seated, but only once it runs out. Until then it is filled by the
+    // finished rooms, which are reused before new ones are created
+    if (idleRooms.isEmpty() && !roomPoolFilling) {
+        roomPoolFilling = true;
+        QMetaObject::invokeMethod(this, &ServerP::fillRoomPool, Qt::QueuedConnection);
+    }
+
+    // A recruiting room records its game from the first player on
+    if (const QString journalDirectory = serverConfiguration.journalDirectory(); !journalDirectory.isEmpty()) {
+        const QString path = QDir(journalDirectory).filePath(QUuid::createUuid().toString(QUuid::WithoutBraces) + QStringLiteral(".journal"));
+        if (!runner->openJournal(path))
+            qWarning("Journal %s can't be created, the room won't be recovered", qPrintable(path));
+    }
+
+    return runner;
+}
+
+void ServerP::recoverRooms()
+{
+    const QString journalDirectory = serverConfiguration.journalDirectory();
+    if (journalDirectory.isEmpty())
+        return;
+
+    QDir directory(journalDirectory);
+    if (!directory.mkpath(QStringLiteral("."))) {
+        qWarning("Journal directory %s can't be created", qPrintable(journalDirectory));
+        return;
+    }
+
+    int recovered = 0;
+    foreach (const QString &fileName, directory.entryList(QStringList {QStringLiteral("*.journal")}, QDir::Files)) {
+        LogicRunner *runner = LogicRunner::recover(directory.filePath(fileName), this);
+        if (runner == nullptr)
+            continue;
+
+        // The players sign in again to reconnect to their seats
+        connect(runner, &LogicRunner::gameOver, this, &ServerP::logicRunnerGameOver);
+        assignIoThread(runner);
+        foreach (Agent *agent, runner->findChildren<Agent *>(Qt::FindDirectChildrenOnly))
+            indexPlayer(agent, runner);
+        ++recovered;
+    }
+
+    if (recovered > 0)
+        qInfo("Recovered %d rooms from %s", recovered, qPrintable(journalDirectory));
+}
+
+void ServerP::recycleRoom(LogicRunner *runner)
+{
+    if (idleRooms.contains(runner))
+        return;
+
+    if (idleRooms.size() >= serverConfiguration.roomPoolSize()) {
+        runner->deleteLater();
+        return;
+    }
+
+    runner->reset();
+    idleRooms.append(runner);
+}
+
+bool ServerP::seatPlayer(const PendingPlayer &player, RecruitingRoom &room)
+{
+    // Assemble the agent on the operation side (network path): create the agent (identity +
+    // controller) and its wire plumbing (ServerConnection), bind the socket, then register the
+    // whole thing with the room via addAgent. The ServerConnection is a child of the agent so
+    // it travels with it; it reports socket drops as an Agent event the room listens to.
+    Agent *agent = new Agent(player.playerName, room.runner);
+    agent->setScreenName(player.screenName);
+    agent->setState(player.agentState);
+    p::ServerConnection *conn = new p::ServerConnection(agent, logicConfiguration, agent);
+    conn->setSocket(player.socket);
+
+    if (room.runner->addAgent(agent) == nullptr)
+        return false;
+
+    ++room.players;
+    indexPlayer(agent, room.runner);
+    moveToIoThread(player.socket, room.runner);
+    return true;
+}
+
+void ServerP::recordWaitTime(qint64 waitTime)
+{
+    if (waitTimes.size() < waitTimeSampleCount)
+        waitTimes.append(waitTime);
+    else
+        waitTimes[nextWaitTime] = waitTime;
+    nextWaitTime = (nextWaitTime + 1) % waitTimeSampleCount;
+}
+
+qint64 ServerP::waitTime(int percentile) const
+{
+    if (waitTimes.isEmpty())
+        return 0;
+
+    QList<qint64> sorted = waitTimes;
+    auto nth = sorted.begin() + (sorted.size() - 1) * std::clamp(percentile, 0, 100) / 100;
+    std::nth_element(sorted.begin(), nth, sorted.end());
+    return *nth;
+}
+
+QList<qint64> ServerP::waitTimePercentiles(std::initializer_list<int> percentiles) const
+{
+    QList<qint64> ret;
+    if (waitTimes.isEmpty()) {
+        ret.fill(0, static_cast<qsizetype>(percentiles.size()));
+        return ret;
+    }
+
+    // Sorted once for all of them
+    QList<qint64> sorted = waitTimes;
+    std::sort(sorted.begin(), sorted.end());
+    for (int percentile : percentiles)
+        ret << sorted.at((sorted.size() - 1) * std::clamp(percentile, 0, 100) / 100);
+    return ret;
+}
+
+void ServerP::assignIoThread(LogicRunner *runner)
+{
+    if (ioThreads.isEmpty())
+        return;
+
+    int leastLoaded = 0;
+    for (int n = 1; n < ioThreads.size(); ++n) {
+        if (ioThreads.at(n).rooms < ioThreads.at(leastLoaded).rooms)
+            leastLoaded = n;
+    }
+
+    ++ioThreads[leastLoaded].rooms;
+    roomIoThreads.insert(runner, leastLoaded);
+}
+
+void ServerP::moveToIoThread(Socket *socket, LogicRunner *runner)
+{
+    int n = roomIoThreads.value(runner, -1);
+    if (n == -1 || (socket->type() != Socket::TypeQTcpSocket && socket->type() != Socket::TypeEpoll))
+        return;
 
-    QJsonObject ob;
-    ob.insert(QStringLiteral("versionNumber"), QMdmmCore::Global::version().toString());
-    ob.insert(QStringLiteral("protocolVersion"), QMdmmCore::Protocol::version());
-    QMdmmCore::Packet packet(QMdmmCore::Protocol::NotifyVersion, ob);
-    emit socket->sendPacket(packet);
+    // The sign in is handled in a read callback of the socket, which must return before the socket is moved.
+    // Packets received until then are handled here as usual
+    QPointer<Socket> s = socket;
+    QObject *sockets = ioThreads.at(n).sockets;
+    QMetaObject::invokeMethod(
+        this,
+        [s, sockets]() {
+            if (s == nullptr)
+                return;
+
+            s->setParent(nullptr);
+            s->moveToThread(sockets->thread());
+            QMetaObject::invokeMethod(
+                sockets,
+                [s, sockets]() {
+                    if (s != nullptr)
+                        s->setParent(sockets);
+                },
+                Qt::QueuedConnection);
+        },
+        Qt::QueuedConnection);
 }
 
 void ServerP::tcpServerNewConnection()
@@ -386,6 +1253,12 @@ void ServerP::tcpServerNewConnection()
     }
 }
 
+void ServerP::epollListenerNewConnection(qintptr socketDescriptor)
+{
+    Socket *mdmmSocket = new Socket(Socket::TypeEpoll, socketDescriptor, this);
+    introduceSocket(mdmmSocket);
+}
+
 void ServerP::localServerNewConnection()
 {
     while (l->hasPendingConnections()) {
@@ -395,6 +1268,12 @@ void ServerP::localServerNewConnection()
     }
 }
 
+void ServerP::inProcessServerNewConnection(Socket *socket)
+{
+    socket->setParent(this);
+    introduceSocket(socket);
+}
+
 void ServerP::websocketServerNewConnection()
 {
     while (w->hasPendingConnections()) {
@@ -411,10 +1290,13 @@ void ServerP::socketPacketReceived(const QMdmmCore::Packet &packet)
     if (socket == nullptr)
         return;
 
+    if (auto it = unauthenticatedConnections.find(socket); it != unauthenticatedConnections.end())
+        it->activeAt = clock.elapsed();
+
     if (packet.type() == QMdmmCore::Protocol::TypeNotify) {
         if ((packet.notifyId() & QMdmmCore::Protocol::NotifyToServerMask) != 0) {
             // These packages should be processed in Server
-            void (ServerP::*call)(Socket *, const QJsonValue &) = notifyCallback.value(packet.notifyId(), nullptr);
+            void (ServerP::*call)(Socket *, const QJsonValue &) = notifyCallback.value(packet.notifyId());
             if (call != nullptr)
                 (this->*call)(socket, packet.value());
             else
@@ -423,13 +1305,118 @@ void ServerP::socketPacketReceived(const QMdmmCore::Packet &packet)
     }
 }
 
+void ServerP::formRooms()
+{
+    QList<PendingPlayer> batch;
+    batch.swap(pendingPlayers);
+    pendingPlayerNames.clear();
+
+    // Players of close latencies come one after another, so that they are seated in the same rooms
+    if (serverConfiguration.latencyTolerance() > 0)
+        std::stable_sort(batch.begin(), batch.end(), [](const PendingPlayer &a, const PendingPlayer &b) -> bool { return a.latency < b.latency; });
+
+    int seated = 0;
+    QSet<Socket *> seatedSockets;
+    seatedSockets.reserve(batch.size());
+    foreach (const PendingPlayer &player, batch) {
+        // disconnected while waiting
+        if (player.socket == nullptr || player.socket->hasError())
+            continue;
+
+        // A socket signs in only once (see signIn), but a socket must never take two seats even if it were queued twice
+        if (seatedSockets.contains(player.socket.data()))
+            continue;
+        seatedSockets.insert(player.socket.data());
+
+        if (!seatPlayer(player, recruitingRooms[recruitingRoomFor(player.latency)])) {
+            player.socket->setHasError(true);
+            continue;
+        }
+
+        recordWaitTime(clock.elapsed() - player.enqueuedAt);
+        ++seated;
+    }
+
+    // A full room stops recruiting
+    recruitingRooms.removeIf([](const RecruitingRoom &room) -> bool { return room.runner->full(); });
+
+    // The wait times are only sorted when they are logged
+    if (seated > 0 && QLoggingCategory::defaultCategory()->isDebugEnabled()) {
+        const QList<qint64> percentiles = waitTimePercentiles({50, 90, 99});
+        qDebug("Matchmaking seated %d players in %lld recruiting rooms, wait time 50%% %lld ms, 90%% %lld ms, 99%% %lld ms", seated,
+               static_cast<long long>(recruitingRooms.size()), static_cast<long long>(percentiles.at(0)), static_cast<long long>(percentiles.at(1)),
+               static_cast<long long>(percentiles.at(2)));
+    }
+}
+
+void ServerP::fillRoomPool()
+{
+    roomPoolFilling = false;
+    while (idleRooms.size() < serverConfiguration.roomPoolSize())
+        idleRooms.append(createRoom());
+}
+
+void ServerP::reapConnections()
+{
+    qint64 now = clock.elapsed();
+    QList<Socket *> expired;
+
+    while (!connectionDeadlines.empty() && connectionDeadlines.top().at <= now) {
+        ConnectionDeadline top = connectionDeadlines.top();
+        connectionDeadlines.pop();
+
+        // signed in or deleted since
+        auto it = unauthenticatedConnections.find(top.socket);
+        if (it == unauthenticatedConnections.end() || it->serial != top.serial)
+            continue;
+
+        // A packet received since moved the deadline, which is pushed again instead
+        if (qint64 deadline = deadlineOf(*it); deadline > now) {
+            connectionDeadlines.push(ConnectionDeadline {deadline, top.socket, top.serial});
+            continue;
+        }
+
+        disconnect(it->destroyedConnection);
+        unauthenticatedConnections.erase(it);
+        expired << top.socket;
+    }
+
+    if (!connectionDeadlines.empty())
+        admissionTimer->start(static_cast<int>(connectionDeadlines.top().at - now));
+
+    foreach (Socket *socket, expired) {
+        ++reapedConnectionCount;
+        socket->setHasError(true);
+        socket->deleteLater();
+    }
+
+    if (!expired.isEmpty())
+        qDebug("Closed %lld connections which did not sign in in time", static_cast<long long>(expired.size()));
+}
+
 void ServerP::logicRunnerGameOver()
 {
     if (LogicRunner *runner = qobject_cast<LogicRunner *>(sender()); runner != nullptr) {
-        if (current == runner)
-            current = nullptr;
+        recruitingRooms.removeIf([runner](const RecruitingRoom &room) -> bool { return room.runner == runner; });
 
-        runner->deleteLater();
+        // The players of a finished game may sign in to a new one before the room is recycled
+        foreach (Agent *agent, runner->findChildren<Agent *>(Qt::FindDirectChildrenOnly)) {
+            if (playerRooms.value(agent->objectName()).agent == agent)
+                playerRooms.remove(agent->objectName());
+        }
+
+        if (roomIoThreads.contains(runner))
+            --ioThreads[roomIoThreads.take(runner)].rooms;
+
+        // gameOver is emitted while the room is still handling the end of its game
+        QPointer<LogicRunner> r = runner;
+        QMetaObject::invokeMethod(
+            this,
+            [this, r]() {
+                if (r != nullptr)
+                    recycleRoom(r);
+            },
+            Qt::QueuedConnection);
     }
 }
 
@@ -446,6 +1433,15 @@ namespace v0 {
  *
  * The server listens on the configured transports (TCP / local socket / WebSocket) and,
  * once enough players sign in, starts a @c LogicRunner for a complete game.
+ *
+ * A new player waits in the matchmaking queue, which is seated in the recruiting rooms in batches (see
+ * @c ServerConfiguration::matchmakingInterval ). Players can be grouped by their sign in round trips (see
+ * @c ServerConfiguration::latencyTolerance ).
+ *
+ * The games can be journaled, so that they survive a restart of the server (see @c ServerConfiguration::journalDirectory ).
+ *
+ * Connections are admitted up to @c ServerConfiguration::maximumConnectionCount , and a connection which doesn't sign in
+ * in time is closed (see @c ServerConfiguration::signInTimeout and @c ServerConfiguration::idleTimeout ).
  */
 
 /**
@@ -460,18 +1456,89 @@ Server::Server(ServerConfiguration serverConfiguration, QMdmmCore::LogicConfigur
 {
 }
 
+/**
+ * @brief The number of players waiting in the matchmaking queue
+ * @return the number of players signed in but not seated in a room yet
+ */
+int Server::pendingPlayerCount() const
+{
+    return d->pendingPlayers.size();
+}
+
+/**
+ * @brief A percentile of the time players wait in the matchmaking queue
+ * @param percentile 0 to 100, e.g. 50 for the median and 99 for the 99th percentile
+ * @return the wait time in milliseconds among the latest 1024 seated players, 0 before any player is seated
+ *
+ * The 50th, 90th and 99th percentiles are also reported via @c qDebug() after each batch.
+ */
+qint64 Server::queueWaitTime(int percentile) const
+{
+    return d->waitTime(percentile);
+}
+
+/**
+ * @brief The number of connections being served
+ * @return the number of connections accepted and not closed yet, including the ones of seated players
+ */
+int Server::connectionCount() const
+{
+    return d->connectionCount;
+}
+
+/**
+ * @brief The number of connections which have not signed in
+ * @return the number of connections waiting for their sign in, which are closed at
+ *         @c ServerConfiguration::signInTimeout or @c ServerConfiguration::idleTimeout
+ */
+int Server::unauthenticatedConnectionCount() const
+{
+    return static_cast<int>(d->unauthenticatedConnections.size());
+}
+
+/**
+ * @brief The number of connections closed for being over @c ServerConfiguration::maximumConnectionCount
+ * @return the number since the server is created
+ */
+qint64 Server::rejectedConnectionCount() const
+{
+    return d->rejectedConnectionCount;
+}
+
+/**
+ * @brief The number of connections closed for not signing in in time
+ * @return the number since the server is created
+ */
+qint64 Server::reapedConnectionCount() const
+{
+    return d->reapedConnectionCount;
+}
+
 /**
  * @brief Start listening on all enabled transports
  * @return @c true if all enabled transports are listening successfully
+ *
+ * TCP and WebSocket are encrypted with TLS when @c ServerConfiguration::tlsCertificate is set, in which case listening
+ * fails if the certificate or its private key can't be loaded.
  */
 bool Server::listen()
 {
+    // An encrypted transport can't be served without its certificate
+    if (d->tlsEnabled && d->sslConfiguration.isNull())
+        return false;
+
     bool ret = true;
 
-    if (d->serverConfiguration.tcpEnabled())
+#ifdef Q_OS_LINUX
+    if (d->e != nullptr)
+        ret = d->e->listen(d->serverConfiguration.tcpPort()) && ret;
+#endif
+    if (d->t != nullptr)
         ret = d->t->listen(QHostAddress::Any, d->serverConfiguration.tcpPort()) && ret;
     if (d->serverConfiguration.localEnabled())
         ret = d->l->listen(d->serverConfiguration.localSocketName()) && ret;
+    if (d->serverConfiguration.inProcessEnabled())
+        ret = d->i->listen(d->serverConfiguration.inProcessName()) && ret;
     if (d->serverConfiguration.websocketEnabled())
         ret = d->w->listen(QHostAddress::Any, d->serverConfiguration.websocketPort()) && ret;
 
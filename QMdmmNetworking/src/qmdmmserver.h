@@ -33,12 +33,36 @@ struct QMDMMNETWORKING_EXPORT ServerConfiguration final : public QJsonObject
 {
     Q_GADGET
     Q_PROPERTY(bool tcpEnabled READ tcpEnabled WRITE setTcpEnabled DESIGNABLE false FINAL)
+    Q_PROPERTY(bool epollEnabled READ epollEnabled WRITE setEpollEnabled DESIGNABLE false FINAL)
     Q_PROPERTY(uint16_t tcpPort READ tcpPort WRITE setTcpPort DESIGNABLE false FINAL)
     Q_PROPERTY(bool localEnabled READ localEnabled WRITE setLocalEnabled DESIGNABLE false FINAL)
     Q_PROPERTY(QString localSocketName READ localSocketName WRITE setLocalSocketName DESIGNABLE false FINAL)
     Q_PROPERTY(bool websocketEnabled READ websocketEnabled WRITE setWebsocketEnabled DESIGNABLE false FINAL)
     Q_PROPERTY(QString websocketName READ websocketName WRITE setWebsocketName DESIGNABLE false FINAL)
     Q_PROPERTY(uint16_t websocketPort READ websocketPort WRITE setWebsocketPort DESIGNABLE false FINAL)
+    Q_PROPERTY(bool inProcessEnabled READ inProcessEnabled WRITE setInProcessEnabled DESIGNABLE false FINAL)
+    Q_PROPERTY(QString inProcessName READ inProcessName WRITE setInProcessName DESIGNABLE false FINAL)
+    Q_PROPERTY(int maximumFrameSize READ maximumFrameSize WRITE setMaximumFrameSize DESIGNABLE false FINAL)
+    Q_PROPERTY(int receiveBufferSize READ receiveBufferSize WRITE setReceiveBufferSize DESIGNABLE false FINAL)
+    Q_PROPERTY(int compressionThreshold READ compressionThreshold WRITE setCompressionThreshold DESIGNABLE false FINAL)
+    Q_PROPERTY(int outboundLowWatermark READ outboundLowWatermark WRITE setOutboundLowWatermark DESIGNABLE false FINAL)
+    Q_PROPERTY(int outboundHighWatermark READ outboundHighWatermark WRITE setOutboundHighWatermark DESIGNABLE false FINAL)
+    Q_PROPERTY(int maximumOutboundSize READ maximumOutboundSize WRITE setMaximumOutboundSize DESIGNABLE false FINAL)
+    Q_PROPERTY(int speakRateLimit READ speakRateLimit WRITE setSpeakRateLimit DESIGNABLE false FINAL)
+    Q_PROPERTY(int speakBurst READ speakBurst WRITE setSpeakBurst DESIGNABLE false FINAL)
+    Q_PROPERTY(int notifyRateLimit READ notifyRateLimit WRITE setNotifyRateLimit DESIGNABLE false FINAL)
+    Q_PROPERTY(int notifyBurst READ notifyBurst WRITE setNotifyBurst DESIGNABLE false FINAL)
+    Q_PROPERTY(QString tlsCertificate READ tlsCertificate WRITE setTlsCertificate DESIGNABLE false FINAL)
+    Q_PROPERTY(QString tlsPrivateKey READ tlsPrivateKey WRITE setTlsPrivateKey DESIGNABLE false FINAL)
+    Q_PROPERTY(int ioThreadCount READ ioThreadCount WRITE setIoThreadCount DESIGNABLE false FINAL)
+    Q_PROPERTY(int matchmakingInterval READ matchmakingInterval WRITE setMatchmakingInterval DESIGNABLE false FINAL)
+    Q_PROPERTY(int recruitingRoomCount READ recruitingRoomCount WRITE setRecruitingRoomCount DESIGNABLE false FINAL)
+    Q_PROPERTY(int latencyTolerance READ latencyTolerance WRITE setLatencyTolerance DESIGNABLE false FINAL)
+    Q_PROPERTY(int roomPoolSize READ roomPoolSize WRITE setRoomPoolSize DESIGNABLE false FINAL)
+    Q_PROPERTY(QString journalDirectory READ journalDirectory WRITE setJournalDirectory DESIGNABLE false FINAL)
+    Q_PROPERTY(int maximumConnectionCount READ maximumConnectionCount WRITE setMaximumConnectionCount DESIGNABLE false FINAL)
+    Q_PROPERTY(int signInTimeout READ signInTimeout WRITE setSignInTimeout DESIGNABLE false FINAL)
+    Q_PROPERTY(int idleTimeout READ idleTimeout WRITE setIdleTimeout DESIGNABLE false FINAL)
 
 public:
     static QMDMMNETWORKING_EXPORT const ServerConfiguration &defaults();
@@ -53,6 +77,8 @@ public:
 
     [[nodiscard]] bool tcpEnabled() const;
     void setTcpEnabled(bool tcpEnabled);
+    [[nodiscard]] bool epollEnabled() const;
+    void setEpollEnabled(bool epollEnabled);
     [[nodiscard]] uint16_t tcpPort() const;
     void setTcpPort(uint16_t tcpPort);
     [[nodiscard]] bool localEnabled() const;
@@ -65,6 +91,52 @@ public:
     void setWebsocketName(const QString &websocketName);
     [[nodiscard]] uint16_t websocketPort() const;
     void setWebsocketPort(uint16_t websocketPort);
+    [[nodiscard]] bool inProcessEnabled() const;
+    void setInProcessEnabled(bool inProcessEnabled);
+    [[nodiscard]] QString inProcessName() const;
+    void setInProcessName(const QString &inProcessName);
+    [[nodiscard]] int maximumFrameSize() const;
+    void setMaximumFrameSize(int maximumFrameSize);
+    [[nodiscard]] int receiveBufferSize() const;
+    void setReceiveBufferSize(int receiveBufferSize);
+    [[nodiscard]] int compressionThreshold() const;
+    void setCompressionThreshold(int compressionThreshold);
+    [[nodiscard]] int outboundLowWatermark() const;
+    void setOutboundLowWatermark(int outboundLowWatermark);
+    [[nodiscard]] int outboundHighWatermark() const;
+    void setOutboundHighWatermark(int outboundHighWatermark);
+    [[nodiscard]] int maximumOutboundSize() const;
+    void setMaximumOutboundSize(int maximumOutboundSize);
+    [[nodiscard]] int speakRateLimit() const;
+    void setSpeakRateLimit(int speakRateLimit);
+    [[nodiscard]] int speakBurst() const;
+    void setSpeakBurst(int speakBurst);
+    [[nodiscard]] int notifyRateLimit() const;
+    void setNotifyRateLimit(int notifyRateLimit);
+    [[nodiscard]] int notifyBurst() const;
+    void setNotifyBurst(int notifyBurst);
+    [[nodiscard]] QString tlsCertificate() const;
+    void setTlsCertificate(const QString &tlsCertificate);
+    [[nodiscard]] QString tlsPrivateKey() const;
+    void setTlsPrivateKey(const QString &tlsPrivateKey);
+    [[nodiscard]] int ioThreadCount() const;
+    void setIoThreadCount(int ioThreadCount);
+    [[nodiscard]] int matchmakingInterval() const;
+    void setMatchmakingInterval(int matchmakingInterval);
+    [[nodiscard]] int recruitingRoomCount() const;
+    void setRecruitingRoomCount(int recruitingRoomCount);
+    [[nodiscard]] int latencyTolerance() const;
+    void setLatencyTolerance(int latencyTolerance);
+    [[nodiscard]] int roomPoolSize() const;
+    void setRoomPoolSize(int roomPoolSize);
+    [[nodiscard]] QString journalDirectory() const;
+    void setJournalDirectory(const QString &journalDirectory);
+    [[nodiscard]] int maximumConnectionCount() const;
+    void setMaximumConnectionCount(int maximumConnectionCount);
+    [[nodiscard]] int signInTimeout() const;
+    void setSignInTimeout(int signInTimeout);
+    [[nodiscard]] int idleTimeout() const;
+    void setIdleTimeout(int idleTimeout);
 };
 
 class QMDMMNETWORKING_EXPORT Server : public QObject
@@ -77,6 +149,13 @@ public:
     explicit Server(ServerConfiguration serverConfiguration, QMdmmCore::LogicConfiguration logicConfiguration, QObject *parent = nullptr);
     ~Server() override;
 
+    [[nodiscard]] int pendingPlayerCount() const;
+    [[nodiscard]] qint64 queueWaitTime(int percentile) const;
+    [[nodiscard]] int connectionCount() const;
+    [[nodiscard]] int unauthenticatedConnectionCount() const;
+    [[nodiscard]] qint64 rejectedConnectionCount() const;
+    [[nodiscard]] qint64 reapedConnectionCount() const;
+
 public slots: // NOLINT(readability-redundant-access-specifiers)
     bool listen();
 
@@ -15,22 +15,41 @@
 #include <QLocalServer>
 #include <QObject>
 #include <QPointer>
+#include <QSslConfiguration>
+#include <QElapsedTimer>
 #include <QTcpServer>
+#include <QThread>
+#include <QTimer>
 #include <QWebSocketServer>
 
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <queue>
+#include <vector>
+
 // NOLINTBEGIN(misc-non-private-member-variables-in-classes): This is private header
 
 namespace QMdmmNetworking {
 namespace p {
 
+class EpollListener;
+class InProcessServer;
+class LogicWorkerPool;
+
 class QMDMMNETWORKING_PRIVATE_EXPORT ServerP final : public QObject
 {
     Q_OBJECT
 
-    static QHash<QMdmmCore::Protocol::NotifyId, void (ServerP::*)(Socket *, const QJsonValue &)> notifyCallback;
+    static QMdmmCore::Protocol::DispatchTable<QMdmmCore::Protocol::NotifyId, void (ServerP::*)(Socket *, const QJsonValue &)> notifyCallback;
 
 public:
     ServerP(ServerConfiguration serverConfiguration, QMdmmCore::LogicConfiguration logicConfiguration, Server *q);
+    ~ServerP() override;
+
+    // The TLS configuration from the certificate and the private key in the server configuration.
+    // A null configuration if either can't be loaded
+    static QSslConfiguration loadSslConfiguration(const QString &certificatePath, const QString &privateKeyPath);
 
     // callbacks
     void pingServer(Socket *socket, const QJsonValue &packetValue);
@@ -39,13 +58,91 @@ public:
 
     void introduceSocket(Socket *socket);
 
+    // Admission (see ServerConfiguration::maximumConnectionCount, signInTimeout and idleTimeout). A connection over the
+    // limit is closed when it is accepted. Every connection which has not signed in has a deadline in one heap, served
+    // by one timer; a packet only moves the deadline in the record of its connection, which is checked when the heap
+    // gets to it. A socket accepted later may be allocated at the address of a deleted one, so a record is told apart by
+    // the serial of its connection
+    struct UnauthenticatedConnection
+    {
+        quint64 serial;
+        // removes the record when the socket is deleted before signing in
+        QMetaObject::Connection destroyedConnection;
+        // when NotifyVersion is sent
+        qint64 greetedAt;
+        // when the latest packet is received
+        qint64 activeAt;
+    };
+    struct ConnectionDeadline
+    {
+        qint64 at;
+        // only a key of unauthenticatedConnections, it may be gone
+        Socket *socket;
+        quint64 serial;
+
+        bool operator>(const ConnectionDeadline &other) const noexcept
+        {
+            return at > other.at;
+        }
+    };
+    [[nodiscard]] qint64 deadlineOf(const UnauthenticatedConnection &connection) const;
+    void scheduleDeadline(Socket *socket, quint64 serial, qint64 at);
+
+    // IO threads (see ServerConfiguration::ioThreadCount). A new room is assigned to the IO thread serving the fewest
+    // rooms, and the socket of a player is moved to the IO thread of its room after signing in, so packets of a room are
+    // parsed, encoded and written on one thread. Only TCP sockets are moved
+    void assignIoThread(LogicRunner *runner);
+    void moveToIoThread(Socket *socket, LogicRunner *runner);
+
+    void indexPlayer(Agent *agent, LogicRunner *runner);
+
+    // Matchmaking (see ServerConfiguration::matchmakingInterval). A new player is queued, and every batch of the queue is
+    // seated in the recruiting rooms, which are opened when needed
+    struct PendingPlayer
+    {
+        QPointer<Socket> socket;
+        QString playerName;
+        QString screenName;
+        QMdmmCore::Data::AgentState agentState;
+        // sign in round trip in milliseconds
+        qint64 latency;
+        qint64 enqueuedAt;
+    };
+    struct RecruitingRoom
+    {
+        LogicRunner *runner;
+        // sign in round trip of the first player, the center of its latency group
+        qint64 latency;
+        int players;
+    };
+    int recruitingRoomFor(qint64 latency);
+    bool seatPlayer(const PendingPlayer &player, RecruitingRoom &room);
+    void recordWaitTime(qint64 waitTime);
+    [[nodiscard]] qint64 waitTime(int percentile) const;
+    [[nodiscard]] QList<qint64> waitTimePercentiles(std::initializer_list<int> percentiles) const;
+
+    // Idle rooms (see ServerConfiguration::roomPoolSize). A recruiting room is taken from them, and a finished room is
+    // reset and returned to them. They are created again only when all of them are taken
+    LogicRunner *createRoom();
+    LogicRunner *takeIdleRoom();
+    void recycleRoom(LogicRunner *runner);
+
+    // Crash recovery (see ServerConfiguration::journalDirectory). A room taken from the pool keeps a journal of its game,
+    // and the rooms in the journals left by the last run are rebuilt when the server starts
+    void recoverRooms();
+
 public slots: // NOLINT(readability-redundant-access-specifiers)
     void tcpServerNewConnection();
+    void epollListenerNewConnection(qintptr socketDescriptor);
     void localServerNewConnection();
+    void inProcessServerNewConnection(QMdmmNetworking::Socket *socket);
     void websocketServerNewConnection();
     void socketPacketReceived(const QMdmmCore::Packet &packet);
 
+    void formRooms();
+    void fillRoomPool();
     void logicRunnerGameOver();
+    void reapConnections();
 
 public: // NOLINT(readability-redundant-access-specifiers)
     // variables
@@ -53,9 +150,55 @@ public: // NOLINT(readability-redundant-access-specifiers)
     QMdmmCore::LogicConfiguration logicConfiguration;
     Server *q;
     QTcpServer *t;
+    // serves TCP instead of t with the epoll backend
+    EpollListener *e;
     QLocalServer *l;
+    InProcessServer *i;
     QWebSocketServer *w;
-    LogicRunner *current;
+    // The room of every player in every room, by player name. A player leaves it when its agent is deleted or its game
+    // is over, so a sign in finds a player to reconnect, or a duplicate name, without visiting the rooms
+    struct PlayerRoom
+    {
+        LogicRunner *runner = nullptr;
+        Agent *agent = nullptr;
+    };
+    QHash<QString, PlayerRoom> playerRooms;
+    // TCP and WebSocket are encrypted when a certificate is configured
+    bool tlsEnabled;
+    QSslConfiguration sslConfiguration;
+
+    struct IoThread
+    {
+        QThread *thread;
+        // lives in thread, the parent of the sockets moved there
+        QObject *sockets;
+        int rooms;
+    };
+    QList<IoThread> ioThreads;
+    QHash<LogicRunner *, int> roomIoThreads;
+
+    // since the server is created, for sign in round trips, deadlines of connections and waits in the matchmaking queue
+    QElapsedTimer clock;
+    QHash<Socket *, UnauthenticatedConnection> unauthenticatedConnections;
+    std::priority_queue<ConnectionDeadline, std::vector<ConnectionDeadline>, std::greater<>> connectionDeadlines;
+    QTimer *admissionTimer;
+    int connectionCount;
+    quint64 connectionSerial;
+    qint64 rejectedConnectionCount;
+    qint64 reapedConnectionCount;
+    QList<PendingPlayer> pendingPlayers;
+    QHash<QString, QPointer<Socket>> pendingPlayerNames;
+    QList<RecruitingRoom> recruitingRooms;
+    QTimer *matchmakingTimer;
+    // wait times of the latest seated players, in milliseconds
+    static constexpr int waitTimeSampleCount = 1024;
+    QList<qint64> waitTimes;
+    int nextWaitTime;
+
+    QList<LogicRunner *> idleRooms;
+    bool roomPoolFilling;
+    // held so that the workers are drained when the server is deleted, after its rooms
+    std::shared_ptr<LogicWorkerPool> workerPool;
 };
 
 } // namespace p
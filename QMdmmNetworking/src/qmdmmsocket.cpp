@@ -1,10 +1,20 @@
 // SPDX-License-Identifier: AGPL-3.0-or-later
 
 #include "qmdmmsocket.h"
+#include "qmdmmepoll_p.h"
 #include "qmdmmsocket_p.h"
 
+#include <QCborStreamReader>
+#include <QHash>
 #include <QLocalSocket>
+#include <QMutex>
+#include <QSslSocket>
 #include <QTcpSocket>
+#include <QThread>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
 
 /**
  * @file qmdmmsocket.h
@@ -38,14 +48,117 @@ SocketP *create(Socket::Type type, Socket *p)
         return new SocketP_QLocalSocket(p);
     case Socket::TypeQWebSocket:
         return new SocketP_QWebSocket(p);
+#ifdef Q_OS_LINUX
+    case Socket::TypeEpoll:
+        return new SocketP_Epoll(p);
+#endif
+    case Socket::TypeInProcess:
+        return new SocketP_InProcess(p);
     default:
         break;
     }
 
     return nullptr;
 }
+
+SocketP *create(Socket::Type type, qintptr socketDescriptor, Socket *p)
+{
+#ifdef Q_OS_LINUX
+    if (type == Socket::TypeEpoll)
+        return new SocketP_Epoll(static_cast<int>(socketDescriptor), p);
+#else
+    Q_UNUSED(type);
+    Q_UNUSED(socketDescriptor);
+    Q_UNUSED(p);
+#endif
+
+    return nullptr;
+}
 } // namespace SocketPFactory
 
+ReceiveBuffer::ReceiveBuffer()
+    : head(0)
+    , tail(0)
+{
+}
+
+QByteArray ReceiveBuffer::unread() const
+{
+    return QByteArray::fromRawData(storage.constData() + head, tail - head);
+}
+
+char *ReceiveBuffer::reserve(qsizetype size)
+{
+    if (storage.size() - tail < size) {
+        if (head != 0) {
+            std::memmove(storage.data(), storage.constData() + head, tail - head);
+            tail -= head;
+            head = 0;
+        }
+        if (storage.size() - tail < size)
+            storage.resize(std::max<qsizetype>({storage.size() * 2, tail + size, initialCapacity}));
+    }
+
+    return storage.data() + tail;
+}
+
+void ReceiveBuffer::commit(qsizetype size)
+{
+    tail += size;
+}
+
+void ReceiveBuffer::consume(qsizetype size)
+{
+    head += size;
+    if (head == tail) {
+        head = 0;
+        tail = 0;
+    }
+}
+
+void ReceiveBuffer::clear()
+{
+    head = 0;
+    tail = 0;
+}
+
+void ReceiveBuffer::squeeze()
+{
+    if (head == tail && storage.size() > initialCapacity)
+        storage = QByteArray();
+}
+
+TokenBucket::TokenBucket()
+    : TokenBucket(0, 0)
+{
+}
+
+TokenBucket::TokenBucket(int rate, int burst)
+    : rate(rate)
+    , burst(std::max(burst, 1))
+    , tokens(std::max(burst, 1))
+    , last(-1)
+{
+}
+
+bool TokenBucket::take(qint64 now)
+{
+    if (last >= 0)
+        tokens = std::min<double>(burst, tokens + (static_cast<double>(now - last) * rate / 1000));
+    last = now;
+
+    if (tokens < 1)
+        return false;
+
+    tokens -= 1;
+    return true;
+}
+
+void SocketP::attach(Socket *socket, SocketP *d)
+{
+    socket->d = d;
+}
+
 Socket::Type SocketP::typeByConnectAddr(const QString &addr)
 {
     QUrl u(addr);
@@ -55,6 +168,8 @@ Socket::Type SocketP::typeByConnectAddr(const QString &addr)
         return Socket::TypeQTcpSocket;
     if (u.scheme() == QStringLiteral("ws") || u.scheme() == QStringLiteral("wss"))
         return Socket::TypeQWebSocket;
+    if (u.scheme() == QStringLiteral("inproc"))
+        return Socket::TypeInProcess;
 
     return Socket::TypeUnknown;
 }
@@ -63,15 +178,410 @@ SocketP::SocketP(Socket *q)
     : QObject(q)
     , q(q)
     , hasError(false)
+    , codec(QMdmmCore::Protocol::CodecJson)
+    , framing(Socket::FramingDelimited)
+    , maximumFrameSize(defaultMaximumFrameSize)
+    , peerMaximumFrameSize(defaultPeerMaximumFrameSize)
+    , receiveBufferSize(defaultReceiveBufferSize)
+    , delimiterScanned(0)
+    , batching(false)
+    , pendingBytes(0)
+    , compressionThreshold(0)
+    , compressedFrameCount(0)
+    , compressionInputSize(0)
+    , compressionOutputSize(0)
+    , uncompressedFrameCount(0)
+    , compressionTime(0)
+    , uncompressionTime(0)
+    , outboundLowWatermark(0)
+    , outboundHighWatermark(0)
+    , maximumOutboundSize(0)
+    , congested(false)
+    , droppedPacketCount(0)
+    , rateLimitedPacketCount(0)
 {
     connect(q, &Socket::sendPacket, this, &SocketP::sendPacket);
 }
 
+void SocketP::writeFrameHeader(char *header, uint8_t flags, qsizetype size)
+{
+    qToBigEndian<quint32>((static_cast<quint32>(flags) << 24) | static_cast<quint32>(size), header);
+}
+
+qint64 SocketP::outboundQueueDepth() const
+{
+    return pendingBytes + bytesToWrite();
+}
+
+void SocketP::discardOutbound()
+{
+    pendingPackets.clear();
+    pendingBytes = 0;
+}
+
+bool SocketP::isDroppable(const QMdmmCore::Packet &packet)
+{
+    // Chats and operations of other players are not needed to play the game
+    if (packet.type() != QMdmmCore::Protocol::TypeNotify)
+        return false;
+    return packet.notifyId() == QMdmmCore::Protocol::NotifySpoken || packet.notifyId() == QMdmmCore::Protocol::NotifyOperated;
+}
+
+bool SocketP::acceptInbound(const QMdmmCore::Packet &packet)
+{
+    if (packet.type() != QMdmmCore::Protocol::TypeNotify)
+        return true;
+
+    TokenBucket *bucket = &defaultInboundBucket;
+    if (QHash<int, RateLimit>::const_iterator limit = inboundRateLimits.constFind(packet.notifyId()); limit != inboundRateLimits.constEnd()) {
+        if (limit->rate <= 0)
+            return true;
+
+        QHash<int, TokenBucket>::iterator it = inboundBuckets.find(packet.notifyId());
+        if (it == inboundBuckets.end())
+            it = inboundBuckets.insert(packet.notifyId(), TokenBucket(limit->rate, limit->burst));
+        bucket = &(*it);
+    } else if (defaultInboundRateLimit.rate <= 0) {
+        return true;
+    }
+
+    if (!inboundClock.isValid())
+        inboundClock.start();
+
+    if (bucket->take(inboundClock.elapsed()))
+        return true;
+
+    ++rateLimitedPacketCount;
+    return false;
+}
+
+bool SocketP::checkOutbound()
+{
+    if (outboundHighWatermark <= 0 && maximumOutboundSize <= 0)
+        return true;
+
+    qint64 depth = outboundQueueDepth();
+    if (maximumOutboundSize > 0 && depth > maximumOutboundSize) {
+        // A slow consumer is disconnected, which keeps the seat of a player in a running game for a reconnect.
+        // What is queued is never going to be read, so the connection is aborted instead of being closed gracefully
+        qWarning("Outbound queue of %lld bytes exceeds the maximum of %d bytes, disconnecting", static_cast<long long>(depth), maximumOutboundSize);
+        hasError = true;
+        discardOutbound();
+        errorOccurred(QStringLiteral("Outbound queue exceeds the maximum size"));
+        // The packet being sent may come from a handler of the disconnection, so it is not emitted from here
+        QMetaObject::invokeMethod(this, &SocketP::abort, Qt::QueuedConnection);
+        return false;
+    }
+
+    if (outboundHighWatermark > 0) {
+        if (!congested && depth >= outboundHighWatermark) {
+            congested = true;
+            qDebug("Outbound queue of %lld bytes reaches the high watermark, dropping non-essential packets", static_cast<long long>(depth));
+        } else if (congested && depth <= outboundLowWatermark) {
+            congested = false;
+            qDebug("Outbound queue of %lld bytes drains to the low watermark, %d packets dropped so far", static_cast<long long>(depth), droppedPacketCount);
+        }
+    }
+
+    return true;
+}
+
+qsizetype SocketP::receiveBufferLimit() const
+{
+    // A frame of maximum size must fit, or it could never be parsed
+    return std::max<qsizetype>(receiveBufferSize, maximumFrameSize + frameHeaderSize);
+}
+
+void SocketP::streamReceived(QIODevice *device)
+{
+    // Read no more than the receive buffer limit at a time and parse it before reading on, so a peer flooding small
+    // frames is bounded as well. A full receive buffer always contains a complete or an oversized frame
+    while (!hasError) {
+        qint64 available = std::min<qint64>(device->bytesAvailable(), receiveBufferLimit() - receiveBuffer.size());
+        if (available <= 0)
+            break;
+        qint64 read = device->read(receiveBuffer.reserve(available), available);
+        if (read <= 0)
+            break;
+        receiveBuffer.commit(read);
+
+        if (!streamFramesReceived())
+            break;
+    }
+
+    receiveBuffer.squeeze();
+}
+
+bool SocketP::streamFramesReceived()
+{
+    while (receiveBuffer.size() > 0) {
+        // The peer may switch codec and framing right after sign in, so detect them for each frame separately
+        QByteArray rest = receiveBuffer.unread();
+        qsizetype payloadOffset = 0;
+        qsizetype payloadSize = -1;
+        uint8_t flags = 0;
+        if (static_cast<uint8_t>(rest.front()) < frameFlagsLimit) {
+            flags = static_cast<uint8_t>(rest.front());
+            if ((flags & ~knownFrameFlags) != 0) {
+                frameError(QStringLiteral("Unknown frame flags %1").arg(static_cast<int>(flags)));
+                return false;
+            }
+            if (rest.size() < frameHeaderSize)
+                break;
+
+            payloadSize = static_cast<qsizetype>(qFromBigEndian<quint32>(rest.constData()) & frameSizeLimit);
+            if (payloadSize > maximumFrameSize) {
+                frameError(QStringLiteral("Frame of %1 bytes exceeds maximum frame size").arg(payloadSize));
+                return false;
+            }
+
+            // incomplete frame, wait for more data
+            if (rest.size() < frameHeaderSize + payloadSize)
+                break;
+
+            payloadOffset = frameHeaderSize;
+        } else {
+            if (QMdmmCore::Protocol::detectCodec(rest) == QMdmmCore::Protocol::CodecCbor) {
+                QCborStreamReader reader(rest);
+                if (reader.next())
+                    payloadSize = reader.currentOffset();
+                else if (reader.lastError() != QCborError::EndOfFile)
+                    payloadSize = rest.size(); // let Packet::fromCbor report the error
+            } else {
+                // Bytes already scanned in an earlier call are not scanned again
+                qsizetype newLine = rest.indexOf('\n', delimiterScanned);
+                if (newLine != -1)
+                    payloadSize = newLine + 1;
+                else
+                    delimiterScanned = rest.size();
+            }
+
+            if (payloadSize == -1) {
+                // A delimited frame has no declared size, so stop a peer which never ends the frame here
+                if (rest.size() > maximumFrameSize) {
+                    frameError(QStringLiteral("Frame exceeds maximum frame size"));
+                    return false;
+                }
+
+                // incomplete frame, wait for more data
+                break;
+            }
+        }
+
+        // Consumed bytes stay in place until the next read, so the packet is parsed straight from the receive buffer.
+        // Nothing refers to these bytes once it is parsed.
+        receiveBuffer.consume(payloadOffset + payloadSize);
+        delimiterScanned = 0;
+        QByteArray payload = QByteArray::fromRawData(rest.constData() + payloadOffset, payloadSize);
+        if (!frameReceived(flags, payload)) {
+            receiveBuffer.clear();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void SocketP::frameError(const QString &errorString)
+{
+    // The frame boundary is lost, so nothing more can be parsed from this connection
+    receiveBuffer.clear();
+    delimiterScanned = 0;
+    errorOccurred(errorString);
+    q->setHasError(true);
+}
+
+QByteArray SocketP::batchFrame(const QList<QByteArray> &payloads, qsizetype size)
+{
+    // The header of the batch frame is written last, since the payload may be compressed
+    QByteArray frame;
+    frame.reserve(frameHeaderSize + size);
+    char header[frameHeaderSize] = {};
+    frame.append(header, frameHeaderSize);
+    foreach (const QByteArray &payload, payloads) {
+        writeFrameHeader(header, 0, payload.size());
+        frame.append(header, frameHeaderSize);
+        frame.append(payload);
+    }
+
+    uint8_t flags = frameFlagBatch;
+    if (QByteArray compressed = compressPayload(frame.constData() + frameHeaderSize, size); !compressed.isNull()) {
+        frame.resize(frameHeaderSize);
+        frame.append(compressed);
+        size = compressed.size();
+        flags |= frameFlagCompressed;
+    }
+
+    writeFrameHeader(frame.data(), flags, size);
+    return frame;
+}
+
+bool SocketP::batchReceived(const QByteArray &payload)
+{
+    qsizetype offset = 0;
+    while (offset < payload.size()) {
+        if (payload.size() - offset < frameHeaderSize) {
+            frameError(QStringLiteral("Truncated frame in batch"));
+            return false;
+        }
+
+        auto header = qFromBigEndian<quint32>(payload.constData() + offset);
+        // Batches are not nested
+        if ((header >> 24) != 0) {
+            frameError(QStringLiteral("Unknown frame flags %1 in batch").arg(header >> 24));
+            return false;
+        }
+
+        auto size = static_cast<qsizetype>(header & frameSizeLimit);
+        offset += frameHeaderSize;
+        if (payload.size() - offset < size) {
+            frameError(QStringLiteral("Truncated frame in batch"));
+            return false;
+        }
+
+        if (!packetReceived(QByteArray::fromRawData(payload.constData() + offset, size)))
+            return false;
+        offset += size;
+    }
+
+    return true;
+}
+
+QByteArray SocketP::compressPacket(const QMdmmCore::Packet &packet, qsizetype size)
+{
+    if (compressionThreshold <= 0 || size < compressionThreshold)
+        return {};
+
+    QElapsedTimer timer;
+    timer.start();
+    QByteArray compressed = packet.compress(codec);
+    compressionTime += timer.nsecsElapsed();
+    return countCompressed(compressed, size);
+}
+
+QByteArray SocketP::compressPayload(const char *data, qsizetype size)
+{
+    if (compressionThreshold <= 0 || size < compressionThreshold)
+        return {};
+
+    QElapsedTimer timer;
+    timer.start();
+    QByteArray compressed = qCompress(reinterpret_cast<const uchar *>(data), size);
+    compressionTime += timer.nsecsElapsed();
+    return countCompressed(compressed, size);
+}
+
+QByteArray SocketP::countCompressed(const QByteArray &compressed, qsizetype size)
+{
+    // Incompressible payload is sent as-is
+    if (compressed.size() >= size)
+        return {};
+
+    ++compressedFrameCount;
+    compressionInputSize += size;
+    compressionOutputSize += compressed.size();
+    return compressed;
+}
+
+bool SocketP::frameReceived(uint8_t flags, const QByteArray &payload)
+{
+    if ((flags & frameFlagCompressed) != 0) {
+        // qCompress prefixes the uncompressed size. Check it before anything is allocated for the uncompressed payload
+        if (payload.size() < 4) {
+            frameError(QStringLiteral("Truncated compressed frame"));
+            return false;
+        }
+        auto size = static_cast<qsizetype>(qFromBigEndian<quint32>(payload.constData()));
+        if (size > maximumFrameSize) {
+            frameError(QStringLiteral("Uncompressed frame of %1 bytes exceeds maximum frame size").arg(size));
+            return false;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        QByteArray uncompressed = qUncompress(payload);
+        uncompressionTime += timer.nsecsElapsed();
+        if (uncompressed.size() != size) {
+            frameError(QStringLiteral("Corrupt compressed frame"));
+            return false;
+        }
+
+        ++uncompressedFrameCount;
+        return frameReceived(static_cast<uint8_t>(flags & ~frameFlagCompressed), uncompressed);
+    }
+
+    if ((flags & frameFlagBatch) != 0)
+        return batchReceived(payload);
+
+    return packetReceived(payload);
+}
+
+void SocketP::flushPendingPackets()
+{
+    if (pendingPackets.isEmpty())
+        return;
+
+    QList<QMdmmCore::Packet> packets;
+    packets.swap(pendingPackets);
+    pendingBytes = 0;
+    writePackets(packets);
+}
+
+void SocketP::writePackets(const QList<QMdmmCore::Packet> &packets)
+{
+    // The peer checks the uncompressed size of a batch against its maximum frame size, so the packets are split into
+    // batches which fit in it. A packet which can't share a batch with its neighbours is written as a frame of its own
+    QList<QByteArray> payloads;
+    qsizetype size = 0;
+    qsizetype first = 0;
+    auto writeBatch = [this, &packets, &payloads, &size, &first](qsizetype end) {
+        if (payloads.size() == 1)
+            writePacket(packets.at(first));
+        else if (!payloads.isEmpty())
+            writeBatchFrame(batchFrame(payloads, size));
+        payloads.clear();
+        size = 0;
+        first = end;
+    };
+
+    for (qsizetype i = 0; i < packets.size(); ++i) {
+        QByteArray payload = packets.at(i).serialize(codec);
+        if (!payloads.isEmpty() && size + frameHeaderSize + payload.size() > peerMaximumFrameSize)
+            writeBatch(i);
+        size += frameHeaderSize + payload.size();
+        payloads.append(payload);
+    }
+    writeBatch(packets.size());
+}
+
+void SocketP::sendPacket(QMdmmCore::Packet packet)
+{
+    if (hasError || !checkOutbound())
+        return;
+
+    if (congested && isDroppable(packet)) {
+        ++droppedPacketCount;
+        return;
+    }
+
+    if (!batching) {
+        writePacket(packet);
+        return;
+    }
+
+    // The first queued packet schedules the flush, which runs after every event already posted is processed.
+    // The serialized packet is cached, so counting it here costs nothing when it is written
+    pendingPackets.append(packet);
+    pendingBytes += frameHeaderSize + packet.serialize(codec).size();
+    if (pendingPackets.size() == 1)
+        QMetaObject::invokeMethod(this, &SocketP::flushPendingPackets, Qt::QueuedConnection);
+}
+
 // NOLINTNEXTLINE(readability-make-member-function-const)
 bool SocketP::packetReceived(const QByteArray &arr)
 {
     QString packetError;
-    QMdmmCore::Packet packet = QMdmmCore::Packet::fromJson(arr, &packetError);
+    QMdmmCore::Packet packet = QMdmmCore::Packet::deserialize(arr, &packetError);
 
     if (packet.hasError()) {
         // Don't process more package for this connection. It is not guaranteed to be the desired client
@@ -80,6 +590,11 @@ bool SocketP::packetReceived(const QByteArray &arr)
         return false;
     }
 
+    // A notify over its rate limit is dropped, so one peer can't flood the event loop and, through broadcasts, every
+    // other peer. The connection is kept
+    if (!acceptInbound(packet))
+        return true;
+
     emit q->packetReceived(packet, Socket::QPrivateSignal());
     return !hasError;
 }
@@ -87,6 +602,15 @@ bool SocketP::packetReceived(const QByteArray &arr)
 // NOLINTNEXTLINE(readability-make-member-function-const)
 void SocketP::socketDisconnected()
 {
+    // Compression is reported once per connection instead of per frame
+    if (compressedFrameCount > 0) {
+        qDebug("Compressed %lld frames from %lld to %lld bytes (%.1f%%) in %lld us", static_cast<long long>(compressedFrameCount),
+               static_cast<long long>(compressionInputSize), static_cast<long long>(compressionOutputSize),
+               100.0 * static_cast<double>(compressionOutputSize) / static_cast<double>(compressionInputSize), static_cast<long long>(compressionTime / 1000));
+    }
+    if (uncompressedFrameCount > 0)
+        qDebug("Uncompressed %lld frames in %lld us", static_cast<long long>(uncompressedFrameCount), static_cast<long long>(uncompressionTime / 1000));
+
     emit q->socketDisconnected(Socket::QPrivateSignal());
 }
 
@@ -96,12 +620,98 @@ void SocketP::errorOccurred(const QString &errorString)
     emit q->socketErrorOccurred(errorString, Socket::QPrivateSignal());
 }
 
-SocketP_QTcpSocket::SocketP_QTcpSocket(QTcpSocket *socket, Socket *q)
+SocketP_Stream::SocketP_Stream(Socket *q)
     : SocketP(q)
+{
+}
+
+qint64 SocketP_Stream::outboundQueueDepth() const
+{
+    return SocketP::outboundQueueDepth() + corkedFrames.size();
+}
+
+void SocketP_Stream::discardOutbound()
+{
+    SocketP::discardOutbound();
+    corkedFrames.clear();
+}
+
+void SocketP_Stream::appendStreamFrame(QByteArray *frames, const QMdmmCore::Packet &packet)
+{
+    // The serialized packet may be shared with other sockets (see Packet::serialize), so it is written as-is instead of appending to it
+    QByteArray serialized = packet.serialize(codec);
+
+    // A compressed packet is always length-prefixed, since the compressed bytes may contain anything
+    uint8_t flags = 0;
+    if (QByteArray compressed = compressPacket(packet, serialized.size()); !compressed.isNull()) {
+        serialized = compressed;
+        flags = frameFlagCompressed;
+    }
+
+    if (framing == Socket::FramingLengthPrefixed || flags != 0) {
+        if (serialized.size() > frameSizeLimit) {
+            qWarning("Packet of %lld bytes can't be framed, dropping", static_cast<long long>(serialized.size()));
+            return;
+        }
+
+        char header[frameHeaderSize];
+        writeFrameHeader(header, flags, serialized.size());
+        frames->append(header, frameHeaderSize);
+        frames->append(serialized);
+        return;
+    }
+
+    frames->append(serialized);
+
+    // A CBOR item is self-delimiting, while a JSON object is terminated by a new line
+    if (codec == QMdmmCore::Protocol::CodecJson)
+        frames->append('\n');
+}
+
+void SocketP_Stream::writePacket(const QMdmmCore::Packet &packet)
+{
+    if (streamOpen())
+        corkStreamFrame(packet);
+}
+
+void SocketP_Stream::writeBatchFrame(const QByteArray &frame)
+{
+    // A batch frame is written at the end of an iteration already, together with what is corked before it
+    if (streamOpen()) {
+        corkedFrames.append(frame);
+        uncork();
+    }
+}
+
+void SocketP_Stream::corkStreamFrame(const QMdmmCore::Packet &packet)
+{
+    // The first corked frame schedules the uncork, which runs after every event already posted is processed
+    bool wasEmpty = corkedFrames.isEmpty();
+    appendStreamFrame(&corkedFrames, packet);
+    if (wasEmpty && !corkedFrames.isEmpty())
+        QMetaObject::invokeMethod(this, &SocketP_Stream::uncork, Qt::QueuedConnection);
+}
+
+void SocketP_Stream::uncork()
+{
+    if (corkedFrames.isEmpty())
+        return;
+
+    // Swapped out first, so that a packet sent while writing (e.g. from an error handler) is corked for the next iteration
+    QByteArray frames;
+    frames.swap(corkedFrames);
+    writeStreamFrames(frames);
+}
+
+SocketP_QTcpSocket::SocketP_QTcpSocket(QTcpSocket *socket, Socket *q)
+    : SocketP_Stream(q)
     , socket(socket)
 {
-    if (socket != nullptr)
+    if (socket != nullptr) {
+        // Taken from its server, so that it moves to another thread together with the Socket
+        socket->setParent(this);
         setupSocket();
+    }
 }
 
 SocketP_QTcpSocket::SocketP_QTcpSocket(Socket *q)
@@ -114,12 +724,22 @@ bool SocketP_QTcpSocket::connectToHost(const QString &addr)
     if (socket != nullptr)
         socket->deleteLater();
 
-    socket = new QTcpSocket(this);
-    setupSocket();
     QUrl u(addr);
     QString host = u.host();
     uint16_t port = u.port(6366);
 
+    if (u.scheme() == QStringLiteral("qmdmms")) {
+        // A configuration taken from a previous connection carries its session ticket, so the handshake is resumed
+        auto *sslSocket = new QSslSocket(this);
+        sslSocket->setSslConfiguration(sslConfiguration);
+        socket = sslSocket;
+        setupSocket();
+        sslSocket->connectToHostEncrypted(host, port);
+        return true;
+    }
+
+    socket = new QTcpSocket(this);
+    setupSocket();
     socket->connectToHost(host, port);
     return true;
 }
@@ -127,6 +747,7 @@ bool SocketP_QTcpSocket::connectToHost(const QString &addr)
 bool SocketP_QTcpSocket::disconnectFromHost()
 {
     if (socket != nullptr) {
+        uncork();
         socket->disconnectFromHost();
         socket->deleteLater();
         return true;
@@ -134,6 +755,27 @@ bool SocketP_QTcpSocket::disconnectFromHost()
     return false;
 }
 
+void SocketP_QTcpSocket::abort()
+{
+    if (socket != nullptr)
+        socket->abort();
+}
+
+qint64 SocketP_QTcpSocket::bytesToWrite() const
+{
+    if (socket != nullptr)
+        return socket->bytesToWrite();
+    return 0;
+}
+
+QSslConfiguration SocketP_QTcpSocket::sessionSslConfiguration() const
+{
+    // A socket accepted by QSslServer or connected to a qmdmms:// address is a QSslSocket
+    if (const auto *sslSocket = qobject_cast<const QSslSocket *>(socket.data()); sslSocket != nullptr && sslSocket->isEncrypted())
+        return sslSocket->sslConfiguration();
+    return {};
+}
+
 void SocketP_QTcpSocket::setupSocket()
 {
     connect(socket, &QTcpSocket::readyRead, this, &SocketP_QTcpSocket::readyRead);
@@ -141,25 +783,46 @@ void SocketP_QTcpSocket::setupSocket()
     connect(socket, &QTcpSocket::errorOccurred, this, &SocketP_QTcpSocket::errorOccurredTcpSocket);
     connect(socket, &QTcpSocket::disconnected, this, &SocketP_QTcpSocket::socketDisconnected);
     connect(socket, &QTcpSocket::disconnected, socket, &QTcpSocket::deleteLater);
+    applyReceiveLimits();
+
+    // Packets are already coalesced by corking, so Nagle's algorithm would only delay them.
+    // A socket option can only be set on a connected socket
+    if (socket->state() == QAbstractSocket::ConnectedState)
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    else
+        connect(socket, &QTcpSocket::connected, this, &SocketP_QTcpSocket::setLowDelay);
+}
+
+void SocketP_QTcpSocket::setLowDelay()
+{
+    if (socket != nullptr)
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+}
+
+bool SocketP_QTcpSocket::streamOpen() const
+{
+    return socket != nullptr;
 }
 
-void SocketP_QTcpSocket::sendPacket(QMdmmCore::Packet packet)
+void SocketP_QTcpSocket::writeStreamFrames(const QByteArray &frames)
 {
     if (socket != nullptr) {
-        socket->write(QByteArray(packet).append("\n"));
+        socket->write(frames);
         socket->flush();
     }
 }
 
+void SocketP_QTcpSocket::applyReceiveLimits()
+{
+    // QTcpSocket stops reading from the kernel once this much is buffered, so TCP flow control holds back the peer
+    if (socket != nullptr)
+        socket->setReadBufferSize(receiveBufferSize);
+}
+
 void SocketP_QTcpSocket::readyRead()
 {
-    if (socket != nullptr) {
-        while (socket->canReadLine()) {
-            QByteArray arr = socket->readLine();
-            if (!packetReceived(arr))
-                break;
-        }
-    }
+    if (socket != nullptr)
+        streamReceived(socket);
 }
 
 void SocketP_QTcpSocket::errorOccurredTcpSocket(QAbstractSocket::SocketError /*e*/)
@@ -169,7 +832,7 @@ void SocketP_QTcpSocket::errorOccurredTcpSocket(QAbstractSocket::SocketError /*e
 }
 
 SocketP_QLocalSocket::SocketP_QLocalSocket(QLocalSocket *socket, Socket *q)
-    : SocketP(q)
+    : SocketP_Stream(q)
     , socket(socket)
 {
     if (socket != nullptr)
@@ -195,6 +858,7 @@ bool SocketP_QLocalSocket::connectToHost(const QString &addr)
 bool SocketP_QLocalSocket::disconnectFromHost()
 {
     if (socket != nullptr) {
+        uncork();
         socket->disconnectFromServer();
         socket->deleteLater();
         return true;
@@ -202,34 +866,59 @@ bool SocketP_QLocalSocket::disconnectFromHost()
     return false;
 }
 
-void SocketP_QLocalSocket::setupSocket()
+void SocketP_QLocalSocket::abort()
 {
-    connect(socket, &QLocalSocket::readyRead, this, &SocketP_QLocalSocket::readyRead);
-    connect(this, &SocketP_QLocalSocket::destroyed, socket, &QLocalSocket::deleteLater);
-    connect(socket, &QLocalSocket::errorOccurred, this, &SocketP_QLocalSocket::errorOccurredLocalSocket);
-    connect(socket, &QLocalSocket::disconnected, this, &SocketP_QLocalSocket::socketDisconnected);
-    connect(socket, &QLocalSocket::disconnected, socket, &QLocalSocket::deleteLater);
+    if (socket != nullptr)
+        socket->abort();
 }
 
-void SocketP_QLocalSocket::sendPacket(QMdmmCore::Packet packet)
+qint64 SocketP_QLocalSocket::bytesToWrite() const
 {
-    if (socket != nullptr) {
-        socket->write(QByteArray(packet).append("\n"));
-        socket->flush();
-    }
+    if (socket != nullptr)
+        return socket->bytesToWrite();
+    return 0;
 }
 
-void SocketP_QLocalSocket::readyRead()
+QSslConfiguration SocketP_QLocalSocket::sessionSslConfiguration() const
+{
+    return {};
+}
+
+void SocketP_QLocalSocket::setupSocket()
+{
+    connect(socket, &QLocalSocket::readyRead, this, &SocketP_QLocalSocket::readyRead);
+    connect(this, &SocketP_QLocalSocket::destroyed, socket, &QLocalSocket::deleteLater);
+    connect(socket, &QLocalSocket::errorOccurred, this, &SocketP_QLocalSocket::errorOccurredLocalSocket);
+    connect(socket, &QLocalSocket::disconnected, this, &SocketP_QLocalSocket::socketDisconnected);
+    connect(socket, &QLocalSocket::disconnected, socket, &QLocalSocket::deleteLater);
+    applyReceiveLimits();
+}
+
+bool SocketP_QLocalSocket::streamOpen() const
+{
+    return socket != nullptr;
+}
+
+void SocketP_QLocalSocket::writeStreamFrames(const QByteArray &frames)
 {
     if (socket != nullptr) {
-        while (socket->canReadLine()) {
-            QByteArray arr = socket->readLine();
-            if (!packetReceived(arr))
-                break;
-        }
+        socket->write(frames);
+        socket->flush();
     }
 }
 
+void SocketP_QLocalSocket::applyReceiveLimits()
+{
+    if (socket != nullptr)
+        socket->setReadBufferSize(receiveBufferSize);
+}
+
+void SocketP_QLocalSocket::readyRead()
+{
+    if (socket != nullptr)
+        streamReceived(socket);
+}
+
 void SocketP_QLocalSocket::errorOccurredLocalSocket(QLocalSocket::LocalSocketError /*e*/)
 {
     if (socket != nullptr)
@@ -257,6 +946,8 @@ bool SocketP_QWebSocket::connectToHost(const QString &addr)
     socket = new QWebSocket(QStringLiteral("qmdmm.com"), QWebSocketProtocol::VersionLatest, this);
     setupSocket();
     QUrl url(addr);
+    // Only used by wss:// addresses
+    socket->setSslConfiguration(sslConfiguration);
     socket->open(url);
 
     return true;
@@ -272,19 +963,101 @@ bool SocketP_QWebSocket::disconnectFromHost()
     return false;
 }
 
+void SocketP_QWebSocket::abort()
+{
+    if (socket != nullptr)
+        socket->abort();
+}
+
+qint64 SocketP_QWebSocket::bytesToWrite() const
+{
+    if (socket != nullptr)
+        return socket->bytesToWrite();
+    return 0;
+}
+
+QSslConfiguration SocketP_QWebSocket::sessionSslConfiguration() const
+{
+    // QWebSocket doesn't tell whether it is encrypted, but only an encrypted connection has a cipher
+    if (socket != nullptr) {
+        QSslConfiguration configuration = socket->sslConfiguration();
+        if (!configuration.sessionCipher().isNull())
+            return configuration;
+    }
+    return {};
+}
+
 void SocketP_QWebSocket::setupSocket()
 {
-    connect(socket, &QWebSocket::binaryMessageReceived, this, &SocketP_QWebSocket::packetReceived);
+    connect(socket, &QWebSocket::binaryMessageReceived, this, &SocketP_QWebSocket::messageReceived);
     connect(this, &SocketP_QWebSocket::destroyed, socket, &QWebSocket::deleteLater);
     connect(socket, &QWebSocket::errorOccurred, this, &SocketP_QWebSocket::errorOccurredWebSocket);
     connect(socket, &QWebSocket::disconnected, this, &SocketP_QWebSocket::socketDisconnected);
     connect(socket, &QWebSocket::disconnected, socket, &QWebSocket::deleteLater);
+    applyReceiveLimits();
 }
 
-void SocketP_QWebSocket::sendPacket(QMdmmCore::Packet packet)
+void SocketP_QWebSocket::writePacket(const QMdmmCore::Packet &packet)
+{
+    if (socket == nullptr)
+        return;
+
+    QByteArray serialized = packet.serialize(codec);
+    QByteArray compressed = compressPacket(packet, serialized.size());
+    if (compressed.isNull() || compressed.size() > frameSizeLimit) {
+        socket->sendBinaryMessage(serialized);
+        return;
+    }
+
+    QByteArray frame(frameHeaderSize, Qt::Uninitialized);
+    writeFrameHeader(frame.data(), frameFlagCompressed, compressed.size());
+    frame.append(compressed);
+    socket->sendBinaryMessage(frame);
+}
+
+void SocketP_QWebSocket::writeBatchFrame(const QByteArray &frame)
 {
     if (socket != nullptr)
-        socket->sendBinaryMessage(packet);
+        socket->sendBinaryMessage(frame);
+}
+
+void SocketP_QWebSocket::applyReceiveLimits()
+{
+    // QWebSocket assembles a whole message before handing it over. Let it reject an oversized frame or message by its
+    // header, instead of buffering it first
+    if (socket != nullptr) {
+        socket->setReadBufferSize(receiveBufferSize);
+        socket->setMaxAllowedIncomingFrameSize(maximumFrameSize + frameHeaderSize);
+        socket->setMaxAllowedIncomingMessageSize(maximumFrameSize + frameHeaderSize);
+    }
+}
+
+void SocketP_QWebSocket::messageReceived(const QByteArray &message)
+{
+    if (message.size() > maximumFrameSize + frameHeaderSize) {
+        frameError(QStringLiteral("Message of %1 bytes exceeds maximum frame size").arg(message.size()));
+        return;
+    }
+
+    // A message is a packet itself, unless it begins with a frame header
+    if (message.isEmpty() || static_cast<uint8_t>(message.front()) >= frameFlagsLimit) {
+        packetReceived(message);
+        return;
+    }
+
+    if (message.size() < frameHeaderSize) {
+        frameError(QStringLiteral("Truncated frame"));
+        return;
+    }
+
+    auto header = qFromBigEndian<quint32>(message.constData());
+    auto flags = static_cast<uint8_t>(header >> 24);
+    if ((flags & ~knownFrameFlags) != 0 || static_cast<qsizetype>(header & frameSizeLimit) != message.size() - frameHeaderSize) {
+        frameError(QStringLiteral("Malformed frame"));
+        return;
+    }
+
+    frameReceived(flags, QByteArray::fromRawData(message.constData() + frameHeaderSize, message.size() - frameHeaderSize));
 }
 
 void SocketP_QWebSocket::errorOccurredWebSocket(QAbstractSocket::SocketError /*e*/)
@@ -292,6 +1065,193 @@ void SocketP_QWebSocket::errorOccurredWebSocket(QAbstractSocket::SocketError /*e
     if (socket != nullptr)
         errorOccurred(socket->errorString());
 }
+
+namespace {
+// Servers listening in this process by name. The lock makes connecting from a thread other than the server's safe
+QMutex &inProcessServersLock()
+{
+    static QMutex lock;
+    return lock;
+}
+
+QHash<QString, InProcessServer *> &inProcessServers()
+{
+    static QHash<QString, InProcessServer *> servers;
+    return servers;
+}
+} // namespace
+
+SocketP_InProcess::SocketP_InProcess(Socket *q)
+    : SocketP(q)
+    , connecting(false)
+{
+}
+
+SocketP_InProcess::~SocketP_InProcess()
+{
+    if (peer != nullptr)
+        QMetaObject::invokeMethod(peer, &SocketP_InProcess::peerDisconnected, Qt::QueuedConnection);
+}
+
+bool SocketP_InProcess::connectToHost(const QString &addr)
+{
+    // The name is taken as it is. QUrl would lower its case as a host name
+    QString name = addr.mid(QStringLiteral("inproc://").size());
+    connecting = InProcessServer::connectToServer(name, this);
+    return connecting;
+}
+
+bool SocketP_InProcess::disconnectFromHost()
+{
+    flushPendingPackets();
+
+    if (peer == nullptr) {
+        bool ret = connecting;
+        connecting = false;
+        return ret;
+    }
+
+    QMetaObject::invokeMethod(peer, &SocketP_InProcess::peerDisconnected, Qt::QueuedConnection);
+    peer = nullptr;
+    socketDisconnected();
+    return true;
+}
+
+void SocketP_InProcess::abort()
+{
+    discardOutbound();
+    disconnectFromHost();
+}
+
+qint64 SocketP_InProcess::bytesToWrite() const
+{
+    // Packets are handed over at once, nothing is ever queued here
+    return 0;
+}
+
+QSslConfiguration SocketP_InProcess::sessionSslConfiguration() const
+{
+    return {};
+}
+
+void SocketP_InProcess::writePacket(const QMdmmCore::Packet &packet)
+{
+    writePackets(QList<QMdmmCore::Packet> {packet});
+}
+
+void SocketP_InProcess::writeBatchFrame(const QByteArray & /*frame*/)
+{
+    // writePackets is overridden, so packets are never serialized into a batch frame
+}
+
+void SocketP_InProcess::writePackets(const QList<QMdmmCore::Packet> &packets)
+{
+    if (peer == nullptr)
+        return;
+
+    // The event is discarded if the peer is deleted before it is delivered
+    SocketP_InProcess *receiver = peer;
+    QMetaObject::invokeMethod(
+        receiver, [receiver, packets]() { receiver->packetsDelivered(packets); }, Qt::QueuedConnection);
+}
+
+void SocketP_InProcess::applyReceiveLimits()
+{
+    // Nothing is buffered as bytes. Packets are bounded by the rate limit of the receiving end only
+}
+
+void SocketP_InProcess::peerAccepted(SocketP_InProcess *server)
+{
+    // connectToHost was cancelled meanwhile
+    if (!connecting) {
+        QMetaObject::invokeMethod(server, &SocketP_InProcess::peerDisconnected, Qt::QueuedConnection);
+        return;
+    }
+
+    connecting = false;
+    peer = server;
+}
+
+void SocketP_InProcess::packetsDelivered(const QList<QMdmmCore::Packet> &packets)
+{
+    foreach (const QMdmmCore::Packet &packet, packets) {
+        if (hasError)
+            break;
+        if (!acceptInbound(packet))
+            continue;
+
+        emit q->packetReceived(packet, Socket::QPrivateSignal());
+    }
+}
+
+void SocketP_InProcess::peerDisconnected()
+{
+    if (peer == nullptr)
+        return;
+
+    peer = nullptr;
+    socketDisconnected();
+}
+
+InProcessServer::InProcessServer(QObject *parent)
+    : QObject(parent)
+{
+}
+
+InProcessServer::~InProcessServer()
+{
+    close();
+}
+
+bool InProcessServer::listen(const QString &name)
+{
+    QMutexLocker locker(&inProcessServersLock());
+    if (!this->name.isEmpty() || inProcessServers().contains(name))
+        return false;
+
+    inProcessServers().insert(name, this);
+    this->name = name;
+    return true;
+}
+
+void InProcessServer::close()
+{
+    QMutexLocker locker(&inProcessServersLock());
+    if (name.isEmpty())
+        return;
+
+    inProcessServers().remove(name);
+    name.clear();
+}
+
+bool InProcessServer::connectToServer(const QString &name, SocketP_InProcess *client)
+{
+    QMutexLocker locker(&inProcessServersLock());
+    InProcessServer *server = inProcessServers().value(name, nullptr);
+    if (server == nullptr)
+        return false;
+
+    // The server accepts in its own thread, it is not deleted meanwhile since it is still registered
+    QPointer<SocketP_InProcess> c = client;
+    QMetaObject::invokeMethod(server, [server, c]() { server->accept(c); }, Qt::QueuedConnection);
+    return true;
+}
+
+void InProcessServer::accept(const QPointer<SocketP_InProcess> &client)
+{
+    if (client == nullptr)
+        return;
+
+    auto *socket = new Socket(this);
+    auto *d = new SocketP_InProcess(socket);
+    SocketP::attach(socket, d);
+    d->peer = client;
+
+    SocketP_InProcess *c = client;
+    QMetaObject::invokeMethod(c, [c, d]() { c->peerAccepted(d); }, Qt::QueuedConnection);
+
+    emit newConnection(socket);
+}
 } // namespace p
 #endif
 
@@ -325,6 +1285,27 @@ namespace v0 {
 
  * @var Socket::Type Socket::TypeQWebSocket
  * @brief WebSocket transport.
+
+ * @var Socket::Type Socket::TypeEpoll
+ * @brief TCP transport on a non-blocking socket descriptor driven by epoll. Server side and Linux only.
+
+ * @var Socket::Type Socket::TypeInProcess
+ * @brief Connection to a server in the same process. Packets are handed over as objects without being serialized.
+ */
+
+/**
+ * @enum Socket::Framing
+ * @brief How packets are separated on stream based transports (TCP socket and local socket).
+ *
+ * WebSocket transport is message based and doesn't use framing.
+ */
+
+/**
+ * @var Socket::Framing Socket::FramingDelimited
+ * @brief JSON packets are terminated by a new line, CBOR packets are self-delimiting.
+
+ * @var Socket::Framing Socket::FramingLengthPrefixed
+ * @brief Every packet is preceded by a 4-byte header containing 1 byte flags and 3 bytes big-endian packet size.
  */
 
 /**
@@ -360,6 +1341,22 @@ Socket::Socket(QWebSocket *w, QObject *parent)
 {
 }
 
+/**
+ * @brief ctor for server side, adopting an already-connected native socket descriptor
+ * @param type the transport driving the descriptor. Only @c TypeEpoll is supported
+ * @param socketDescriptor the socket descriptor, which is owned and closed by this socket
+ * @param parent QObject parent.
+ *
+ * The descriptor is watched by the epoll reactor of the thread the socket lives in. The socket may be moved to another
+ * thread with @c QObject::moveToThread() , from the thread it lives in and outside of its own callbacks: it leaves the
+ * reactor of the old thread, and joins the one of the new thread once the event loop there runs.
+ */
+Socket::Socket(Type type, qintptr socketDescriptor, QObject *parent)
+    : QObject(parent)
+    , d(p::SocketPFactory::create(type, socketDescriptor, this))
+{
+}
+
 /**
  * @brief ctor for client side
  * @param parent QObject parent.
@@ -378,16 +1375,37 @@ Socket::Socket(QObject *parent)
  */
 Socket::~Socket() = default;
 
+/**
+ * @brief the type of the underlying transport
+ * @return the type, or @c TypeUnknown if there is no transport yet
+ */
+Socket::Type Socket::type() const
+{
+    if (d != nullptr)
+        return d->type();
+
+    return TypeUnknown;
+}
+
 /**
  * @brief Set the error state of the socket
  * @param hasError @c true to mark the socket as errored and disconnect it, @c false otherwise
+ *
+ * This function may be called from any thread. It takes effect in the thread of the socket.
  */
 void Socket::setHasError(bool hasError)
 {
+    if (thread() != QThread::currentThread()) {
+        QMetaObject::invokeMethod(this, [this, hasError]() { setHasError(hasError); }, Qt::QueuedConnection);
+        return;
+    }
+
     if (d != nullptr) {
         d->hasError = hasError;
-        if (hasError)
+        if (hasError) {
+            d->discardOutbound();
             d->disconnectFromHost();
+        }
     }
 }
 
@@ -403,15 +1421,461 @@ bool Socket::hasError() const
     return true;
 }
 
+/**
+ * @brief Set the codec of packets sent by this socket
+ * @param codec the codec
+ *
+ * Received packets are always accepted in either codec.
+ * Packets queued for batching are written with the previous codec.
+ * The codec is reset to @c QMdmmCore::Protocol::CodecJson when connecting to a host.
+ */
+void Socket::setCodec(QMdmmCore::Protocol::Codec codec)
+{
+    if (d != nullptr) {
+        d->flushPendingPackets();
+        d->codec = codec;
+    }
+}
+
+/**
+ * @brief the codec of packets sent by this socket
+ * @return the codec
+ */
+QMdmmCore::Protocol::Codec Socket::codec() const
+{
+    if (d != nullptr)
+        return d->codec;
+
+    return QMdmmCore::Protocol::CodecJson;
+}
+
+/**
+ * @brief Set the framing of packets sent by this socket
+ * @param framing the framing
+ *
+ * Received packets are always accepted in either framing.
+ * Packets queued for batching are written with the previous framing.
+ * The framing is reset to @c Socket::FramingDelimited when connecting to a host.
+ */
+void Socket::setFraming(Framing framing)
+{
+    if (d != nullptr) {
+        d->flushPendingPackets();
+        d->framing = framing;
+    }
+}
+
+/**
+ * @brief the framing of packets sent by this socket
+ * @return the framing
+ */
+Socket::Framing Socket::framing() const
+{
+    if (d != nullptr)
+        return d->framing;
+
+    return FramingDelimited;
+}
+
+/**
+ * @brief Set the maximum size of a received frame
+ * @param maximumFrameSize the maximum size in bytes, bounded to 1 ~ 16777215
+ *
+ * A peer sending a larger frame is treated as an error and disconnected.
+ * The maximum frame size is reset to 1 MiB when connecting to a host.
+ */
+void Socket::setMaximumFrameSize(int maximumFrameSize)
+{
+    if (d != nullptr) {
+        d->maximumFrameSize = qBound(1, maximumFrameSize, p::SocketP::frameSizeLimit);
+        d->applyReceiveLimits();
+    }
+}
+
+/**
+ * @brief the maximum size of a received frame
+ * @return the maximum size in bytes
+ */
+int Socket::maximumFrameSize() const
+{
+    if (d != nullptr)
+        return d->maximumFrameSize;
+
+    return p::SocketP::defaultMaximumFrameSize;
+}
+
+/**
+ * @brief Set whether packets sent by this socket are batched
+ * @param batching @c true to batch packets
+ *
+ * When batching, the packets sent during one event loop iteration are queued, and written together in a single batch frame
+ * after the iteration. The peer must be able to unpack batch frames, which is negotiated during sign in.
+ * Received batch frames are always accepted.
+ * A batch frame never exceeds the maximum frame size of the peer (see @c Socket::setPeerMaximumFrameSize ).
+ * Batching is turned off when connecting to a host.
+ */
+void Socket::setBatching(bool batching)
+{
+    if (d != nullptr) {
+        if (!batching)
+            d->flushPendingPackets();
+        d->batching = batching;
+    }
+}
+
+/**
+ * @brief if packets sent by this socket are batched
+ * @return @c true if batched
+ */
+bool Socket::batching() const
+{
+    if (d != nullptr)
+        return d->batching;
+
+    return false;
+}
+
+/**
+ * @brief Set the maximum size of a frame which the peer receives
+ * @param peerMaximumFrameSize the maximum size in bytes, bounded to 1 ~ 16777215
+ *
+ * Batch frames sent by this socket are split so that none exceeds it. The peer tells its maximum frame size during
+ * sign in, and until it does (or if it never does), 64 KiB is assumed.
+ * The maximum frame size of the peer is reset to 64 KiB when connecting to a host.
+ */
+void Socket::setPeerMaximumFrameSize(int peerMaximumFrameSize)
+{
+    if (d != nullptr)
+        d->peerMaximumFrameSize = qBound(1, peerMaximumFrameSize, p::SocketP::frameSizeLimit);
+}
+
+/**
+ * @brief the maximum size of a frame which the peer receives
+ * @return the maximum size in bytes
+ */
+int Socket::peerMaximumFrameSize() const
+{
+    if (d != nullptr)
+        return d->peerMaximumFrameSize;
+
+    return p::SocketP::defaultPeerMaximumFrameSize;
+}
+
+/**
+ * @brief Set the size from which the frames sent by this socket are compressed
+ * @param compressionThreshold the size in bytes, @c 0 to turn off compression
+ *
+ * A frame whose payload is at least this large is compressed with @c qCompress() , unless it doesn't get smaller.
+ * The peer must be able to uncompress frames, which is negotiated during sign in.
+ * Received compressed frames are always accepted.
+ * How much is compressed is counted in @c compressedFrameCount() , @c compressionInputSize() and @c compressionOutputSize() ,
+ * and how long it takes in @c compressionTime() . The totals are logged when the socket is disconnected.
+ * Compression is turned off when connecting to a host.
+ */
+void Socket::setCompressionThreshold(int compressionThreshold)
+{
+    if (d != nullptr)
+        d->compressionThreshold = qBound(0, compressionThreshold, p::SocketP::frameSizeLimit);
+}
+
+/**
+ * @brief the size from which the frames sent by this socket are compressed
+ * @return the size in bytes, @c 0 if compression is turned off
+ */
+int Socket::compressionThreshold() const
+{
+    if (d != nullptr)
+        return d->compressionThreshold;
+
+    return 0;
+}
+
+/**
+ * @brief the number of frames sent compressed by this socket
+ * @return the number of frames
+ *
+ * Frames which don't get smaller when compressed are sent as-is and not counted.
+ */
+qint64 Socket::compressedFrameCount() const
+{
+    if (d != nullptr)
+        return d->compressedFrameCount;
+
+    return 0;
+}
+
+/**
+ * @brief the total size of the frames sent compressed by this socket, before compression
+ * @return the size in bytes
+ */
+qint64 Socket::compressionInputSize() const
+{
+    if (d != nullptr)
+        return d->compressionInputSize;
+
+    return 0;
+}
+
+/**
+ * @brief the total size of the frames sent compressed by this socket, after compression
+ * @return the size in bytes
+ */
+qint64 Socket::compressionOutputSize() const
+{
+    if (d != nullptr)
+        return d->compressionOutputSize;
+
+    return 0;
+}
+
+/**
+ * @brief the number of compressed frames received and uncompressed by this socket
+ * @return the number of frames
+ */
+qint64 Socket::uncompressedFrameCount() const
+{
+    if (d != nullptr)
+        return d->uncompressedFrameCount;
+
+    return 0;
+}
+
+/**
+ * @brief the total time this socket spent compressing frames
+ * @return the time in nanoseconds
+ *
+ * A packet compressed for another socket already (see @c QMdmmCore::Packet::compress() ) costs nearly nothing.
+ */
+qint64 Socket::compressionTime() const
+{
+    if (d != nullptr)
+        return d->compressionTime;
+
+    return 0;
+}
+
+/**
+ * @brief the total time this socket spent uncompressing received frames
+ * @return the time in nanoseconds
+ */
+qint64 Socket::uncompressionTime() const
+{
+    if (d != nullptr)
+        return d->uncompressionTime;
+
+    return 0;
+}
+
+/**
+ * @brief Set the size of the outbound queue from which non-essential packets are dropped
+ * @param outboundHighWatermark the size in bytes, @c 0 to never drop packets
+ *
+ * The outbound queue consists of the packets queued for a batch, the frames which are not written to the underlying
+ * transport yet, and the bytes which the transport has not sent yet. When it reaches the high watermark, chats and
+ * operations of other players are dropped until it drains to the low watermark. Other packets are always queued.
+ * The low watermark is lowered to the high watermark if it is above.
+ * Packets are never dropped after connecting to a host.
+ */
+void Socket::setOutboundHighWatermark(int outboundHighWatermark)
+{
+    if (d != nullptr) {
+        d->outboundHighWatermark = qMax(0, outboundHighWatermark);
+        if (d->outboundHighWatermark > 0)
+            d->outboundLowWatermark = qMin(d->outboundLowWatermark, d->outboundHighWatermark);
+    }
+}
+
+/**
+ * @brief the size of the outbound queue from which non-essential packets are dropped
+ * @return the size in bytes, @c 0 if packets are never dropped
+ */
+int Socket::outboundHighWatermark() const
+{
+    if (d != nullptr)
+        return d->outboundHighWatermark;
+
+    return 0;
+}
+
+/**
+ * @brief Set the size of the outbound queue to which it drains before non-essential packets are sent again
+ * @param outboundLowWatermark the size in bytes
+ *
+ * The low watermark is clamped to the high watermark, or the queue would leave the congestion as soon as it enters it.
+ *
+ * @sa setOutboundHighWatermark
+ */
+void Socket::setOutboundLowWatermark(int outboundLowWatermark)
+{
+    if (d != nullptr) {
+        d->outboundLowWatermark = qMax(0, outboundLowWatermark);
+        if (d->outboundHighWatermark > 0)
+            d->outboundLowWatermark = qMin(d->outboundLowWatermark, d->outboundHighWatermark);
+    }
+}
+
+/**
+ * @brief the size of the outbound queue to which it drains before non-essential packets are sent again
+ * @return the size in bytes
+ */
+int Socket::outboundLowWatermark() const
+{
+    if (d != nullptr)
+        return d->outboundLowWatermark;
+
+    return 0;
+}
+
+/**
+ * @brief Set the maximum size of the outbound queue
+ * @param maximumOutboundSize the size in bytes, @c 0 for no limit
+ *
+ * A peer which doesn't read fast enough to keep the outbound queue below this size is treated as an error, and the
+ * connection is aborted. A player in a running game keeps its seat and may reconnect.
+ * The outbound queue has no limit after connecting to a host.
+ */
+void Socket::setMaximumOutboundSize(int maximumOutboundSize)
+{
+    if (d != nullptr)
+        d->maximumOutboundSize = qMax(0, maximumOutboundSize);
+}
+
+/**
+ * @brief the maximum size of the outbound queue
+ * @return the size in bytes, @c 0 for no limit
+ */
+int Socket::maximumOutboundSize() const
+{
+    if (d != nullptr)
+        return d->maximumOutboundSize;
+
+    return 0;
+}
+
+/**
+ * @brief the current size of the outbound queue
+ * @return the size in bytes
+ */
+qint64 Socket::outboundQueueDepth() const
+{
+    if (d != nullptr)
+        return d->outboundQueueDepth();
+
+    return 0;
+}
+
+/**
+ * @brief the number of non-essential packets dropped because the outbound queue was above its high watermark
+ * @return the number of dropped packets
+ */
+int Socket::droppedPacketCount() const
+{
+    if (d != nullptr)
+        return d->droppedPacketCount;
+
+    return 0;
+}
+
+/**
+ * @brief Set the size of the receive buffer
+ * @param receiveBufferSize the size in bytes, at least 1
+ *
+ * The transport buffers at most this many received bytes which are not parsed yet, and stops reading from the peer
+ * until they are. A frame up to the maximum frame size is still buffered completely.
+ * The receive buffer size is reset to 64 KiB when connecting to a host.
+ */
+void Socket::setReceiveBufferSize(int receiveBufferSize)
+{
+    if (d != nullptr) {
+        d->receiveBufferSize = qMax(1, receiveBufferSize);
+        d->applyReceiveLimits();
+    }
+}
+
+/**
+ * @brief the size of the receive buffer
+ * @return the size in bytes
+ */
+int Socket::receiveBufferSize() const
+{
+    if (d != nullptr)
+        return d->receiveBufferSize;
+
+    return p::SocketP::defaultReceiveBufferSize;
+}
+
+/**
+ * @brief Set the rate limit of a kind of notifies received by this socket
+ * @param notifyId the kind of notifies
+ * @param rate the number of notifies accepted per second in the long run, @c 0 for no limit
+ * @param burst the number of notifies accepted at once
+ *
+ * Notifies over the limit are dropped and counted by @c rateLimitedPacketCount() . The connection is kept.
+ * Notifies without their own rate limit are limited by @c setDefaultInboundRateLimit() .
+ * Received notifies are not limited after connecting to a host.
+ */
+void Socket::setInboundRateLimit(QMdmmCore::Protocol::NotifyId notifyId, int rate, int burst)
+{
+    if (d != nullptr) {
+        d->inboundRateLimits.insert(notifyId, {.rate = qMax(0, rate), .burst = qMax(1, burst)});
+        d->inboundBuckets.remove(notifyId);
+    }
+}
+
+/**
+ * @brief Set the rate limit of the notifies received by this socket which have no rate limit of their own
+ * @param rate the number of these notifies accepted per second in the long run, @c 0 for no limit
+ * @param burst the number of these notifies accepted at once
+ *
+ * These notifies share one limit, whatever their kind, so a peer can't send more by changing kinds.
+ * @sa setInboundRateLimit
+ */
+void Socket::setDefaultInboundRateLimit(int rate, int burst)
+{
+    if (d != nullptr) {
+        d->defaultInboundRateLimit = {.rate = qMax(0, rate), .burst = qMax(1, burst)};
+        d->defaultInboundBucket = p::TokenBucket(d->defaultInboundRateLimit.rate, d->defaultInboundRateLimit.burst);
+    }
+}
+
+/**
+ * @brief the number of received notifies dropped because they were over their rate limit
+ * @return the number of dropped notifies
+ */
+int Socket::rateLimitedPacketCount() const
+{
+    if (d != nullptr)
+        return d->rateLimitedPacketCount;
+
+    return 0;
+}
+
 /**
  * @brief Connect to a host
  * @param host the address to connect to. The scheme decides the transport: @c qmdmm /
  *             @c qmdmms for TCP, @c ws / @c wss for WebSocket, and a plain (non-URL)
- *             string for local socket.
+ *             string for local socket. @c inproc connects to a server listening in this process by name (see
+ *             @c ServerConfiguration::inProcessName ). @c qmdmms and @c wss are encrypted with TLS, using the
+ *             default TLS configuration.
  * @return @c true if the connection is initiated successfully, @c false if the address
  *         cannot be parsed to a known transport
  */
 bool Socket::connectToHost(const QString &host)
+{
+    return connectToHost(host, QSslConfiguration::defaultConfiguration());
+}
+
+/**
+ * @brief Connect to a host
+ * @param host the address to connect to, see @c connectToHost(const QString &)
+ * @param sslConfiguration the TLS configuration used by the @c qmdmms and @c wss schemes
+ * @return @c true if the connection is initiated successfully, @c false if the address
+ *         cannot be parsed to a known transport
+ *
+ * A configuration returned by @c sslConfiguration() of a previous connection to the same host carries its session
+ * ticket, with which the server may resume the TLS session instead of doing a full handshake.
+ */
+bool Socket::connectToHost(const QString &host, const QSslConfiguration &sslConfiguration)
 {
     Type t = p::SocketP::typeByConnectAddr(host);
     if (t == TypeUnknown)
@@ -425,9 +1889,25 @@ bool Socket::connectToHost(const QString &host)
     d = p::SocketPFactory::create(t, this);
     if (d == nullptr)
         return false;
+    d->sslConfiguration = sslConfiguration;
     return d->connectToHost(host);
 }
 
+/**
+ * @brief the TLS configuration of the connection
+ * @return the configuration of an encrypted connection, or a null configuration if the connection is not encrypted
+ *
+ * On client side, the session ticket sent by the server is kept in the configuration if session persistence is
+ * enabled (see @c QSsl::SslOptionDisableSessionPersistence ).
+ */
+QSslConfiguration Socket::sslConfiguration() const
+{
+    if (d != nullptr)
+        return d->sessionSslConfiguration();
+
+    return {};
+}
+
 /**
  * @fn Socket::sendPacket(QMdmmCore::Packet packet)
  * @brief emitted when a packet should be sent to the peer
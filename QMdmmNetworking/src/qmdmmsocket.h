@@ -9,6 +9,7 @@
 
 #include <QLocalSocket>
 #include <QObject>
+#include <QSslConfiguration>
 #include <QTcpSocket>
 #include <QWebSocket>
 
@@ -41,6 +42,14 @@ public:
         TypeQTcpSocket,
         TypeQLocalSocket,
         TypeQWebSocket,
+        TypeEpoll,
+        TypeInProcess,
+    };
+
+    enum Framing : uint8_t
+    {
+        FramingDelimited,
+        FramingLengthPrefixed,
     };
 
     Q_DISABLE_COPY_MOVE(Socket);
@@ -49,15 +58,58 @@ public:
     explicit Socket(QTcpSocket *t, QObject *parent = nullptr);
     explicit Socket(QLocalSocket *l, QObject *parent = nullptr);
     explicit Socket(QWebSocket *w, QObject *parent = nullptr);
+    Socket(Type type, qintptr socketDescriptor, QObject *parent = nullptr);
 
     // ctor for Client: late-bound to a socket when connectToHost is called
     explicit Socket(QObject *parent = nullptr);
     ~Socket() override;
 
+    [[nodiscard]] Type type() const;
+
     void setHasError(bool hasError);
     [[nodiscard]] bool hasError() const;
 
+    void setCodec(QMdmmCore::Protocol::Codec codec);
+    [[nodiscard]] QMdmmCore::Protocol::Codec codec() const;
+
+    void setFraming(Framing framing);
+    [[nodiscard]] Framing framing() const;
+
+    void setMaximumFrameSize(int maximumFrameSize);
+    [[nodiscard]] int maximumFrameSize() const;
+    void setReceiveBufferSize(int receiveBufferSize);
+    [[nodiscard]] int receiveBufferSize() const;
+
+    void setBatching(bool batching);
+    [[nodiscard]] bool batching() const;
+    void setPeerMaximumFrameSize(int peerMaximumFrameSize);
+    [[nodiscard]] int peerMaximumFrameSize() const;
+
+    void setCompressionThreshold(int compressionThreshold);
+    [[nodiscard]] int compressionThreshold() const;
+    [[nodiscard]] qint64 compressedFrameCount() const;
+    [[nodiscard]] qint64 compressionInputSize() const;
+    [[nodiscard]] qint64 compressionOutputSize() const;
+    [[nodiscard]] qint64 uncompressedFrameCount() const;
+    [[nodiscard]] qint64 compressionTime() const;
+    [[nodiscard]] qint64 uncompressionTime() const;
+
+    void setOutboundHighWatermark(int outboundHighWatermark);
+    [[nodiscard]] int outboundHighWatermark() const;
+    void setOutboundLowWatermark(int outboundLowWatermark);
+    [[nodiscard]] int outboundLowWatermark() const;
+    void setMaximumOutboundSize(int maximumOutboundSize);
+    [[nodiscard]] int maximumOutboundSize() const;
+    [[nodiscard]] qint64 outboundQueueDepth() const;
+    [[nodiscard]] int droppedPacketCount() const;
+
+    void setInboundRateLimit(QMdmmCore::Protocol::NotifyId notifyId, int rate, int burst);
+    void setDefaultInboundRateLimit(int rate, int burst);
+    [[nodiscard]] int rateLimitedPacketCount() const;
+
     bool connectToHost(const QString &host);
+    bool connectToHost(const QString &host, const QSslConfiguration &sslConfiguration);
+    [[nodiscard]] QSslConfiguration sslConfiguration() const;
 
 signals:
     void sendPacket(QMdmmCore::Packet);
@@ -5,36 +5,221 @@
 
 #include "qmdmmsocket.h"
 
+#include <QElapsedTimer>
+#include <QHash>
+#include <QIODevice>
+#include <QList>
 #include <QObject>
 #include <QPointer>
+#include <QSslConfiguration>
 
 // NOLINTBEGIN(misc-non-private-member-variables-in-classes): This is private header
 namespace QMdmmNetworking {
 namespace p {
+
+// Bytes received from a stream based transport, which frames are parsed from in place.
+// The storage is allocated once and reused: bytes are read straight into its free end, and consumed bytes at
+// its beginning are reclaimed by moving the unread bytes back to the beginning when the free end runs out.
+class QMDMMNETWORKING_PRIVATE_EXPORT ReceiveBuffer final
+{
+public:
+    static constexpr qsizetype initialCapacity = 4096;
+
+    ReceiveBuffer();
+
+    [[nodiscard]] qsizetype size() const
+    {
+        return tail - head;
+    }
+
+    // A view of the unread bytes without copying, valid until the next reserve() or clear()
+    [[nodiscard]] QByteArray unread() const;
+
+    char *reserve(qsizetype size);
+    void commit(qsizetype size);
+    void consume(qsizetype size);
+    void clear();
+    // free the storage grown for a large frame once nothing is left unread in it
+    void squeeze();
+
+private:
+    QByteArray storage;
+    qsizetype head;
+    qsizetype tail;
+};
+
+// A token bucket of received packets. It holds up to `burst` tokens and gains `rate` tokens per second, and every
+// accepted packet takes one, so a peer may send a burst at once but only `rate` packets per second in the long run.
+class QMDMMNETWORKING_PRIVATE_EXPORT TokenBucket final
+{
+public:
+    TokenBucket();
+    TokenBucket(int rate, int burst);
+
+    // Take a token at a time in milliseconds. Return false if the bucket is empty
+    bool take(qint64 now);
+
+private:
+    int rate;
+    int burst;
+    double tokens;
+    qint64 last;
+};
+
 class QMDMMNETWORKING_PRIVATE_EXPORT SocketP : public QObject
 {
     Q_OBJECT
 
 public:
     static Socket::Type typeByConnectAddr(const QString &addr);
+    // Bind a socket created without a transport to one
+    static void attach(Socket *socket, SocketP *d);
+
+    // A length-prefixed frame starts with a header of 1 byte flags and 3 bytes big-endian payload size.
+    // Flags are less than 0x20 so that the header never looks like the beginning of a JSON object or a CBOR map
+    static constexpr qsizetype frameHeaderSize = 4;
+    static constexpr int frameSizeLimit = 0xffffff;
+    static constexpr uint8_t frameFlagsLimit = 0x20;
+    static constexpr int defaultMaximumFrameSize = 1048576;
+    // What a batch sent to a peer which hasn't told its maximum frame size is bounded to. Any peer accepts this much
+    static constexpr int defaultPeerMaximumFrameSize = 65536;
+    static constexpr int defaultReceiveBufferSize = 65536;
+
+    // A batch frame carries several length-prefixed frames (with no flags) as its payload, which are unpacked in order.
+    // A compressed frame carries its payload compressed by qCompress.
+    // Both are used on every transport, regardless of the framing
+    static constexpr uint8_t frameFlagBatch = 0x01;
+    static constexpr uint8_t frameFlagCompressed = 0x02;
+    static constexpr uint8_t knownFrameFlags = frameFlagBatch | frameFlagCompressed;
+
+    static void writeFrameHeader(char *header, uint8_t flags, qsizetype size);
 
     explicit SocketP(Socket *q);
     [[nodiscard]] virtual Socket::Type type() const = 0;
 
     virtual bool connectToHost(const QString &addr) = 0;
     virtual bool disconnectFromHost() = 0;
+    // drop the connection at once, without writing what is queued
+    virtual void abort() = 0;
+    // the TLS configuration of an encrypted connection, including the session ticket. A null configuration otherwise
+    [[nodiscard]] virtual QSslConfiguration sessionSslConfiguration() const = 0;
+
+    // write to the underlying transport
+    virtual void writePacket(const QMdmmCore::Packet &packet) = 0;
+    virtual void writeBatchFrame(const QByteArray &frame) = 0;
+
+    // Received bytes are bounded before anything is parsed. The transport buffers at most the receive buffer size and
+    // leaves the rest to the flow control of the connection, and the receive buffer never holds more than one maximum
+    // sized frame beyond that
+    virtual void applyReceiveLimits() = 0;
+    [[nodiscard]] qsizetype receiveBufferLimit() const;
+
+    // for stream based transports (TCP socket, local socket and epoll)
+    void streamReceived(QIODevice *device);
+    bool streamFramesReceived();
+    void frameError(const QString &errorString);
+
+    // Packets sent during one event loop iteration are queued when batching, and written together in as few batch frames
+    // as the maximum frame size of the peer allows
+    [[nodiscard]] QByteArray batchFrame(const QList<QByteArray> &payloads, qsizetype size);
+    bool batchReceived(const QByteArray &payload);
+    void flushPendingPackets();
+    virtual void writePackets(const QList<QMdmmCore::Packet> &packets);
+
+    // A payload reaching the compression threshold is compressed. A null array is returned if it is not compressed.
+    // A single packet is compressed by Packet::compress, which caches the result on the packet for all sockets sending it
+    [[nodiscard]] QByteArray compressPacket(const QMdmmCore::Packet &packet, qsizetype size);
+    [[nodiscard]] QByteArray compressPayload(const char *data, qsizetype size);
+    [[nodiscard]] QByteArray countCompressed(const QByteArray &compressed, qsizetype size);
+    bool frameReceived(uint8_t flags, const QByteArray &payload);
+
+    // Outbound backpressure. The outbound queue is what the socket holds back (see SocketP_Stream) plus what the transport
+    // has not written yet. Above the high watermark non-essential packets are dropped until the queue drains to the low
+    // watermark, and a peer whose queue exceeds the maximum is disconnected
+    [[nodiscard]] virtual qint64 bytesToWrite() const = 0;
+    [[nodiscard]] virtual qint64 outboundQueueDepth() const;
+    // drop what is held back and not handed to the transport yet
+    virtual void discardOutbound();
+    [[nodiscard]] static bool isDroppable(const QMdmmCore::Packet &packet);
+    bool checkOutbound();
+
+    // Inbound rate limiting of notifies, with one token bucket per NotifyId which has a limit of its own. Every other
+    // notify, including one of an unknown NotifyId, takes from the one default bucket, so a peer can't escape the limit by
+    // changing NotifyIds. A rate of 0 means no limit. Notifies over the limit are dropped
+    struct RateLimit
+    {
+        int rate = 0;
+        int burst = 0;
+    };
+    bool acceptInbound(const QMdmmCore::Packet &packet);
 
     Socket *q;
     bool hasError;
+    QMdmmCore::Protocol::Codec codec;
+    Socket::Framing framing;
+    int maximumFrameSize;
+    int peerMaximumFrameSize;
+    int receiveBufferSize;
+    ReceiveBuffer receiveBuffer;
+    qsizetype delimiterScanned;
+    bool batching;
+    QList<QMdmmCore::Packet> pendingPackets;
+    // the size of the frames of pendingPackets, which count to the outbound queue until they are flushed
+    qint64 pendingBytes;
+    int compressionThreshold;
+    qint64 compressedFrameCount;
+    qint64 compressionInputSize;
+    qint64 compressionOutputSize;
+    qint64 uncompressedFrameCount;
+    // in nanoseconds, reported in total when the socket is disconnected
+    qint64 compressionTime;
+    qint64 uncompressionTime;
+    int outboundLowWatermark;
+    int outboundHighWatermark;
+    int maximumOutboundSize;
+    bool congested;
+    int droppedPacketCount;
+    // used by connectToHost for the encrypted transports
+    QSslConfiguration sslConfiguration;
+    QHash<int, RateLimit> inboundRateLimits;
+    RateLimit defaultInboundRateLimit;
+    QHash<int, TokenBucket> inboundBuckets;
+    TokenBucket defaultInboundBucket;
+    QElapsedTimer inboundClock;
+    int rateLimitedPacketCount;
 
 public slots: // NOLINT(readability-redundant-access-specifiers)
-    virtual void sendPacket(QMdmmCore::Packet packet) = 0;
+    void sendPacket(QMdmmCore::Packet packet);
     bool packetReceived(const QByteArray &arr);
     void socketDisconnected();
     void errorOccurred(const QString &errorString);
 };
 
-class QMDMMNETWORKING_PRIVATE_EXPORT SocketP_QTcpSocket : public SocketP
+// The base of stream based transports. They cork the frames written during one event loop iteration, and write them with
+// one write and one flush after the iteration, so a burst of packets costs one system call instead of one per packet
+class QMDMMNETWORKING_PRIVATE_EXPORT SocketP_Stream : public SocketP
+{
+    Q_OBJECT
+
+public:
+    explicit SocketP_Stream(Socket *q);
+
+    [[nodiscard]] qint64 outboundQueueDepth() const override;
+    void discardOutbound() override;
+    void writePacket(const QMdmmCore::Packet &packet) override;
+    void writeBatchFrame(const QByteArray &frame) override;
+
+    void appendStreamFrame(QByteArray *frames, const QMdmmCore::Packet &packet);
+    void corkStreamFrame(const QMdmmCore::Packet &packet);
+    void uncork();
+    // Whether there is a stream to write to. Nothing is corked without one
+    [[nodiscard]] virtual bool streamOpen() const = 0;
+    virtual void writeStreamFrames(const QByteArray &frames) = 0;
+
+    QByteArray corkedFrames;
+};
+
+class QMDMMNETWORKING_PRIVATE_EXPORT SocketP_QTcpSocket : public SocketP_Stream
 {
     Q_OBJECT
 
@@ -49,17 +234,23 @@ public:
 
     bool connectToHost(const QString &addr) override;
     bool disconnectFromHost() override;
+    void abort() override;
+    [[nodiscard]] qint64 bytesToWrite() const override;
+    [[nodiscard]] QSslConfiguration sessionSslConfiguration() const override;
+    [[nodiscard]] bool streamOpen() const override;
+    void writeStreamFrames(const QByteArray &frames) override;
+    void applyReceiveLimits() override;
 
     QPointer<QTcpSocket> socket;
     void setupSocket();
 
 public slots: // NOLINT(readability-redundant-access-specifiers)
-    void sendPacket(QMdmmCore::Packet packet) override;
+    void setLowDelay();
     void readyRead();
     void errorOccurredTcpSocket(QAbstractSocket::SocketError e);
 };
 
-class QMDMMNETWORKING_PRIVATE_EXPORT SocketP_QLocalSocket : public SocketP
+class QMDMMNETWORKING_PRIVATE_EXPORT SocketP_QLocalSocket : public SocketP_Stream
 {
     Q_OBJECT
 
@@ -74,12 +265,17 @@ public:
 
     bool connectToHost(const QString &addr) override;
     bool disconnectFromHost() override;
+    void abort() override;
+    [[nodiscard]] qint64 bytesToWrite() const override;
+    [[nodiscard]] QSslConfiguration sessionSslConfiguration() const override;
+    [[nodiscard]] bool streamOpen() const override;
+    void writeStreamFrames(const QByteArray &frames) override;
+    void applyReceiveLimits() override;
 
     QPointer<QLocalSocket> socket;
     void setupSocket();
 
 public slots: // NOLINT(readability-redundant-access-specifiers)
-    void sendPacket(QMdmmCore::Packet packet) override;
     void readyRead();
     void errorOccurredLocalSocket(QLocalSocket::LocalSocketError e);
 };
@@ -99,20 +295,86 @@ public:
 
     bool connectToHost(const QString &addr) override;
     bool disconnectFromHost() override;
+    void abort() override;
+    [[nodiscard]] qint64 bytesToWrite() const override;
+    [[nodiscard]] QSslConfiguration sessionSslConfiguration() const override;
+    void writePacket(const QMdmmCore::Packet &packet) override;
+    void writeBatchFrame(const QByteArray &frame) override;
+    void applyReceiveLimits() override;
 
     QPointer<QWebSocket> socket;
     void setupSocket();
 
 public slots: // NOLINT(readability-redundant-access-specifiers)
-    void sendPacket(QMdmmCore::Packet packet) override;
+    void messageReceived(const QByteArray &message);
     void errorOccurredWebSocket(QAbstractSocket::SocketError e);
 };
 
+// One end of a connection between two sockets in the same process. Packets are handed to the other end as they are
+// through queued calls, so nothing is serialized and no kernel is involved. The ends may live in different threads
+class QMDMMNETWORKING_PRIVATE_EXPORT SocketP_InProcess : public SocketP
+{
+    Q_OBJECT
+
+public:
+    explicit SocketP_InProcess(Socket *q);
+    ~SocketP_InProcess() override;
+
+    [[nodiscard]] Socket::Type type() const override
+    {
+        return Socket::TypeInProcess;
+    }
+
+    bool connectToHost(const QString &addr) override;
+    bool disconnectFromHost() override;
+    void abort() override;
+    [[nodiscard]] qint64 bytesToWrite() const override;
+    [[nodiscard]] QSslConfiguration sessionSslConfiguration() const override;
+    void writePacket(const QMdmmCore::Packet &packet) override;
+    void writeBatchFrame(const QByteArray &frame) override;
+    void writePackets(const QList<QMdmmCore::Packet> &packets) override;
+    void applyReceiveLimits() override;
+
+    // called in the thread of this end
+    void peerAccepted(SocketP_InProcess *server);
+    void packetsDelivered(const QList<QMdmmCore::Packet> &packets);
+    void peerDisconnected();
+
+    QPointer<SocketP_InProcess> peer;
+    // connectToHost was called and the server has not accepted yet
+    bool connecting;
+};
+
+// Where in-process sockets connect to. It is registered under its name while listening
+class QMDMMNETWORKING_PRIVATE_EXPORT InProcessServer final : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit InProcessServer(QObject *parent = nullptr);
+    ~InProcessServer() override;
+
+    bool listen(const QString &name);
+    void close();
+
+    // Ask the server listening under the name to accept the client. Return false if no server is listening
+    static bool connectToServer(const QString &name, SocketP_InProcess *client);
+
+signals:
+    void newConnection(QMdmmNetworking::Socket *socket);
+
+private:
+    void accept(const QPointer<SocketP_InProcess> &client);
+
+    QString name;
+};
+
 namespace SocketPFactory {
 QMDMMNETWORKING_PRIVATE_EXPORT SocketP *create(QLocalSocket *l, Socket *p);
 QMDMMNETWORKING_PRIVATE_EXPORT SocketP *create(QTcpSocket *t, Socket *p);
 QMDMMNETWORKING_PRIVATE_EXPORT SocketP *create(QWebSocket *w, Socket *p);
 QMDMMNETWORKING_PRIVATE_EXPORT SocketP *create(Socket::Type type, Socket *p);
+QMDMMNETWORKING_PRIVATE_EXPORT SocketP *create(Socket::Type type, qintptr socketDescriptor, Socket *p);
 } // namespace SocketPFactory
 } // namespace p
 } // namespace QMdmmNetworking
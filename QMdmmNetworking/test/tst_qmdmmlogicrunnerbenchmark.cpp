@@ -0,0 +1,143 @@
+#include "test.h"
+
+#include <QMdmmAgent>
+#include <QMdmmLogicConfiguration>
+#include <QMdmmLogicRunner>
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QList>
+#include <QTest>
+#include <QThread>
+
+#include <algorithm>
+
+#ifdef Q_OS_LINUX
+#include <sys/resource.h>
+#endif
+
+// NOLINTBEGIN
+
+using namespace QMdmmCore;
+using namespace QMdmmNetworking;
+
+namespace {
+#ifdef Q_OS_LINUX
+// The number of threads of this process
+int threadCount()
+{
+    QFile status(QStringLiteral("/proc/self/status"));
+    if (!status.open(QIODevice::ReadOnly))
+        return -1;
+
+    while (!status.atEnd()) {
+        QByteArray line = status.readLine();
+        if (line.startsWith("Threads:"))
+            return line.mid(8).trimmed().toInt();
+    }
+
+    return -1;
+}
+
+// Voluntary and involuntary context switches of every thread of this process
+long contextSwitches()
+{
+    rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+#endif
+} // namespace
+
+// Numbers of many simultaneous rooms sharing the logic worker pool. Run this executable alone for stable results, ctest
+// only checks that it works.
+class tst_QMdmmLogicRunnerBenchmark : public QObject
+{
+    Q_OBJECT
+
+public:
+    Q_INVOKABLE tst_QMdmmLogicRunnerBenchmark() = default;
+
+private slots:
+    void simultaneousRooms_data()
+    {
+        QTest::addColumn<int>("roomCount");
+
+        QTest::addRow("1000 rooms") << 1000;
+        QTest::addRow("4000 rooms") << 4000;
+    }
+
+    // Every room is filled by two local agents, which starts its round. The logic of the room then asks both agents for
+    // a Stone-Scissors-Cloth through its worker. The latency of a room is from its creation to the first request, the
+    // result is the mean of every room in milliseconds. Threads and context switches are printed
+    void simultaneousRooms()
+    {
+        QFETCH(int, roomCount);
+
+        LogicConfiguration conf = LogicConfiguration::defaults();
+        conf.setPlayerNumPerRoom(2);
+        conf.setRequestTimeout(60000);
+
+#ifdef Q_OS_LINUX
+        int threadsBefore = threadCount();
+        long switchesBefore = contextSwitches();
+#endif
+
+        QElapsedTimer clock;
+        clock.start();
+
+        QList<LogicRunner *> runners;
+        QList<qint64> createdAt(roomCount, 0);
+        QList<qint64> requestedAt(roomCount, -1);
+        int requested = 0;
+        runners.reserve(roomCount);
+
+        for (int i = 0; i < roomCount; ++i) {
+            auto *runner = new LogicRunner(conf);
+            createdAt[i] = clock.nsecsElapsed();
+            for (int j = 0; j < 2; ++j) {
+                auto *agent = new Agent(QStringLiteral("room%1player%2").arg(i).arg(j), runner);
+                connect(agent, &Agent::stoneScissorsClothRequested, [&, i]() {
+                    if (requestedAt[i] == -1) {
+                        requestedAt[i] = clock.nsecsElapsed();
+                        ++requested;
+                    }
+                });
+                runner->addAgent(agent);
+            }
+            runners << runner;
+        }
+
+        QTRY_COMPARE_WITH_TIMEOUT(requested, roomCount, 30000);
+
+        qint64 latency = 0;
+        qint64 maximumLatency = 0;
+        for (int i = 0; i < roomCount; ++i) {
+            latency += requestedAt[i] - createdAt[i];
+            maximumLatency = std::max(maximumLatency, requestedAt[i] - createdAt[i]);
+        }
+
+#ifdef Q_OS_LINUX
+        int threads = threadCount() - threadsBefore;
+        long switches = contextSwitches() - switchesBefore;
+        qInfo("%d rooms: %d threads started, %ld context switches, %.3f ms maximum latency", roomCount, threads, switches,
+              static_cast<double>(maximumLatency) / 1000000);
+
+        // The rooms share the pool instead of having a thread each
+        QVERIFY(threads <= std::max(QThread::idealThreadCount(), 1));
+#endif
+
+        // Deleting the rooms never waits for a worker
+        QElapsedTimer teardown;
+        teardown.start();
+        qDeleteAll(runners);
+        qInfo("%d rooms: %.3f ms to delete", roomCount, static_cast<double>(teardown.nsecsElapsed()) / 1000000);
+
+        QTest::setBenchmarkResult(static_cast<qreal>(latency) / roomCount / 1000000, QTest::WalltimeMilliseconds);
+    }
+};
+
+namespace {
+RegisterTestObject<tst_QMdmmLogicRunnerBenchmark> _;
+}
+#include "tst_qmdmmlogicrunnerbenchmark.moc"
@@ -0,0 +1,163 @@
+// SPDX-License-Identifier: AGPL-3.0-or-later
+
+#include "test.h"
+
+#include <QMdmmPacket>
+#include <QMdmmSocket>
+
+#include <QJsonObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTest>
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+
+// NOLINTBEGIN
+
+// Heap allocations are counted by replacing malloc of the whole process, which catches both Qt containers and operator new.
+// The replacement relies on glibc exporting its allocator under another name.
+#if defined(__GLIBC__)
+#define QMDMM_COUNT_ALLOCATIONS
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+}
+
+namespace {
+std::atomic<bool> counting;
+std::atomic<int> allocations;
+
+inline void countAllocation()
+{
+    if (counting.load(std::memory_order_relaxed))
+        allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void startCounting()
+{
+    allocations.store(0);
+    counting.store(true);
+}
+
+int stopCounting()
+{
+    counting.store(false);
+    return allocations.load();
+}
+} // namespace
+
+extern "C" void *malloc(size_t size) noexcept
+{
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) noexcept
+{
+    countAllocation();
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) noexcept
+{
+    countAllocation();
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+using namespace QMdmmCore;
+using namespace QMdmmNetworking;
+
+class tst_QMdmmSocketAllocation : public QObject
+{
+    Q_OBJECT
+
+public:
+    Q_INVOKABLE tst_QMdmmSocketAllocation() = default;
+
+private slots:
+    // A burst of typical RequestAction replies as received by the server, once the way the receive path used to read
+    // them, where readLine() copied every frame out of the socket before it was parsed, and once through Socket, whose
+    // receive buffer reads from the socket and hands out a view of every frame in place.
+    // Each burst is received once before it is counted, in order not to count allocations made only once
+    void SocketreceiveInPlace()
+    {
+#ifndef QMDMM_COUNT_ALLOCATIONS
+        QSKIP("Allocations can't be counted on this platform");
+#else
+        QJsonObject action;
+        action.insert(QStringLiteral("action"), 4);
+        action.insert(QStringLiteral("toPlayer"), QStringLiteral("Fsu0414"));
+        action.insert(QStringLiteral("toPlace"), 0);
+        Packet reply(Protocol::TypeReply, Protocol::RequestAction, action);
+
+        constexpr int packetCount = 200;
+        QByteArray stream;
+        for (int i = 0; i < packetCount; ++i)
+            stream.append(reply.serialize(Protocol::CodecJson)).append('\n');
+
+        QTcpServer listener;
+        QVERIFY(listener.listen(QHostAddress::LocalHost, 16397));
+
+        int copied = 0;
+        {
+            QTcpSocket peer;
+            peer.connectToHost(QStringLiteral("localhost"), 16397);
+            QTRY_VERIFY_WITH_TIMEOUT(listener.hasPendingConnections(), 5000);
+            std::unique_ptr<QTcpSocket> receiver(listener.nextPendingConnection());
+
+            int received = 0;
+            connect(receiver.get(), &QTcpSocket::readyRead, [&receiver, &received]() {
+                while (receiver->canReadLine()) {
+                    Packet packet = Packet::deserialize(receiver->readLine());
+                    if (!packet.hasError())
+                        ++received;
+                }
+            });
+
+            peer.write(stream);
+            QTRY_COMPARE_WITH_TIMEOUT(received, packetCount, 5000);
+
+            received = 0;
+            startCounting();
+            peer.write(stream);
+            QTRY_COMPARE_WITH_TIMEOUT(received, packetCount, 5000);
+            copied = stopCounting();
+        }
+
+        int inPlace = 0;
+        {
+            QTcpSocket peer;
+            peer.connectToHost(QStringLiteral("localhost"), 16397);
+            QTRY_VERIFY_WITH_TIMEOUT(listener.hasPendingConnections(), 5000);
+            Socket receiver(listener.nextPendingConnection());
+
+            int received = 0;
+            connect(&receiver, &Socket::packetReceived, [&received]() { ++received; });
+
+            peer.write(stream);
+            QTRY_COMPARE_WITH_TIMEOUT(received, packetCount, 5000);
+
+            received = 0;
+            startCounting();
+            peer.write(stream);
+            QTRY_COMPARE_WITH_TIMEOUT(received, packetCount, 5000);
+            inPlace = stopCounting();
+            QVERIFY(!receiver.hasError());
+        }
+
+        qInfo("%d RequestAction replies: %d allocations copied, %d allocations in place", packetCount, copied, inPlace);
+        // readLine() allocated every frame it copied out
+        QVERIFY(copied - inPlace >= packetCount);
+#endif
+    }
+};
+
+namespace {
+RegisterTestObject<tst_QMdmmSocketAllocation> _;
+}
+#include "tst_qmdmmsocketallocation.moc"
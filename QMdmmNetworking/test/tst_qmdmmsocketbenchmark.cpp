@@ -0,0 +1,282 @@
+#include "test.h"
+
+#include <QMdmmLogicConfiguration>
+#include <QMdmmPacket>
+#include <QMdmmServer>
+
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QFile>
+#include <QTcpSocket>
+#include <QTest>
+#include <QThread>
+#include <QTimer>
+
+#ifdef Q_OS_LINUX
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// NOLINTBEGIN
+
+using namespace QMdmmCore;
+using namespace QMdmmNetworking;
+
+namespace {
+constexpr int idleConnectionCount = 200;
+constexpr int roundTripCount = 1000;
+constexpr int concurrentClientCount = 8;
+
+ServerConfiguration benchmarkConfiguration(int port, bool epoll)
+{
+    ServerConfiguration serverConf = ServerConfiguration::defaults();
+    serverConf.setTcpPort(port);
+    serverConf.setEpollEnabled(epoll);
+    serverConf.setLocalEnabled(false);
+    serverConf.setWebsocketEnabled(false);
+    // pings are not throttled
+    serverConf.setNotifyRateLimit(0);
+    return serverConf;
+}
+
+void addBackendRows(int port)
+{
+    QTest::addColumn<bool>("epoll");
+    QTest::addColumn<int>("port");
+
+    QTest::addRow("qt") << false << port;
+#ifdef Q_OS_LINUX
+    QTest::addRow("epoll") << true << (port + 1);
+#endif
+}
+
+#ifdef Q_OS_LINUX
+// The resident set size of this process in bytes
+qint64 residentSize()
+{
+    QFile statm(QStringLiteral("/proc/self/statm"));
+    if (!statm.open(QIODevice::ReadOnly))
+        return -1;
+
+    QList<QByteArray> fields = statm.readAll().split(' ');
+    if (fields.size() < 2)
+        return -1;
+
+    return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+}
+
+// A plain blocking connection, so that only its server side costs Qt objects
+int connectRaw(int port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+        return -1;
+
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0)
+        return fd;
+
+    ::close(fd);
+    return -1;
+}
+
+// Whether the server has sent NotifyVersion to every connection, i.e. has accepted and set up all of them
+bool allGreeted(const QList<int> &fds)
+{
+    for (int fd : fds) {
+        pollfd readable {fd, POLLIN, 0};
+        if (::poll(&readable, 1, 0) != 1)
+            return false;
+    }
+
+    return true;
+}
+#endif
+} // namespace
+
+// Numbers to compare the server transports against: the Qt backend (QTcpServer / QTcpSocket) and the epoll backend, and
+// the throughput of the server against the number of its IO threads.
+// Run this executable alone for stable results, ctest only checks that it works.
+class tst_QMdmmSocketBenchmark : public QObject
+{
+    Q_OBJECT
+
+public:
+    Q_INVOKABLE tst_QMdmmSocketBenchmark() = default;
+
+private slots:
+    void idleConnections_data()
+    {
+        addBackendRows(16376);
+    }
+
+    // Memory of the server side of an idle connection in bytes, from the growth of the resident set size
+    void idleConnections()
+    {
+#ifndef Q_OS_LINUX
+        QSKIP("The resident set size is read from /proc");
+#else
+        QFETCH(bool, epoll);
+        QFETCH(int, port);
+
+        Server server(benchmarkConfiguration(port, epoll), LogicConfiguration::defaults());
+        QVERIFY(server.listen());
+
+        // The first connection allocates what all of them share
+        int warmUp = connectRaw(port);
+        QVERIFY(warmUp != -1);
+        QTRY_VERIFY_WITH_TIMEOUT(allGreeted(QList<int> {warmUp}), 5000);
+
+        qint64 before = residentSize();
+        QList<int> fds;
+        for (int i = 0; i < idleConnectionCount; ++i) {
+            int fd = connectRaw(port);
+            QVERIFY(fd != -1);
+            fds << fd;
+            // accept before the listen backlog is full
+            QCoreApplication::processEvents();
+        }
+        QTRY_VERIFY_WITH_TIMEOUT(allGreeted(fds), 10000);
+        qint64 after = residentSize();
+
+        for (int fd : fds)
+            ::close(fd);
+        ::close(warmUp);
+
+        QVERIFY(before > 0 && after > 0);
+        QTest::setBenchmarkResult(static_cast<qreal>(after - before) / idleConnectionCount, QTest::BytesAllocated);
+#endif
+    }
+
+    void pingRoundTrips_data()
+    {
+        addBackendRows(16378);
+    }
+
+    // 1000 pings written at once and their pongs read back through one connection. Packets per second is twice 1000
+    // divided by the time of an iteration
+    void pingRoundTrips()
+    {
+        QFETCH(bool, epoll);
+        QFETCH(int, port);
+
+        Server server(benchmarkConfiguration(port, epoll), LogicConfiguration::defaults());
+        QVERIFY(server.listen());
+
+        QTcpSocket client;
+        client.connectToHost(QStringLiteral("localhost"), port);
+        QTRY_VERIFY_WITH_TIMEOUT(client.canReadLine(), 5000);
+        client.readAll();
+
+        QByteArray pings;
+        for (int i = 0; i < roundTripCount; ++i)
+            pings.append(Protocol::notifyPacket<Protocol::NotifyPingServer>(i).serialize()).append('\n');
+
+        QEventLoop loop;
+        QTimer timeout;
+        timeout.setSingleShot(true);
+        connect(&timeout, &QTimer::timeout, &loop, &QEventLoop::quit);
+
+        int pongs = 0;
+        connect(&client, &QTcpSocket::readyRead, [&]() {
+            while (client.canReadLine()) {
+                client.readLine();
+                if (++pongs == roundTripCount)
+                    loop.quit();
+            }
+        });
+
+        QBENCHMARK {
+            pongs = 0;
+            client.write(pings);
+            timeout.start(10000);
+            loop.exec();
+            QCOMPARE(pongs, roundTripCount);
+        }
+    }
+
+    void ioThreadRoundTrips_data()
+    {
+        QTest::addColumn<int>("ioThreads");
+        QTest::addColumn<int>("port");
+
+        int port = 16380;
+        for (int ioThreads : {0, 1, 2, 4}) {
+            if (ioThreads <= QThread::idealThreadCount())
+                QTest::addRow("%d IO threads", ioThreads) << ioThreads << port;
+            ++port;
+        }
+    }
+
+    // 8 clients in 4 rooms write 1000 pings each at once and read their pongs back. Packets per second is twice 8000
+    // divided by the time of an iteration. The rooms are spread over the IO threads, which parse the pings and encode
+    // the pongs of their connections
+    void ioThreadRoundTrips()
+    {
+        QFETCH(int, ioThreads);
+        QFETCH(int, port);
+
+        ServerConfiguration serverConf = benchmarkConfiguration(port, false);
+        serverConf.setIoThreadCount(ioThreads);
+        LogicConfiguration conf = LogicConfiguration::defaults();
+        conf.setPlayerNumPerRoom(2);
+        conf.setRequestTimeout(60000);
+
+        Server server(serverConf, conf);
+        QVERIFY(server.listen());
+
+        QByteArray pings;
+        for (int i = 0; i < roundTripCount; ++i)
+            pings.append(Protocol::notifyPacket<Protocol::NotifyPingServer>(i).serialize()).append('\n');
+
+        QEventLoop loop;
+        QTimer timeout;
+        timeout.setSingleShot(true);
+        connect(&timeout, &QTimer::timeout, &loop, &QEventLoop::quit);
+
+        int pongs = 0;
+        QList<QTcpSocket *> clients;
+        for (int n = 0; n < concurrentClientCount; ++n) {
+            auto *client = new QTcpSocket(&server);
+            client->connectToHost(QStringLiteral("localhost"), port);
+            QTRY_VERIFY_WITH_TIMEOUT(client->canReadLine(), 5000);
+            client->readAll();
+
+            Protocol::SignInNotify signIn;
+            signIn.playerName = QStringLiteral("benchmark%1").arg(n);
+            signIn.screenName = signIn.playerName;
+            signIn.agentState = Data::StateOnline;
+            client->write(Protocol::notifyPacket<Protocol::NotifySignIn>(signIn).serialize().append('\n'));
+
+            connect(client, &QTcpSocket::readyRead, [&, client]() {
+                while (client->canReadLine()) {
+                    if (Packet::fromJson(client->readLine().trimmed()).notifyId() == Protocol::NotifyPongServer && ++pongs == concurrentClientCount * roundTripCount)
+                        loop.quit();
+                }
+            });
+            clients << client;
+        }
+
+        // Let the sockets move to the IO threads of their rooms
+        QTest::qWait(100);
+
+        QBENCHMARK {
+            pongs = 0;
+            for (QTcpSocket *client : clients)
+                client->write(pings);
+            timeout.start(10000);
+            loop.exec();
+            QCOMPARE(pongs, concurrentClientCount * roundTripCount);
+        }
+    }
+};
+
+namespace {
+RegisterTestObject<tst_QMdmmSocketBenchmark> _;
+}
+#include "tst_qmdmmsocketbenchmark.moc"
@@ -24,6 +24,7 @@ static const QString helpText = QStringLiteral(R"help(
 TCP options:
 -t --tcp=<on/off> Enable TCP
 -p --tcp-port=<port> TCP listen port
+-x --epoll=<on/off> Serve TCP with the epoll backend (Linux only, not used with TLS)
 
 LocalSocket options:
 -l --local=<on/off> Enable local socket
@@ -34,6 +35,29 @@ WebSocket options:
 -W --websocket-name=<name> WebSocket name
 -P --websocket-port=<port> WebSocket listen port
 
+Connection options:
+-F --maximum-frame-size=<1~16777215> maximum size of a received frame in bytes
+-b --receive-buffer-size=<1~> received bytes buffered for a client before reading from it pauses
+-Z --compression-threshold=<0~16777215> minimum size of a compressed frame in bytes, 0 to disable compression
+-u --outbound-low-watermark=<0~> size of an outbound queue to drain to before sending chats again in bytes
+-U --outbound-high-watermark=<0~> size of an outbound queue to drop chats from in bytes, 0 to never drop them
+-O --maximum-outbound-size=<0~> maximum size of an outbound queue in bytes, 0 for no limit
+-e --tls-certificate=<file> PEM certificate (chain) file, encrypts TCP and WebSocket with TLS
+-E --tls-private-key=<file> PEM private key file of the certificate
+-y --speak-rate-limit=<0~> chat messages accepted from a client per second, 0 for no limit
+-Y --speak-burst=<1~> chat messages accepted from a client at once
+-a --notify-rate-limit=<0~> other notifies accepted from a client per second, 0 for no limit
+-A --notify-burst=<1~> other notifies accepted from a client at once
+-I --io-threads=<0~> threads serving the TCP connections of rooms, 0 to serve them on the main thread
+-B --matchmaking-interval=<0~> milliseconds new players are collected for before seating them in rooms
+-G --recruiting-rooms=<1~> rooms recruiting players at once
+-T --latency-tolerance=<0~> largest sign in round trip difference in milliseconds among players of a room, 0 to not group them
+-D --room-pool-size=<0~> idle rooms kept ready for new games
+-J --journal-directory=<directory> directory of the journals of running games, which are recovered after a restart
+-N --maximum-connections=<0~> connections served at once, 0 for no limit
+-H --sign-in-timeout=<0~> milliseconds a connection has to sign in, 0 for no limit
+-q --idle-timeout=<0~> milliseconds a connection not signed in may stay silent, 0 for no limit
+
 LogicRunner configurations:
 -n --players=<2~> player number per Room
 -o --timeout=<0,15~> operation timeout
@@ -60,8 +84,8 @@ Configuration saves / examining (Only one of following can be specified):
 
 // NOLINTNEXTLINE(readability-avoid-unconditional-preprocessor-if)
 #if 0
-ab  e g  j    q  u  xy
-AB DEFGHIJ NO Q TUV XYZ
+      g  j
+              Q   V X
 01
 #endif
 
@@ -78,6 +102,7 @@ Config::Config()
 
     parser.addOption(QCommandLineOption(QStringList {QStringLiteral("t"), QStringLiteral("tcp")}, {}, QStringLiteral("on/off")));
     parser.addOption(QCommandLineOption(QStringList {QStringLiteral("p"), QStringLiteral("tcp-port")}, {}, QStringLiteral("port")));
+    parser.addOption(QCommandLineOption(QStringList {QStringLiteral("x"), QStringLiteral("epoll")}, {}, QStringLiteral("on/off")));
 
     parser.addOption(QCommandLineOption(QStringList {QStringLiteral("l"), QStringLiteral("local")}, {}, QStringLiteral("on/off")));
     parser.addOption(QCommandLineOption(QStringList {QStringLiteral("L"), QStringLiteral("local-name")}, {}, QStringLiteral("name")));
@@ -86,6 +111,28 @@ Config::Config()
     parser.addOption(QCommandLineOption(QStringList {QStringLiteral("W"), QStringLiteral("websocket-name")}, {}, QStringLiteral("name")));
     parser.addOption(QCommandLineOption(QStringList {QStringLiteral("P"), QStringLiteral("websocket-port")}, {}, QStringLiteral("port")));
 
+    parser.addOption(QCommandLineOption(QStringList {QStringLiteral("F"), QStringLiteral("maximum-frame-size")}, {}, QStringLiteral("1~16777215")));
+    parser.addOption(QCommandLineOption(QStringList {QStringLiteral("b"), QStringLiteral("receive-buffer-size")}, {}, QStringLiteral("1~")));
+    parser.addOption(QCommandLineOption(QStringList {QStringLiteral("Z"), QStringLiteral("compression-threshold")}, {}, QStringLiteral("0~16777215")));
+    parser.addOption(QCommandLineOption(QStringList {QStringLiteral("u"), QStringLiteral("outbound-low-watermark")}, {}, QStringLiteral("0~")));
+    parser.addOption(QCommandLineOption(QStringList {QStringLiteral("U"), QStringLiteral("outbound-high-watermark")}, {}, QStringLiteral("0~")));
+    parser.addOption(QCommandLineOption(QStringList {QStringLiteral("O"), QStringLiteral("maximum-outbound-size")}, {}, QStringLiteral("0~")));
+    parser.addOption(QCommandLineOption(QStringList {QStringLiteral("e"), QStringLiteral("tls-certificate")}, {}, QStringLiteral("file")));
+    parser.addOption(QCommandLineOption(QStringList {QStringLiteral("E"), QStringLiteral("tls-private-key")}, {}, QStringLiteral("file")));
+    parser.addOption(QCommandLineOption(QStringList {QStringLiteral("y"), QStringLiteral("speak-rate-limit")}, {}, QStringLiteral("0~")));
+    parser.addOption(QCommandLineOption(QStringList {QStringLiteral("Y"), QStringLiteral("speak-burst")}, {}, QStringLiteral("1~")));
+    parser.addOption(QCommandLineOption(QStringList {QStringLiteral("a"), QStringLiteral("notify-rate-limit")}, {}, QStringLiteral("0~")));
+    parser.addOption(QCommandLineOption(QStringList {QStringLiteral("A"), QStringLiteral("notify-burst")}, {}, QStringLiteral("1~")));
+    parser.addOption(QCommandLineOption(QStringList {QStringLiteral("I"), QStringLiteral("io-threads")}, {}, QStringLiteral("0~")));
+    parser.addOption(QCommandLineOption(QStringList {QStringLiteral("B"), QStringLiteral("matchmaking-interval")}, {}, QStringLiteral("0~")));
+    parser.addOption(QCommandLineOption(QStringList {QStringLiteral("G"), QStringLiteral("recruiting-rooms")}, {}, QStringLiteral("1~")));
+    parser.addOption(QCommandLineOption(QStringList {QStringLiteral("T"), QStringLiteral("latency-tolerance")}, {}, QStringLiteral("0~")));
+    parser.addOption(QCommandLineOption(QStringList {QStringLiteral("D"), QStringLiteral("room-pool-size")}, {}, QStringLiteral("0~")));
+    parser.addOption(QCommandLineOption(QStringList {QStringLiteral("J"), QStringLiteral("journal-directory")}, {}, QStringLiteral("directory")));
+    parser.addOption(QCommandLineOption(QStringList {QStringLiteral("N"), QStringLiteral("maximum-connections")}, {}, QStringLiteral("0~")));
+    parser.addOption(QCommandLineOption(QStringList {QStringLiteral("H"), QStringLiteral("sign-in-timeout")}, {}, QStringLiteral("0~")));
+    parser.addOption(QCommandLineOption(QStringList {QStringLiteral("q"), QStringLiteral("idle-timeout")}, {}, QStringLiteral("0~")));
+
     parser.addOption(QCommandLineOption(QStringList {QStringLiteral("n"), QStringLiteral("players")}, {}, QStringLiteral("2~")));
 
     parser.addOption(QCommandLineOption(QStringList {QStringLiteral("2")}));
@@ -284,11 +331,33 @@ void Config::read_(QMdmmCore::Settings *setting, QCommandLineParser *parser)
 
     CONFIG_ITEM(bool, serverConfiguration_, "tcp", stringToBool, TcpEnabled);
     CONFIG_ITEM(uint16_t, serverConfiguration_, "tcp-port", stringToUint16, TcpPort);
+    CONFIG_ITEM(bool, serverConfiguration_, "epoll", stringToBool, EpollEnabled);
     CONFIG_ITEM(bool, serverConfiguration_, "local", stringToBool, LocalEnabled);
     CONFIG_ITEM(QString, serverConfiguration_, "local-name", , LocalSocketName);
     CONFIG_ITEM(bool, serverConfiguration_, "websocket", stringToBool, WebsocketEnabled);
     CONFIG_ITEM(QString, serverConfiguration_, "websocket-name", , WebsocketName);
     CONFIG_ITEM(uint16_t, serverConfiguration_, "websocket-port", stringToUint16, WebsocketPort);
+    CONFIG_ITEM(int, serverConfiguration_, "maximum-frame-size", stringToInt, MaximumFrameSize);
+    CONFIG_ITEM(int, serverConfiguration_, "receive-buffer-size", stringToInt, ReceiveBufferSize);
+    CONFIG_ITEM(int, serverConfiguration_, "compression-threshold", stringToInt, CompressionThreshold);
+    CONFIG_ITEM(int, serverConfiguration_, "outbound-low-watermark", stringToInt, OutboundLowWatermark);
+    CONFIG_ITEM(int, serverConfiguration_, "outbound-high-watermark", stringToInt, OutboundHighWatermark);
+    CONFIG_ITEM(int, serverConfiguration_, "maximum-outbound-size", stringToInt, MaximumOutboundSize);
+    CONFIG_ITEM(QString, serverConfiguration_, "tls-certificate", , TlsCertificate);
+    CONFIG_ITEM(QString, serverConfiguration_, "tls-private-key", , TlsPrivateKey);
+    CONFIG_ITEM(int, serverConfiguration_, "speak-rate-limit", stringToInt, SpeakRateLimit);
+    CONFIG_ITEM(int, serverConfiguration_, "speak-burst", stringToInt, SpeakBurst);
+    CONFIG_ITEM(int, serverConfiguration_, "notify-rate-limit", stringToInt, NotifyRateLimit);
+    CONFIG_ITEM(int, serverConfiguration_, "notify-burst", stringToInt, NotifyBurst);
+    CONFIG_ITEM(int, serverConfiguration_, "io-threads", stringToInt, IoThreadCount);
+    CONFIG_ITEM(int, serverConfiguration_, "matchmaking-interval", stringToInt, MatchmakingInterval);
+    CONFIG_ITEM(int, serverConfiguration_, "recruiting-rooms", stringToInt, RecruitingRoomCount);
+    CONFIG_ITEM(int, serverConfiguration_, "latency-tolerance", stringToInt, LatencyTolerance);
+    CONFIG_ITEM(int, serverConfiguration_, "room-pool-size", stringToInt, RoomPoolSize);
+    CONFIG_ITEM(QString, serverConfiguration_, "journal-directory", , JournalDirectory);
+    CONFIG_ITEM(int, serverConfiguration_, "maximum-connections", stringToInt, MaximumConnectionCount);
+    CONFIG_ITEM(int, serverConfiguration_, "sign-in-timeout", stringToInt, SignInTimeout);
+    CONFIG_ITEM(int, serverConfiguration_, "idle-timeout", stringToInt, IdleTimeout);
 
     setting->endGroup();
 
@@ -364,11 +433,33 @@ void Config::save_(QMdmmCore::Settings *setting, QMdmmCore::Settings::Instance t
 
     CONFIG_ITEM(bool, serverConfiguration_, "tcp", boolToString, tcpEnabled);
     CONFIG_ITEM(uint16_t, serverConfiguration_, "tcp-port", uint16ToString, tcpPort);
+    CONFIG_ITEM(bool, serverConfiguration_, "epoll", boolToString, epollEnabled);
     CONFIG_ITEM(bool, serverConfiguration_, "local", boolToString, localEnabled);
     CONFIG_ITEM(QString, serverConfiguration_, "local-name", , localSocketName);
     CONFIG_ITEM(bool, serverConfiguration_, "websocket", boolToString, websocketEnabled);
     CONFIG_ITEM(QString, serverConfiguration_, "websocket-name", , websocketName);
     CONFIG_ITEM(uint16_t, serverConfiguration_, "websocket-port", uint16ToString, websocketPort);
+    CONFIG_ITEM(int, serverConfiguration_, "maximum-frame-size", intToString, maximumFrameSize);
+    CONFIG_ITEM(int, serverConfiguration_, "receive-buffer-size", intToString, receiveBufferSize);
+    CONFIG_ITEM(int, serverConfiguration_, "compression-threshold", intToString, compressionThreshold);
+    CONFIG_ITEM(int, serverConfiguration_, "outbound-low-watermark", intToString, outboundLowWatermark);
+    CONFIG_ITEM(int, serverConfiguration_, "outbound-high-watermark", intToString, outboundHighWatermark);
+    CONFIG_ITEM(int, serverConfiguration_, "maximum-outbound-size", intToString, maximumOutboundSize);
+    CONFIG_ITEM(QString, serverConfiguration_, "tls-certificate", , tlsCertificate);
+    CONFIG_ITEM(QString, serverConfiguration_, "tls-private-key", , tlsPrivateKey);
+    CONFIG_ITEM(int, serverConfiguration_, "speak-rate-limit", intToString, speakRateLimit);
+    CONFIG_ITEM(int, serverConfiguration_, "speak-burst", intToString, speakBurst);
+    CONFIG_ITEM(int, serverConfiguration_, "notify-rate-limit", intToString, notifyRateLimit);
+    CONFIG_ITEM(int, serverConfiguration_, "notify-burst", intToString, notifyBurst);
+    CONFIG_ITEM(int, serverConfiguration_, "io-threads", intToString, ioThreadCount);
+    CONFIG_ITEM(int, serverConfiguration_, "matchmaking-interval", intToString, matchmakingInterval);
+    CONFIG_ITEM(int, serverConfiguration_, "recruiting-rooms", intToString, recruitingRoomCount);
+    CONFIG_ITEM(int, serverConfiguration_, "latency-tolerance", intToString, latencyTolerance);
+    CONFIG_ITEM(int, serverConfiguration_, "room-pool-size", intToString, roomPoolSize);
+    CONFIG_ITEM(QString, serverConfiguration_, "journal-directory", , journalDirectory);
+    CONFIG_ITEM(int, serverConfiguration_, "maximum-connections", intToString, maximumConnectionCount);
+    CONFIG_ITEM(int, serverConfiguration_, "sign-in-timeout", intToString, signInTimeout);
+    CONFIG_ITEM(int, serverConfiguration_, "idle-timeout", intToString, idleTimeout);
 
     setting->endGroup();
 
@@ -30,6 +30,9 @@ using namespace QMdmmNetworking;
 
 namespace {
 constexpr char LOCAL_HOST[] = "qmdmm://localhost:6366";
+// The bots share the process with the server, so they skip the network. The human stays on TCP, whose connection is
+// dropped below to exercise the reconnect
+constexpr char IN_PROCESS_HOST[] = "inproc://QMdmm";
 
 // Pace the auto-player's replies so each round takes a predictable minimum time.
 // This keeps the match alive long enough for the disconnect -> reconnect scenario
@@ -147,7 +150,9 @@ int main(int argc, char **argv)
     conf.setPunishHpModifier(0); // keep the attacker alive when slashing
     conf.setRequestTimeout(100); // be lenient in the headless environment
 
-    auto *server = new Server(ServerConfiguration::defaults(), conf, &app);
+    ServerConfiguration serverConf = ServerConfiguration::defaults();
+    serverConf.setInProcessEnabled(true);
+    auto *server = new Server(serverConf, conf, &app);
     if (!server->listen()) {
         qWarning() << "smoke: server listen failed";
         return 2;
@@ -203,12 +208,11 @@ int main(int argc, char **argv)
     for (int i = 1; i < playerCount; ++i) {
         auto *bot = new Client(ClientConfiguration(), &app);
         wireBot(bot);
-        bot->connectToHost(QString::fromLatin1(LOCAL_HOST), Data::StateOnlineBot);
+        bot->connectToHost(QString::fromLatin1(IN_PROCESS_HOST), Data::StateOnlineBot);
     }
 
-    // Safety timeout: if the match gets stuck (e.g. the reconnect path's
-    // notifyRoundStart replay desyncs the rejoining client), bail out rather than
-    // hang. The reconnect itself is the hard assertion; game completion is soft.
+    // Safety timeout: if the match gets stuck (e.g. the rejoining client misses
+    // a request sent while it was gone), bail out rather than hang. The reconnect itself is the hard assertion; game completion is soft.
     QTimer::singleShot(20000, &app, [&]() {
         qWarning() << "smoke: TIMEOUT - match did not finish";
         app.quit();
@@ -229,10 +233,10 @@ int main(int argc, char **argv)
         qWarning() << "smoke: reconnect did not complete";
         return 5;
     }
-    // Soft check: the game should keep running to completion, but the reconnect
-    // path still replays notifyGameStart/notifyRoundStart (TODO: precise
-    // catch-up), which can desync and drop the rejoining client again. Completion
-    // is therefore not guaranteed and is not a hard failure here.
+    // Soft check: the game should keep running to completion. The rejoining
+    // client rebuilds its room from the room snapshot, but a request sent while
+    // it was gone is not resent, so completion is not guaranteed and is not a
+    // hard failure here.
     if (gameOvers == 0)
         qWarning() << "smoke: WARNING - game did not finish after reconnect (known reconnect desync race)";
     qDebug() << "smoke: PASS - reconnect verified (game completed:" << (gameOvers > 0) << ")";